@@ -0,0 +1,1132 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/sclsh.h>
+#include <sclsh/parse.h>
+#include <sclsh/util.h>
+#include <sclsh/value.h>
+#include <sclsh/expr.h>
+#include <sclsh/commands.h>
+#include <sclsh/output.h>
+#include <sclsh/event.h>
+#include <sclsh/stats.h>
+#include <sclsh/thread_channel.h>
+#include <sclsh/cache.h>
+#include <sclsh/image.h>
+#include <sclsh/exec.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+/* Benchmark runner.
+ *
+ * Micro benchmarks call the library directly and report nanoseconds per
+ * operation: each is run in batches sized to take a fraction of the
+ * minimum time, and the median batch is reported along with the heap
+ * blocks allocated for values per operation. Script benchmarks
+ * evaluate every *.scl file of a directory in a fresh interpreter and
+ * report nanoseconds per run, again the median of several runs. Scripts
+ * find a file of text lines in the global variable bench_input; their
+ * output goes to /dev/null.
+ *
+ * Results go to stdout as a table and, with --json, to a file that
+ * compare.py checks against baseline.json.
+ */
+
+#define SAMPLES 5
+#define DEFAULT_MIN_TIME_MS 500
+#define INPUT_LINES 100000
+
+typedef struct Result_s {
+    char* name;
+    uint64_t iterations;  // Per sample
+    double median_ns;  // Per operation
+    double min_ns;
+    size_t bytes;  // Processed per operation, 0 if it does not apply
+    double allocations;  // Per operation, negative if not counted
+} Result;
+
+typedef struct Runner_s {
+    const char* filter;
+    uint64_t min_time_ns;
+    const char* scripts;
+    const char* json;
+    char* input;  // Path of the generated input file
+    Result* results;
+    size_t count;
+    size_t capacity;
+} Runner;
+
+// A micro benchmark: setup returns the state that run uses iterations
+// times in a row; bytes is the size of the input of one operation
+typedef struct Micro_s {
+    const char* name;
+    void* (*setup)(size_t* bytes);
+    void (*run)(void* state, uint64_t iterations);
+    void (*teardown)(void* state);
+} Micro;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int selected(Runner* runner, const char* name) {
+    return !runner->filter || strstr(name, runner->filter);
+}
+
+static void add_result(
+    Runner* runner,
+    const char* name,
+    uint64_t iterations,
+    double* samples,
+    size_t bytes,
+    double allocations
+) {
+    if (runner->count == runner->capacity) {
+        size_t capacity = runner->capacity ? runner->capacity * 2 : 16;
+        Result* results = realloc(runner->results, sizeof(Result) * capacity);
+        if (!results) {
+            return;
+        }
+        runner->results = results;
+        runner->capacity = capacity;
+    }
+    qsort(samples, SAMPLES, sizeof(double), compare_double);
+    Result* result = &runner->results[runner->count++];
+    result->name = strdup(name);
+    result->iterations = iterations;
+    result->median_ns = samples[SAMPLES / 2];
+    result->min_ns = samples[0];
+    result->bytes = bytes;
+    result->allocations = allocations;
+
+    printf("%-28s %12.1f ns/op %12.1f min", name, result->median_ns, result->min_ns);
+    if (allocations >= 0) {
+        printf(" %8.2f allocs/op", allocations);
+    }
+    if (bytes) {
+        printf(" %10.1f MB/s", bytes / result->median_ns * 1e3);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/* Micro benchmarks */
+
+static SclshValue* cmd_nop(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx; (void)argc; (void)argv; (void)user_data; // Suppress unused parameter warnings
+    return sclsh_value_empty();
+}
+
+// Interpreter without output, with the core commands and nop
+static SclshInterpreter* quiet_interpreter(void) {
+    SclshInterpreter* interp = sclsh_create_interpreter();
+    if (!interp) {
+        return NULL;
+    }
+    sclsh_register_core_commands(interp);
+    sclsh_command_new(interp, "nop", cmd_nop, NULL, NULL);
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        sclsh_output_free(sclsh_interpreter_set_output(interp, sclsh_output_new_fd(fd)));
+    }
+    return interp;
+}
+
+// A script of about 64 KiB mixing the usual kinds of words
+static SclshStringBuffer generated_script(void) {
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    char line[256];
+    for (int i = 0; sclsh_string_builder_value(sb).length < 64 * 1024; i++) {
+        snprintf(line, sizeof(line),
+            "set name%d \"value $i [expr $i + %d]\" {braced {nested} word} plain%d\n"
+            "# comment %d\n", i, i, i, i);
+        sclsh_string_builder_append_str(sb, line);
+    }
+    SclshStringBuffer script = sclsh_string_builder_value(sb);
+    sclsh_string_builder_free(sb);
+    return script;
+}
+
+static void* parse_setup(size_t* bytes) {
+    SclshStringBuffer* script = malloc(sizeof(SclshStringBuffer));
+    if (!script) {
+        return NULL;
+    }
+    *script = generated_script();
+    *bytes = script->length;
+    return script;
+}
+
+static void parse_run(void* state, uint64_t iterations) {
+    SclshStringBuffer* script = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_value_list_free(sclsh_parse_commands(*script));
+    }
+}
+
+static void parse_teardown(void* state) {
+    SclshStringBuffer* script = state;
+    free(script->string);
+    free(script);
+}
+
+// One command line of plain bare words, one with backslash sequences
+static const char* const word_lines[] = {
+    "puts alpha beta gamma delta epsilon zeta eta theta iota kappa lambda",
+    "puts tab\\there new\\nline \\x41\\x42 \\u00e9t\\u00e9 a\\ b long\\ word\\ here",
+};
+
+static void* words_setup(size_t* bytes) {
+    *bytes = strlen(word_lines[0]) + strlen(word_lines[1]);
+    return (void*)word_lines;
+}
+
+static void words_run(void* state, uint64_t iterations) {
+    const char* const* lines = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (int j = 0; j < 2; j++) {
+            SclshStringBuffer line = { (char*)lines[j], strlen(lines[j]) };
+            sclsh_node_list_free(sclsh_parse_command_line(line));
+        }
+    }
+}
+
+static void words_teardown(void* state) {
+    (void)state;
+}
+
+typedef struct Eval_s {
+    SclshInterpreter* interp;
+    SclshValue* script;
+} Eval;
+
+static void* eval_setup(SclshInterpreter* interp, const char* script) {
+    Eval* eval = malloc(sizeof(Eval));
+    if (!eval) {
+        return NULL;
+    }
+    eval->interp = interp;
+    eval->script = sclsh_value_from_cstr(script);
+    return eval;
+}
+
+static void eval_teardown(void* state) {
+    Eval* eval = state;
+    sclsh_value_unref(eval->script);
+    sclsh_destroy_interpreter(eval->interp);
+    free(eval);
+}
+
+// One command per operation; the script is compiled once and cached
+static void* dispatch_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(), "nop a b");
+}
+
+static void eval_run(void* state, uint64_t iterations) {
+    Eval* eval = state;
+    SclshContext* ctx = sclsh_global_context(eval->interp);
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_value_unref(sclsh_eval(ctx, eval->script));
+    }
+}
+
+static void* expr_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    SclshInterpreter* interp = quiet_interpreter();
+    if (!interp) {
+        return NULL;
+    }
+    SclshValue* x = sclsh_value_from_cstr("42");
+    sclsh_context_set_variable(sclsh_global_context(interp), "x", x);
+    sclsh_value_unref(x);
+    return eval_setup(interp, "$x * 3 + 7 - 1.5");
+}
+
+static void expr_run(void* state, uint64_t iterations) {
+    Eval* eval = state;
+    SclshContext* ctx = sclsh_global_context(eval->interp);
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_value_unref(sclsh_expr_eval(ctx, eval->script));
+    }
+}
+
+#define HASH_KEYS 1024
+
+typedef struct Keys_s {
+    char* keys[HASH_KEYS];
+} Keys;
+
+static void* hash_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    Keys* keys = malloc(sizeof(Keys));
+    if (!keys) {
+        return NULL;
+    }
+    char key[32];
+    for (int i = 0; i < HASH_KEYS; i++) {
+        snprintf(key, sizeof(key), "variable_%d", i);
+        keys->keys[i] = strdup(key);
+    }
+    return keys;
+}
+
+// Fills a map and looks every key up twice, HASH_KEYS keys per operation
+static void hash_run(void* state, uint64_t iterations) {
+    Keys* keys = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        SclshHashMap* map = sclsh_hash_map_new();
+        for (int k = 0; k < HASH_KEYS; k++) {
+            sclsh_hash_map_set(map, keys->keys[k], keys->keys[k]);
+        }
+        for (int k = 0; k < HASH_KEYS * 2; k++) {
+            if (sclsh_hash_map_get(map, keys->keys[k % HASH_KEYS]) != keys->keys[k % HASH_KEYS]) {
+                abort();
+            }
+        }
+        sclsh_hash_map_free(map);
+    }
+}
+
+static void hash_teardown(void* state) {
+    Keys* keys = state;
+    for (int i = 0; i < HASH_KEYS; i++) {
+        free(keys->keys[i]);
+    }
+    free(keys);
+}
+
+#define LIST_ITEMS 256
+
+static void* list_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return sclsh_value_from_cstr("item");
+}
+
+// Builds a list of LIST_ITEMS items and its string form per operation
+static void list_run(void* state, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        SclshListBuilder* builder = sclsh_list_builder_new();
+        for (int k = 0; k < LIST_ITEMS; k++) {
+            sclsh_list_builder_append(builder, state);
+        }
+        sclsh_value_unref(sclsh_list_builder_value(builder));
+        sclsh_list_builder_free(builder);
+    }
+}
+
+static void list_teardown(void* state) {
+    sclsh_value_unref(state);
+}
+
+static void* output_setup(size_t* bytes) {
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    *bytes = 32;
+    return sclsh_output_new_fd(fd);
+}
+
+// One 32 byte line per operation, flushed as the buffer fills
+static void output_run(void* state, uint64_t iterations) {
+    static const char line[] = "a line of output, 32 bytes long\n";
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_output_write(state, line, sizeof(line) - 1);
+    }
+}
+
+static void output_teardown(void* state) {
+    sclsh_output_free(state);
+}
+
+// A loop of set, expr and incr, which must not allocate once warmed up;
+// one operation is 100 iterations
+static void* steady_loop_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(),
+        "set i 0\n"
+        "while {$i < 100} {\n"
+        "    set x [expr $i * 2]\n"
+        "    set y [expr {$x < 50}]\n"
+        "    incr i\n"
+        "}\n");
+}
+
+// A quoted template with variables and a command substituted
+static void* interpolation_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    Eval* eval = eval_setup(quiet_interpreter(),
+        "set line \"user $name ($id) said: [nop] at $time\\n\"");
+    if (!eval) {
+        return NULL;
+    }
+    SclshContext* ctx = sclsh_global_context(eval->interp);
+    const char* variables[][2] = { { "name", "somebody" }, { "id", "4711" }, { "time", "12:34:56" } };
+    for (size_t i = 0; i < 3; i++) {
+        SclshValue* value = sclsh_value_from_cstr(variables[i][1]);
+        sclsh_context_set_variable(ctx, variables[i][0], value);
+        sclsh_value_unref(value);
+    }
+    return eval;
+}
+
+// puts through the interpreter, the way scripts write output
+static void* puts_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(), "puts {a line of output}");
+}
+
+// Builds a string of 100 pieces, growing it in place
+static void* append_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(),
+        "set acc {}\n"
+        "set i 0\n"
+        "while {$i < 100} {\n"
+        "    append acc {a chunk of text}\n"
+        "    incr i\n"
+        "}\n");
+}
+
+// Rewrites a line of about 1 KiB, sized before it is copied
+static void* string_map_setup(size_t* bytes) {
+    Eval* eval = eval_setup(quiet_interpreter(),
+        "set out [string toupper [string map {& &amp; < &lt; > &gt;} $line]]");
+    if (!eval) {
+        return NULL;
+    }
+    char line[1024];
+    for (size_t i = 0; i < sizeof(line); i++) {
+        line[i] = "plain text with <tags> & entities "[i % 34];
+    }
+    SclshValue* value = sclsh_value_new(line, sizeof(line));
+    sclsh_context_set_variable(sclsh_global_context(eval->interp), "line", value);
+    sclsh_value_unref(value);
+    *bytes = sizeof(line);
+    return eval;
+}
+
+// Routes a request path through glob patterns compiled once
+static void* glob_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(),
+        "switch -glob /api/v2/users/4711/orders {\n"
+        "    /static/* {nop}\n"
+        "    /api/v1/* {nop}\n"
+        "    /api/v2/items/* {nop}\n"
+        "    /api/v2/users/*/orders {nop}\n"
+        "    default {nop}\n"
+        "}\n");
+}
+
+// Patterns that take exponential time to backtrack, against 4 KiB
+static void* glob_adversarial_setup(size_t* bytes) {
+    Eval* eval = eval_setup(quiet_interpreter(),
+        "string match *a*a*a*a*a*a*a*a*a*a*b $text\n"
+        "string match *?*?*?*?*?*?*?*?*?*?*b $text\n");
+    if (!eval) {
+        return NULL;
+    }
+    char text[4096];
+    memset(text, 'a', sizeof(text));
+    SclshValue* value = sclsh_value_new(text, sizeof(text));
+    sclsh_context_set_variable(sclsh_global_context(eval->interp), "text", value);
+    sclsh_value_unref(value);
+    *bytes = 2 * sizeof(text);
+    return eval;
+}
+
+// Extracts a key and a value with a regular expression. Both scripts
+// lower the case of something to cost the same apart from compiling.
+static Eval* regexp_setup(const char* script) {
+    Eval* eval = eval_setup(quiet_interpreter(), script);
+    if (!eval) {
+        return NULL;
+    }
+    SclshContext* ctx = sclsh_global_context(eval->interp);
+    SclshValue* pattern = sclsh_value_from_cstr("([a-z_]+) *= *([0-9]+)");
+    SclshValue* line = sclsh_value_from_cstr("2025-01-01 12:00:00 worker: request_count = 4711 ok");
+    sclsh_context_set_variable(ctx, "pattern", pattern);
+    sclsh_context_set_variable(ctx, "line", line);
+    sclsh_value_unref(pattern);
+    sclsh_value_unref(line);
+    return eval;
+}
+
+// The pattern is the same value every time, so it compiles once
+static void* regexp_cached_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return regexp_setup("regexp $pattern [string tolower $line] all key value\n");
+}
+
+// The same with a new copy of the pattern each time, as it would be
+// without the cache
+static void* regexp_recompile_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return regexp_setup("regexp [string tolower $pattern] $line all key value\n");
+}
+
+// Decodes a 16-byte record header holding a null byte, and encodes it again
+static void* binary_setup(size_t* bytes) {
+    *bytes = 32;
+    return eval_setup(quiet_interpreter(),
+        "set header [binary format a4SuIWa2 SCL 3 4096 1234567890123 ok]\n"
+        "binary scan $header a4SuIWa2 magic version size stamp tag\n"
+        "binary format a4SuIWa2 $magic $version $size $stamp $tag\n");
+}
+
+// Walks a 1 MiB string of copies of piece, chars characters each, one
+// string index per operation, starting over at the end
+static Eval* string_index_setup(const char* piece, size_t chars) {
+    Eval* eval = eval_setup(quiet_interpreter(),
+        "set c [string index $text $i]\n"
+        "incr i\n"
+        "if {$i == $n} {set i 0}\n");
+    if (!eval) {
+        return NULL;
+    }
+    size_t piece_length = strlen(piece);
+    size_t copies = 1024 * 1024 / piece_length;
+    char* text = malloc(copies * piece_length);
+    if (!text) {
+        return NULL;
+    }
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(text + i * piece_length, piece, piece_length);
+    }
+    char n[32];
+    snprintf(n, sizeof(n), "%zu", copies * chars);
+    SclshContext* ctx = sclsh_global_context(eval->interp);
+    SclshValue* values[] = {
+        sclsh_value_new(text, copies * piece_length), sclsh_value_from_cstr("0"), sclsh_value_from_cstr(n)
+    };
+    const char* names[] = { "text", "i", "n" };
+    for (size_t i = 0; i < 3; i++) {
+        sclsh_context_set_variable(ctx, names[i], values[i]);
+        sclsh_value_unref(values[i]);
+    }
+    free(text);
+    return eval;
+}
+
+static void* string_index_ascii_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return string_index_setup("plain ascii text ", 17);
+}
+
+static void* string_index_utf8_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return string_index_setup("p\xc5\x99\xc3\xadli\xc5\xa1 \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88 ", 21);
+}
+
+#define EVENT_PIPES 256
+#define IDLE_DESCRIPTORS 10000
+
+typedef struct Events_s {
+    SclshInterpreter* interp;
+    int fds[EVENT_PIPES][2];
+    int idle[IDLE_DESCRIPTORS];  // Watched but never ready
+    size_t idle_count;
+    uint64_t fired;
+} Events;
+
+static int on_readable(SclshInterpreter* interp, void* user_data) {
+    (void)interp; // Suppress unused parameter warning
+    Events* events = user_data;
+    events->fired++;
+    return 1;
+}
+
+// EVENT_PIPES ready pipes among idle_count descriptors with nothing to read
+static Events* events_new(size_t idle_count) {
+    // Each pipe takes two descriptors
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    Events* events = calloc(1, sizeof(Events));
+    if (!events) {
+        return NULL;
+    }
+    events->interp = quiet_interpreter();
+    SclshEventLoop* loop = sclsh_interpreter_event_loop(events->interp);
+    for (size_t i = 0; i < idle_count; i++) {
+        events->idle[i] = eventfd(0, EFD_CLOEXEC);
+        if (events->idle[i] < 0) {
+            perror("eventfd");
+            events->idle_count = i;
+            return events;
+        }
+        events->idle_count++;
+        sclsh_event_watch(loop, events->idle[i], SCLSH_EVENT_READABLE, on_readable, events, NULL);
+    }
+    for (int i = 0; i < EVENT_PIPES; i++) {
+        if (pipe(events->fds[i]) != 0) {
+            abort();
+        }
+        sclsh_event_watch(loop, events->fds[i][0], SCLSH_EVENT_READABLE, on_readable, events, NULL);
+        if (write(events->fds[i][1], "x", 1) != 1) {
+            abort();
+        }
+    }
+    return events;
+}
+
+static void* events_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return events_new(0);
+}
+
+static void* events_idle_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return events_new(IDLE_DESCRIPTORS);
+}
+
+// One pass of the loop over EVENT_PIPES ready descriptors per operation
+static void events_run(void* state, uint64_t iterations) {
+    Events* events = state;
+    SclshEventLoop* loop = sclsh_interpreter_event_loop(events->interp);
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_event_loop_run_once(loop, 0);
+    }
+}
+
+static void events_teardown(void* state) {
+    Events* events = state;
+    sclsh_destroy_interpreter(events->interp);
+    for (int i = 0; i < EVENT_PIPES; i++) {
+        close(events->fds[i][0]);
+        close(events->fds[i][1]);
+    }
+    for (size_t i = 0; i < events->idle_count; i++) {
+        close(events->idle[i]);
+    }
+    free(events);
+}
+
+typedef struct Channel_s {
+    SclshThreadChannel* chan;
+    pthread_t consumer;
+} Channel;
+
+static void* consume(void* arg) {
+    SclshThreadChannel* chan = arg;
+    SclshValue* value;
+    while (sclsh_thread_channel_recv(chan, &value, -1) == SCLSH_THREAD_CHANNEL_OK) {
+        sclsh_value_unref(value);
+    }
+    return NULL;
+}
+
+static void* thread_channel_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    Channel* channel = malloc(sizeof(Channel));
+    if (!channel) {
+        return NULL;
+    }
+    channel->chan = sclsh_thread_channel_new(1024, SCLSH_THREAD_CHANNEL_SPSC);
+    if (!channel->chan || pthread_create(&channel->consumer, NULL, consume, channel->chan) != 0) {
+        sclsh_thread_channel_unref(channel->chan);
+        free(channel);
+        return NULL;
+    }
+    return channel;
+}
+
+// One message to a thread receiving as fast as it can per operation
+static void thread_channel_run(void* state, uint64_t iterations) {
+    Channel* channel = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_thread_channel_send(channel->chan, sclsh_value_from_cstr("message"), -1);
+    }
+}
+
+static void thread_channel_teardown(void* state) {
+    Channel* channel = state;
+    sclsh_thread_channel_close(channel->chan);
+    pthread_join(channel->consumer, NULL);
+    sclsh_thread_channel_unref(channel->chan);
+    free(channel);
+}
+
+typedef struct ScriptFile_s {
+    char path[32];
+    char cache[32];  // Directory of the cache, empty when it is off
+} ScriptFile;
+
+// The generated script in a file, loaded through the cache if cache is set
+static void* script_file_setup(size_t* bytes, int cache) {
+    ScriptFile* file = calloc(1, sizeof(ScriptFile));
+    if (!file) {
+        return NULL;
+    }
+    strcpy(file->path, "/tmp/sclsh-bench-XXXXXX");
+    int fd = mkstemp(file->path);
+    if (fd < 0) {
+        free(file);
+        return NULL;
+    }
+    SclshStringBuffer script = generated_script();
+    if (write(fd, script.string, script.length) != (ssize_t)script.length) {
+        abort();
+    }
+    close(fd);
+    *bytes = script.length;
+    free(script.string);
+    if (cache) {
+        strcpy(file->cache, "/tmp/sclsh-cache-XXXXXX");
+        if (!mkdtemp(file->cache)) {
+            abort();
+        }
+        setenv("SCLSH_CACHE_DIR", file->cache, 1);
+    }
+    // The first load fills the cache
+    sclsh_value_unref(sclsh_cache_load_script(file->path));
+    return file;
+}
+
+static void* script_cold_setup(size_t* bytes) {
+    return script_file_setup(bytes, 0);
+}
+
+static void* script_warm_setup(size_t* bytes) {
+    return script_file_setup(bytes, 1);
+}
+
+// Reads and parses the script, as starting sclsh on it does
+static void script_file_run(void* state, uint64_t iterations) {
+    ScriptFile* file = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sclsh_value_unref(sclsh_cache_load_script(file->path));
+    }
+}
+
+static void script_file_teardown(void* state) {
+    ScriptFile* file = state;
+    unlink(file->path);
+    if (*file->cache) {
+        setenv("SCLSH_CACHE_DIR", "", 1);
+        DIR* dir = opendir(file->cache);
+        struct dirent* entry;
+        while (dir && (entry = readdir(dir))) {
+            char path[300];
+            snprintf(path, sizeof(path), "%s/%s", file->cache, entry->d_name);
+            unlink(path);
+        }
+        if (dir) {
+            closedir(dir);
+        }
+        rmdir(file->cache);
+    }
+    free(file);
+}
+
+#define PRELUDE_PROCS 200
+
+typedef struct Prelude_s {
+    SclshStringBuffer script;
+    char image[32];
+} Prelude;
+
+// A prelude of PRELUDE_PROCS procedures and as many global variables,
+// and an image of an interpreter that has sourced it
+static void* prelude_setup(size_t* bytes) {
+    Prelude* prelude = calloc(1, sizeof(Prelude));
+    if (!prelude) {
+        return NULL;
+    }
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    char text[512];
+    for (int i = 0; i < PRELUDE_PROCS; i++) {
+        snprintf(text, sizeof(text),
+            "set setting%d {option%d value {nested list %d}}\n"
+            "proc helper%d {a {b %d} args} {\n"
+            "    set total [expr $a + $b]\n"
+            "    if {$total > %d} {\n"
+            "        return [string repeat x $total]\n"
+            "    }\n"
+            "    return \"$a and $b: $args\"\n"
+            "}\n", i, i, i, i, i, i);
+        sclsh_string_builder_append_str(sb, text);
+    }
+    prelude->script = sclsh_string_builder_value(sb);
+    sclsh_string_builder_free(sb);
+    *bytes = prelude->script.length;
+
+    strcpy(prelude->image, "/tmp/sclsh-image-XXXXXX");
+    int fd = mkstemp(prelude->image);
+    if (fd >= 0) {
+        close(fd);
+    }
+    SclshInterpreter* interp = quiet_interpreter();
+    SclshValue* script = sclsh_value_new(prelude->script.string, prelude->script.length);
+    SclshValue* result = sclsh_eval(sclsh_global_context(interp), script);
+    if (fd < 0 || !result || !sclsh_image_save(interp, prelude->image)) {
+        abort();
+    }
+    sclsh_value_unref(result);
+    sclsh_value_unref(script);
+    sclsh_destroy_interpreter(interp);
+    return prelude;
+}
+
+// A new interpreter sourcing the prelude per operation. The prelude is a
+// new value every time, as it is when read from a file.
+static void prelude_source_run(void* state, uint64_t iterations) {
+    Prelude* prelude = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        SclshInterpreter* interp = quiet_interpreter();
+        SclshValue* script = sclsh_value_new(prelude->script.string, prelude->script.length);
+        sclsh_value_unref(sclsh_eval(sclsh_global_context(interp), script));
+        sclsh_value_unref(script);
+        sclsh_destroy_interpreter(interp);
+    }
+}
+
+// A new interpreter restored from the image per operation
+static void prelude_image_run(void* state, uint64_t iterations) {
+    Prelude* prelude = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        SclshInterpreter* interp = quiet_interpreter();
+        if (!sclsh_image_load(interp, prelude->image)) {
+            abort();
+        }
+        sclsh_destroy_interpreter(interp);
+    }
+}
+
+static void prelude_teardown(void* state) {
+    Prelude* prelude = state;
+    unlink(prelude->image);
+    free(prelude->script.string);
+    free(prelude);
+}
+
+// Starting a program and waiting for it, one per operation
+static void* spawn_setup(size_t* bytes) {
+    (void)bytes; // Suppress unused parameter warning
+    return eval_setup(quiet_interpreter(), "true");
+}
+
+#define COPY_BYTES (4 << 20)
+
+typedef struct Copy_s {
+    int in;  // A file of COPY_BYTES
+    int out[2];  // Pipe drained by drainer
+    pthread_t drainer;
+} Copy;
+
+static void* drain_pipe(void* arg) {
+    int fd = *(int*)arg;
+    char buffer[65536];
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+    return NULL;
+}
+
+// Copies from a file into a pipe, which a thread empties
+static void* copy_setup(size_t* bytes) {
+    Copy* copy = malloc(sizeof(Copy));
+    if (!copy) {
+        return NULL;
+    }
+    char path[] = "/tmp/sclsh-bench-XXXXXX";
+    copy->in = mkstemp(path);
+    if (copy->in < 0) {
+        free(copy);
+        return NULL;
+    }
+    unlink(path);
+    char* chunk = calloc(1, 1 << 20);
+    for (int i = 0; i < COPY_BYTES >> 20; i++) {
+        if (write(copy->in, chunk, 1 << 20) != 1 << 20) {
+            abort();
+        }
+    }
+    free(chunk);
+    if (pipe(copy->out) != 0 || pthread_create(&copy->drainer, NULL, drain_pipe, &copy->out[0]) != 0) {
+        abort();
+    }
+    *bytes = COPY_BYTES;
+    return copy;
+}
+
+// sendfile or splice, as sclsh_copy_fd picks for a stage like < file | cmd
+static void copy_kernel_run(void* state, uint64_t iterations) {
+    Copy* copy = state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        lseek(copy->in, 0, SEEK_SET);
+        if (sclsh_copy_fd(copy->in, copy->out[1]) != COPY_BYTES) {
+            abort();
+        }
+    }
+}
+
+// The same through a buffer in user space
+static void copy_read_write_run(void* state, uint64_t iterations) {
+    Copy* copy = state;
+    static char buffer[65536];
+    for (uint64_t i = 0; i < iterations; i++) {
+        lseek(copy->in, 0, SEEK_SET);
+        ssize_t n;
+        while ((n = read(copy->in, buffer, sizeof(buffer))) > 0) {
+            if (write(copy->out[1], buffer, n) != n) {
+                abort();
+            }
+        }
+    }
+}
+
+static void copy_teardown(void* state) {
+    Copy* copy = state;
+    close(copy->out[1]);
+    pthread_join(copy->drainer, NULL);
+    close(copy->out[0]);
+    close(copy->in);
+    free(copy);
+}
+
+static const Micro micros[] = {
+    { "micro/parse_commands", parse_setup, parse_run, parse_teardown },
+    { "micro/parse_words", words_setup, words_run, words_teardown },
+    { "micro/eval_dispatch", dispatch_setup, eval_run, eval_teardown },
+    { "micro/steady_loop", steady_loop_setup, eval_run, eval_teardown },
+    { "micro/expr", expr_setup, expr_run, eval_teardown },
+    { "micro/interpolation", interpolation_setup, eval_run, eval_teardown },
+    { "micro/hash_map", hash_setup, hash_run, hash_teardown },
+    { "micro/list_build", list_setup, list_run, list_teardown },
+    { "micro/output_write", output_setup, output_run, output_teardown },
+    { "micro/puts", puts_setup, eval_run, eval_teardown },
+    { "micro/append", append_setup, eval_run, eval_teardown },
+    { "micro/string_map", string_map_setup, eval_run, eval_teardown },
+    { "micro/glob", glob_setup, eval_run, eval_teardown },
+    { "micro/glob_adversarial", glob_adversarial_setup, eval_run, eval_teardown },
+    { "micro/regexp", regexp_cached_setup, eval_run, eval_teardown },
+    { "micro/regexp_recompile", regexp_recompile_setup, eval_run, eval_teardown },
+    { "micro/binary", binary_setup, eval_run, eval_teardown },
+    { "micro/string_index_ascii", string_index_ascii_setup, eval_run, eval_teardown },
+    { "micro/string_index_utf8", string_index_utf8_setup, eval_run, eval_teardown },
+    { "micro/event_loop", events_setup, events_run, events_teardown },
+    { "micro/event_loop_idle", events_idle_setup, events_run, events_teardown },
+    { "micro/thread_channel", thread_channel_setup, thread_channel_run, thread_channel_teardown },
+    { "micro/script_cold", script_cold_setup, script_file_run, script_file_teardown },
+    { "micro/script_warm", script_warm_setup, script_file_run, script_file_teardown },
+    { "micro/prelude_source", prelude_setup, prelude_source_run, prelude_teardown },
+    { "micro/prelude_image", prelude_setup, prelude_image_run, prelude_teardown },
+    { "micro/spawn", spawn_setup, eval_run, eval_teardown },
+    { "micro/copy_kernel", copy_setup, copy_kernel_run, copy_teardown },
+    { "micro/copy_read_write", copy_setup, copy_read_write_run, copy_teardown },
+};
+
+static void run_micro(Runner* runner, const Micro* micro) {
+    size_t bytes = 0;
+    void* state = micro->setup(&bytes);
+    if (!state) {
+        fprintf(stderr, "%s: setup failed\n", micro->name);
+        return;
+    }
+
+    // Grows the batch until it takes a sample's share of the minimum time
+    uint64_t target = runner->min_time_ns / SAMPLES;
+    uint64_t iterations = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        micro->run(state, iterations);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= target) {
+            break;
+        }
+        uint64_t scale = elapsed ? target / elapsed + 1 : 100;
+        iterations *= scale < 100 ? scale : 100;
+    }
+
+    double samples[SAMPLES];
+    SclshStats before, after;
+    sclsh_stats_snapshot(&before);
+    for (int i = 0; i < SAMPLES; i++) {
+        uint64_t start = now_ns();
+        micro->run(state, iterations);
+        samples[i] = (double)(now_ns() - start) / iterations;
+    }
+    sclsh_stats_snapshot(&after);
+    uint64_t allocations = sclsh_stats_value_allocations(&after) - sclsh_stats_value_allocations(&before);
+    micro->teardown(state);
+    add_result(runner, micro->name, iterations, samples, bytes, (double)allocations / (iterations * SAMPLES));
+}
+
+/* Script benchmarks */
+
+// Returns the nanoseconds the evaluation took, 0 on failure
+static uint64_t run_script_once(Runner* runner, const char* path) {
+    SclshInterpreter* interp = quiet_interpreter();
+    if (!interp) {
+        return 0;
+    }
+    SclshContext* ctx = sclsh_global_context(interp);
+    SclshValue* input = sclsh_value_from_cstr(runner->input);
+    sclsh_context_set_variable(ctx, "bench_input", input);
+    sclsh_value_unref(input);
+
+    uint64_t start = now_ns();
+    SclshValue* result = sclsh_eval_file(ctx, path);
+    uint64_t elapsed = now_ns() - start;
+    sclsh_value_unref(result);
+    sclsh_destroy_interpreter(interp);
+    return result ? elapsed : 0;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void run_scripts(Runner* runner) {
+    DIR* dir = opendir(runner->scripts);
+    if (!dir) {
+        perror(runner->scripts);
+        return;
+    }
+    char* names[256];
+    size_t count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) && count < sizeof(names) / sizeof(names[0])) {
+        size_t length = strlen(entry->d_name);
+        if (length > 4 && strcmp(entry->d_name + length - 4, ".scl") == 0) {
+            names[count++] = strdup(entry->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(char*), compare_names);
+
+    for (size_t i = 0; i < count; i++) {
+        char name[300];
+        char path[4096];
+        snprintf(name, sizeof(name), "script/%.*s", (int)(strlen(names[i]) - 4), names[i]);
+        snprintf(path, sizeof(path), "%s/%s", runner->scripts, names[i]);
+        if (selected(runner, name)) {
+            double samples[SAMPLES];
+            int ok = 1;
+            for (int s = 0; s < SAMPLES && ok; s++) {
+                uint64_t elapsed = run_script_once(runner, path);
+                ok = elapsed != 0;
+                samples[s] = (double)elapsed;
+            }
+            if (ok) {
+                add_result(runner, name, 1, samples, 0, -1);
+            } else {
+                fprintf(stderr, "%s: evaluation failed\n", name);
+            }
+        }
+        free(names[i]);
+    }
+}
+
+// The file scripts read lines from
+static char* write_input(void) {
+    char path[] = "/tmp/sclsh-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return NULL;
+    }
+    FILE* f = fdopen(fd, "w");
+    for (int i = 0; i < INPUT_LINES; i++) {
+        fprintf(f, "%d some text on line %d of the benchmark input\n", i, i);
+    }
+    fclose(f);
+    return strdup(path);
+}
+
+static int write_json(Runner* runner) {
+    FILE* f = fopen(runner->json, "w");
+    if (!f) {
+        perror(runner->json);
+        return 0;
+    }
+    fprintf(f, "{\n  \"version\": 1,\n  \"results\": [\n");
+    for (size_t i = 0; i < runner->count; i++) {
+        Result* result = &runner->results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"median_ns\": %.1f, \"min_ns\": %.1f, \"iterations\": %llu",
+            result->name, result->median_ns, result->min_ns, (unsigned long long)result->iterations);
+        if (result->bytes) {
+            fprintf(f, ", \"bytes\": %zu", result->bytes);
+        }
+        if (result->allocations >= 0) {
+            fprintf(f, ", \"allocations\": %.3f", result->allocations);
+        }
+        fprintf(f, "}%s\n", i + 1 < runner->count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: sclsh-bench ?--filter <substring>? ?--min-time <ms>? ?--scripts <dir>? ?--json <file>?\n");
+}
+
+int main(int argc, char* argv[]) {
+    Runner runner = { .min_time_ns = DEFAULT_MIN_TIME_MS * 1000000ull };
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--filter") == 0) {
+            runner.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0) {
+            runner.min_time_ns = strtoull(argv[++i], NULL, 10) * 1000000ull;
+        } else if (strcmp(argv[i], "--scripts") == 0) {
+            runner.scripts = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            runner.json = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    // Scripts are parsed every run rather than loaded from the cache
+    setenv("SCLSH_CACHE_DIR", "", 1);
+
+    for (size_t i = 0; i < sizeof(micros) / sizeof(micros[0]); i++) {
+        if (selected(&runner, micros[i].name)) {
+            run_micro(&runner, &micros[i]);
+        }
+    }
+    if (runner.scripts) {
+        runner.input = write_input();
+        if (runner.input) {
+            run_scripts(&runner);
+            unlink(runner.input);
+            free(runner.input);
+        }
+    }
+
+    int status = 0;
+    if (runner.json && !write_json(&runner)) {
+        status = 1;
+    }
+    for (size_t i = 0; i < runner.count; i++) {
+        free(runner.results[i].name);
+    }
+    free(runner.results);
+    return status;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Copyright © 2025 Ales Hakl
+#
+# SPDX-License-Identifier: MIT
+
+"""Compares benchmark results written by sclsh-bench --json with a baseline.
+
+A benchmark regresses when its median time exceeds the baseline by more
+than the threshold, a percentage given by --threshold for all benchmarks
+and by --limit NAME=PERCENT for single ones (for instance the noisier
+script benchmarks). Micro benchmarks also regress when they allocate
+more per operation than the baseline did; a baseline of zero thus
+asserts that a path does not allocate at all. The exit status is 1 if
+anything regressed.
+
+With --update the results replace the baseline instead.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {r["name"]: r for r in json.load(f)["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("results", nargs="+")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed slowdown in percent (default 10)")
+    parser.add_argument("--limit", action="append", default=[], metavar="NAME=PERCENT",
+                        help="allowed slowdown of one benchmark")
+    parser.add_argument("--update", action="store_true",
+                        help="merge the results into the baseline")
+    args = parser.parse_args()
+
+    results = {}
+    for path in args.results:
+        results.update(load(path))
+
+    if args.update:
+        try:
+            baseline = load(args.baseline)
+        except FileNotFoundError:
+            baseline = {}
+        baseline.update(results)
+        with open(args.baseline, "w") as f:
+            json.dump({"version": 1, "results": [baseline[name] for name in sorted(baseline)]},
+                      f, indent=2)
+            f.write("\n")
+        return 0
+
+    limits = {}
+    for limit in args.limit:
+        name, _, percent = limit.partition("=")
+        limits[name] = float(percent)
+
+    baseline = load(args.baseline)
+    regressed = 0
+    print("%-28s %14s %14s %8s" % ("benchmark", "baseline ns", "current ns", "change"))
+    for name in sorted(results):
+        current = results[name]["median_ns"]
+        if name not in baseline:
+            print("%-28s %14s %14.1f %8s" % (name, "-", current, "new"))
+            continue
+        base = baseline[name]["median_ns"]
+        change = (current - base) / base * 100
+        mark = ""
+        if change > limits.get(name, args.threshold):
+            mark = "  REGRESSION"
+            regressed += 1
+        allocations = results[name].get("allocations")
+        allowed = baseline[name].get("allocations")
+        if allocations is not None and allowed is not None and allocations > allowed + 0.005:
+            mark += "  ALLOCATIONS %.3f > %.3f" % (allocations, allowed)
+            regressed += 1
+        print("%-28s %14.1f %14.1f %+7.1f%%%s" % (name, base, current, change, mark))
+    for name in sorted(set(baseline) - set(results)):
+        print("%-28s %14.1f %14s %8s" % (name, baseline[name]["median_ns"], "-", "missing"))
+
+    if regressed:
+        print("%d benchmark(s) regressed" % regressed)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
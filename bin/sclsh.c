@@ -7,7 +7,10 @@
 #include <sclsh/parse.h>
 #include <sclsh/util.h>
 #include <sclsh/commands.h>
+#include <sclsh/image.h>
+#include <sclsh/output.h>
 #include <stdio.h>
+#include <string.h>
 #include <editline/readline.h>
 
 int main(int argc, char* argv[]) {
@@ -26,6 +29,25 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    int arg = 1;
+    if (argc > 2 && strcmp(argv[1], "-image") == 0) {
+        if (!sclsh_image_load(interp, argv[2])) {
+            sclsh_destroy_interpreter(interp);
+            return 1;
+        }
+        arg = 3;
+    }
+
+    if (argc > arg) {
+        // With SCLSH_CACHE_DIR set, the parse of the script and of every
+        // file it sources is kept there (see cache.h)
+        SclshValue* result = sclsh_eval_file(ctx, argv[arg]);
+        int status = result ? EXIT_SUCCESS : EXIT_FAILURE;
+        sclsh_value_unref(result);
+        sclsh_destroy_interpreter(interp);
+        return status;
+    }
+
     char* line;
     while ((line = readline("sclsh> ")) != NULL) {
         if (*line) {
@@ -40,6 +62,7 @@ int main(int argc, char* argv[]) {
                 }
                 SclshValue* result = sclsh_eval(ctx, input);
                 sclsh_value_unref(input);
+                sclsh_output_flush(sclsh_interpreter_output(interp));
                 if (result) {
                     SclshStringBuffer str_buf = sclsh_value_as_string(result);
                     printf("Result: %.*s\n", (int)str_buf.length, str_buf.string);
@@ -0,0 +1,49 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__BINARY_H
+#define H__SCLSH__BINARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+
+/* binary format <format> ?arg ...? and binary scan <value> <format> ?var ...?
+ *
+ * A format is a sequence of fields, each a type letter with an optional
+ * count, digits or *:
+ *
+ *   a A   bytes, padded with nulls or spaces; A scans without trailing
+ *         blanks and nulls. The count is the number of bytes, 1 if not
+ *         given, * for all of the argument or the rest of the value.
+ *   H     hexadecimal digits, high nibble first; the count counts digits
+ *   x     a null byte written or a byte skipped per count
+ *   c     8-bit integers
+ *   s S   16-bit integers, little and big endian
+ *   i I   32-bit integers, little and big endian
+ *   w W   64-bit integers, little and big endian
+ *   r R   32-bit floats, little and big endian; f in host order
+ *   q Q   64-bit floats, little and big endian; d in host order
+ *
+ * A number field without a count takes or yields a single number, with
+ * one a list of that many (* for all). Scanning integers gives signed
+ * numbers unless the type letter is followed by u. Integers to format
+ * are decimal, or hexadecimal after 0x, and may be anything from -2^63
+ * to 2^64 - 1; fields narrower than 64 bits keep the low bits.
+ *
+ * format sizes its result before writing it into a single allocation;
+ * scan reads the value's bytes in place, and the strings it yields for
+ * a and A are slices of the value.
+ */
+
+void sclsh_register_binary_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__BINARY_H
@@ -0,0 +1,39 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__CACHE_H
+#define H__SCLSH__CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/value.h>
+
+/* On-disk cache of parsed scripts. Entries are named by a hash of the
+ * script source and carry the source itself and the interpreter version,
+ * so editing a script or upgrading sclsh makes the old entry miss and
+ * get rewritten, and two scripts whose hashes collide never share one.
+ *
+ * A hit still rebuilds the parse on the heap; only words too long to be
+ * kept inside a value are left in the mapped entry. It saves the parse
+ * but not the allocations, so loads are only about a quarter faster.
+ *
+ * The cache is off unless $SCLSH_CACHE_DIR names the directory to keep
+ * it in.
+ */
+
+// Returns a newly allocated path, or NULL when caching is disabled
+char* sclsh_cache_directory(void);
+
+// Reads a script file and returns it with its commands already parsed,
+// loading the parse from the cache when a valid entry exists
+SclshValue* sclsh_cache_load_script(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__CACHE_H
@@ -0,0 +1,76 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__CHANNEL_H
+#define H__SCLSH__CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+#include <sclsh/output.h>
+
+#include <sys/types.h>
+
+/* Buffered file channels.
+ *
+ * A regular file opened read-only is mapped into memory instead of being
+ * read through a buffer. Lines and blocks read from such a channel are
+ * slices of the mapping: they share its pages rather than copying them,
+ * and keep the mapping alive after the channel is closed. Pages already
+ * consumed are released as reading progresses, so a file of any size is
+ * streamed with a bounded footprint. Truncating a file while it is mapped
+ * makes further reads from it fault.
+ *
+ * Other files, pipes and terminals are read through a buffer. Writes on
+ * any channel go through an SclshOutput.
+ *
+ * Line ends are \n or \r\n and are not part of the returned lines.
+ */
+typedef struct SclshChannel_s SclshChannel;
+
+// Mode is one of r, r+, w, w+, a, a+ as for fopen
+SclshChannel* sclsh_channel_open(const char* path, const char* mode);
+// Wraps a descriptor that stays open when the channel is closed
+SclshChannel* sclsh_channel_new_fd(int fd, int readable, int writable);
+void sclsh_channel_close(SclshChannel* chan);  // Flushes first
+
+// Returns 1 and a new reference to the next line, 0 at end of file or
+// -1 on error
+int sclsh_channel_gets(SclshChannel* chan, SclshValue** line);
+// Reads up to max bytes, or everything left when max is SIZE_MAX
+SclshValue* sclsh_channel_read(SclshChannel* chan, size_t max);
+int sclsh_channel_seek(SclshChannel* chan, off_t offset, int whence);
+// True once a read has run into the end of the file
+int sclsh_channel_eof(SclshChannel* chan);
+// True if the last read on a non-blocking channel found no complete line
+// or fewer bytes than requested; gets then reports end of file without
+// sclsh_channel_eof being set
+int sclsh_channel_blocked(SclshChannel* chan);
+int sclsh_channel_set_blocking(SclshChannel* chan, int blocking);
+// Descriptor of the channel, -1 for mapped files
+int sclsh_channel_fd(SclshChannel* chan);
+// True if input is buffered and can be read without touching the descriptor
+int sclsh_channel_pending(SclshChannel* chan);
+// Write side of the channel, NULL for read-only channels
+SclshOutput* sclsh_channel_output(SclshChannel* chan);
+
+// Channels opened by scripts are known by name. stdin and stderr are
+// always present; stdout is the interpreter output.
+const char* sclsh_interpreter_add_channel(SclshInterpreter* interp, SclshChannel* chan);
+SclshChannel* sclsh_interpreter_channel(SclshInterpreter* interp, const char* name);
+int sclsh_interpreter_close_channel(SclshInterpreter* interp, const char* name);
+// Output of a writable channel or stdout; reports unknown names
+SclshOutput* sclsh_interpreter_channel_output(SclshInterpreter* interp, const char* name);
+
+void sclsh_register_channel_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__CHANNEL_H
@@ -0,0 +1,85 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__EVENT_H
+#define H__SCLSH__EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/channel.h>
+
+/* Event loop of an interpreter, created on first use.
+ *
+ * Descriptors are watched with a level-triggered epoll instance. All
+ * timers share one timerfd, armed for the earliest deadline of a heap,
+ * which is registered in the same epoll instance. The epoll descriptor
+ * therefore becomes readable whenever anything is due, so an embedder
+ * can add sclsh_event_loop_fd to its own poll set and call
+ * sclsh_event_loop_run_once when it fires.
+ *
+ * Handlers run at global level. A handler that fails reports the error
+ * on stderr and the loop carries on.
+ */
+typedef struct SclshEventLoop_s SclshEventLoop;
+
+typedef enum {
+    SCLSH_EVENT_READABLE = 1,
+    SCLSH_EVENT_WRITABLE = 2,
+} SclshEventKind;
+
+// Returns 1 on success, 0 on error
+typedef int (*SclshEventCallback)(SclshInterpreter* interp, void* user_data);
+
+SclshEventLoop* sclsh_interpreter_event_loop(SclshInterpreter* interp);
+
+int sclsh_event_loop_fd(SclshEventLoop* loop);
+// Waits up to timeout_ms (-1 forever, 0 not at all) and runs every
+// handler that is due. Returns the number of handlers run or -1.
+int sclsh_event_loop_run_once(SclshEventLoop* loop, long timeout_ms);
+// True while any timer or descriptor handler is registered
+int sclsh_event_loop_has_handlers(SclshEventLoop* loop);
+
+// Returns the timer id, never 0
+unsigned long sclsh_event_after(
+    SclshEventLoop* loop,
+    long delay_ms,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+);
+int sclsh_event_cancel(SclshEventLoop* loop, unsigned long id);
+
+// Replaces the handler for one kind of event on fd; a NULL callback
+// removes it. Regular files cannot be polled and are always ready.
+int sclsh_event_watch(
+    SclshEventLoop* loop,
+    int fd,
+    SclshEventKind kind,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+);
+// Like sclsh_event_watch, but input already buffered in the channel
+// counts as readable
+int sclsh_event_watch_channel(
+    SclshEventLoop* loop,
+    SclshChannel* chan,
+    SclshEventKind kind,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+);
+void sclsh_event_unwatch(SclshEventLoop* loop, int fd);
+
+void sclsh_register_event_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__EVENT_H
@@ -0,0 +1,57 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__EXEC_H
+#define H__SCLSH__EXEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/ast.h>
+
+#include <sys/types.h>
+
+/* External commands and pipelines.
+ *
+ * A command line containing a bare `|` or a redirection operator
+ * (`<`, `>`, `>>`, `2>`, `2>>`, `2>&1`), or whose first word is not a
+ * registered command, is run here. Executables are found through a
+ * per-interpreter cache of PATH lookups and started with posix_spawn;
+ * the programs of a pipeline run concurrently. Builtins may appear as
+ * pipeline stages and run in-process with their standard streams
+ * redirected, one after another. A stage feeding an in-process stage,
+ * builtin or program, writes to a memory file rather than a pipe, and
+ * the reader starts once the writer has finished.
+ *
+ * A stage made of redirections only, such as `< in.log > out.log` or
+ * `< big.log | grep x`, copies its input to its output inside the
+ * kernel (see sclsh_copy_fd). `> file` on its own just creates the file.
+ *
+ * The result is the exit status of the last stage (128 + signal number
+ * for a stage killed by a signal), or the result of the last stage when
+ * that is a builtin.
+ */
+
+int sclsh_exec_is_pipeline(SclshNodeList* command_line);
+SclshValue* sclsh_exec_command_line(SclshContext* ctx, SclshNodeList* command_line);
+// Runs an external command whose words have been evaluated already
+SclshValue* sclsh_exec_words(SclshContext* ctx, size_t argc, SclshValue** argv);
+
+// Returns the cached absolute path of an executable, or NULL if not found.
+// Names containing a slash are returned as-is.
+const char* sclsh_exec_resolve(SclshInterpreter* interp, const char* name);
+
+// Copies everything from in_fd to out_fd using copy_file_range, sendfile
+// or splice where the descriptor types allow, falling back to read/write.
+// Returns the number of bytes copied or -1 with errno set.
+ssize_t sclsh_copy_fd(int in_fd, int out_fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__EXEC_H
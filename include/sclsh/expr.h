@@ -7,5 +7,9 @@
 double sclsh_expr_eval_double(SclshContext* ctx, SclshValue* expr);
 int sclsh_expr_eval_bool(SclshContext* ctx, SclshValue* expr);
 SclshValue* sclsh_expr_eval(SclshContext* ctx, SclshValue* expr);
+// Evaluates the words of an expression as given, e.g. the arguments of
+// expr, without joining them into a list first. Comparisons yield "1" or
+// "0", anything else a real number.
+SclshValue* sclsh_expr_eval_words(SclshContext* ctx, size_t count, SclshValue** words);
 
 #endif // H__SCLSH__EXPR_H
\ No newline at end of file
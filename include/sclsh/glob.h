@@ -0,0 +1,32 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__GLOB_H
+#define H__SCLSH__GLOB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/value.h>
+#include <stdbool.h>
+
+/* Glob patterns as used by string match, switch -glob and lsearch.
+ *
+ * * matches any run of bytes, ? any single byte and [...] one of a set
+ * of bytes given one by one or as ranges such as a-z; a backslash makes
+ * the byte after it literal. A pattern is compiled into a bit-parallel
+ * automaton the first time it is matched and kept as a representation
+ * of its value, so matching is linear in the length of the string
+ * whatever the pattern, and a pattern used over and over compiles once.
+ */
+
+bool sclsh_glob_match(SclshValue* pattern, SclshStringBuffer string);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__GLOB_H
@@ -0,0 +1,32 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__IMAGE_H
+#define H__SCLSH__IMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+
+/* Interpreter images capture the script-level state of an initialized
+ * interpreter (global variables and procedures) so that a later process
+ * can skip sourcing its prelude. Loading maps the image and refers to
+ * its bytes in place; a procedure is compiled when it is first called.
+ * Commands implemented in C are not part of the image; register them
+ * before loading one.
+ *
+ * Both functions return 1 on success and 0 on failure. An image written
+ * by a different sclsh version is rejected.
+ */
+int sclsh_image_save(SclshInterpreter* interp, const char* path);
+int sclsh_image_load(SclshInterpreter* interp, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__IMAGE_H
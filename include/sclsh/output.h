@@ -0,0 +1,72 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__OUTPUT_H
+#define H__SCLSH__OUTPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Buffered output channel. Every interpreter writes its standard output
+ * (puts and friends) through one of these instead of stdio, so output is
+ * batched into large writev calls and embedders can redirect it.
+ *
+ * Data is collected in a buffer and handed to the sink when the buffer
+ * fills, on sclsh_output_flush, or at every newline in line-buffered
+ * mode. Writes larger than the free space go to the sink directly,
+ * together with what is already buffered, without being copied.
+ */
+typedef struct SclshOutput_s SclshOutput;
+
+typedef enum {
+    SCLSH_OUTPUT_FULL,  // Flush only when the buffer fills
+    SCLSH_OUTPUT_LINE,  // Flush after every complete line
+    SCLSH_OUTPUT_NONE,  // Pass every write straight to the sink
+} SclshOutputBuffering;
+
+// Sinks receive batches of data and return the number of bytes consumed
+// or -1 on error; partial writes are retried with the remainder
+typedef ssize_t (*SclshOutputWriteFunc)(void* user_data, const struct iovec* iov, int iovcnt);
+
+typedef struct SclshOutputSink_s {
+    SclshOutputWriteFunc write;
+    void* user_data;
+    SclshUserDataDestructor* user_data_destructor;
+} SclshOutputSink;
+
+// Writes to a file descriptor, which is not closed on free. Terminals
+// are line-buffered, anything else is fully buffered.
+SclshOutput* sclsh_output_new_fd(int fd);
+SclshOutput* sclsh_output_new_sink(SclshOutputSink sink, SclshOutputBuffering buffering);
+// Collects everything written in memory, see sclsh_output_memory_value
+SclshOutput* sclsh_output_new_memory(void);
+void sclsh_output_free(SclshOutput* out);  // Flushes first
+
+void sclsh_output_set_buffering(SclshOutput* out, SclshOutputBuffering buffering);
+
+int sclsh_output_write(SclshOutput* out, const char* bytes, size_t length);
+int sclsh_output_writev(SclshOutput* out, const struct iovec* iov, int iovcnt);
+int sclsh_output_flush(SclshOutput* out);
+
+// Returns everything captured so far by a memory output
+SclshValue* sclsh_output_memory_value(SclshOutput* out);
+
+SclshOutput* sclsh_interpreter_output(SclshInterpreter* interp);
+// Installs a new standard output and returns the previous one, which is
+// flushed and now belongs to the caller
+SclshOutput* sclsh_interpreter_set_output(SclshInterpreter* interp, SclshOutput* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__OUTPUT_H
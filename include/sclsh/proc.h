@@ -0,0 +1,56 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__PROC_H
+#define H__SCLSH__PROC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+
+/* Script-defined procedures.
+ *
+ * proc name params body defines a command. Each parameter is a name or a
+ * {name default} pair; a last parameter named args collects the remaining
+ * arguments as a list. The body is compiled when the procedure is
+ * defined: every variable it names literally gets a slot in the context
+ * of a call, which is carved out of a per-run arena instead of a hash
+ * table of its own. Variables whose names are only known at run time
+ * still go to a hash table, created on first use.
+ *
+ * A call in tail position reuses the frame of the caller.
+ *
+ * Commands that the compiler turns into jumps and stores (set, if,
+ * while, for, foreach, incr, break, continue and return) cannot be
+ * redefined.
+ */
+
+// Returns 1 on success and 0 if params is malformed or name is one of
+// the commands that cannot be redefined
+int sclsh_proc_define(
+    SclshInterpreter* interp,
+    const char* name,
+    SclshValue* params,
+    SclshValue* body
+);
+
+typedef void (*SclshProcCallback)(
+    const char* name,
+    SclshValue* params,
+    SclshValue* body,
+    void* user_data
+);
+void sclsh_for_each_proc(SclshInterpreter* interp, SclshProcCallback callback, void* user_data);
+
+void sclsh_register_proc_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__PROC_H
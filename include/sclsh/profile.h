@@ -0,0 +1,75 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__PROFILE_H
+#define H__SCLSH__PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-command profile of an interpreter.
+ *
+ * While profiling is on, the dispatcher of the VM counts every command it
+ * invokes and times it with the monotonic clock. A command that runs a
+ * script (a procedure, a loop) is timed until that script finishes:
+ * inclusive time covers the commands it runs in turn, exclusive time
+ * leaves them out. Time a command spends in a recursive call of itself
+ * is counted again for the outer call. A coroutine is timed while it
+ * runs, not while it is suspended.
+ *
+ * When profiling is off the dispatcher pays a single test of a pointer.
+ */
+
+typedef struct SclshProfileEntry_s {
+    const char* name;  // Valid until profiling is started again
+    uint64_t calls;
+    uint64_t inclusive_ns;
+    uint64_t exclusive_ns;
+    uint64_t allocations;  // Heap blocks allocated for values by the command itself
+} SclshProfileEntry;
+
+// Discards the previous results and starts counting
+void sclsh_profile_start(SclshInterpreter* interp);
+// Stops counting, keeping the results
+void sclsh_profile_stop(SclshInterpreter* interp);
+int sclsh_profile_running(SclshInterpreter* interp);
+
+// Stores a malloc'ed array of the results, sorted by exclusive time, in
+// *entries and returns its length
+size_t sclsh_profile_results(SclshInterpreter* interp, SclshProfileEntry** entries);
+
+/* Sampling profiler.
+ *
+ * A timer on the CPU time of the calling thread interrupts it rate_hz
+ * times a second and records which commands are running, outermost
+ * first. The samples are summed up per distinct stack in the collapsed
+ * format of flame graph tools: one "outer;inner;innermost count" line
+ * per stack. Only one interpreter in a process can sample at a time.
+ */
+#define SCLSH_DEFAULT_SAMPLE_RATE 1000
+
+// Discards the previous samples. Returns 1 on success, 0 on error.
+int sclsh_sample_start(SclshInterpreter* interp, unsigned rate_hz);
+void sclsh_sample_stop(SclshInterpreter* interp);
+// Samples so far in collapsed format
+SclshValue* sclsh_sample_collapsed(SclshInterpreter* interp);
+// Samples lost because they came faster than they were collected
+size_t sclsh_sample_dropped(SclshInterpreter* interp);
+
+// profile start|stop|report, profile sample start|stop|collapsed, and
+// time and bench, which time a script from inside the interpreter
+void sclsh_register_profile_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__PROFILE_H
@@ -0,0 +1,34 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__REGEXP_H
+#define H__SCLSH__REGEXP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+
+/* Regular expressions: the regexp and regsub commands.
+ *
+ * Expressions are POSIX extended regular expressions. One is compiled
+ * the first time it is used and kept as a representation of its value,
+ * like a list or compiled code, so matching in a loop compiles the
+ * pattern once; using it with a different -nocase recompiles it.
+ * Matches and captured groups are slices of the string matched against
+ * rather than copies.
+ *
+ * regexp ?-nocase? ?-all? ?-inline? ?--? <exp> <string> ?matchVar? ?subMatchVar ...?
+ * regsub ?-nocase? ?-all? ?--? <exp> <string> <subSpec> ?varName?
+ */
+
+void sclsh_register_regexp_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__REGEXP_H
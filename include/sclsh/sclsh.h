@@ -15,6 +15,8 @@ extern "C" {
 #include <stdlib.h>
 #include <stdint.h>
 
+#define SCLSH_VERSION "0.1.0"
+
 typedef struct SclshInterpreter_s SclshInterpreter;
 
 SclshInterpreter* sclsh_create_interpreter(void);
@@ -26,11 +28,27 @@ SclshContext* sclsh_create_context(SclshInterpreter* interp);
 void sclsh_destroy_context(SclshContext* ctx);
 SclshContext* sclsh_global_context(SclshInterpreter* interp);
 
+SclshInterpreter* sclsh_context_interpreter(SclshContext* ctx);
+
 void sclsh_context_set_variable(SclshContext* ctx, const char* name, SclshValue* value);
 SclshValue* sclsh_context_get_variable(SclshContext* ctx, const char* name);
 
+typedef void (*SclshVariableCallback)(
+    const char* name,
+    SclshValue* value,
+    void* user_data
+);
+void sclsh_context_for_each_variable(
+    SclshContext* ctx,
+    SclshVariableCallback callback,
+    void* user_data
+);
+
 typedef struct SclshCommand_s SclshCommand;
 SclshCommand* sclsh_get_command(SclshInterpreter* interp, const char* name);
+// Looks the name up by its length and bytes, so a name with a null byte
+// in it never finds the command named by the part before
+SclshCommand* sclsh_get_command_buffer(SclshInterpreter* interp, SclshStringBuffer name);
 
 typedef SclshValue* (*SclshCommandFunc)(
     SclshContext* ctx, 
@@ -49,6 +67,8 @@ SclshCommand* sclsh_command_new(
 );
 
 SclshValue* sclsh_eval(SclshContext* ctx, SclshValue* ast);
+SclshValue* sclsh_eval_script(SclshContext* ctx, SclshValue* script);
+SclshValue* sclsh_eval_file(SclshContext* ctx, const char* path);
 
 #ifdef __cplusplus
 }   // extern "C"
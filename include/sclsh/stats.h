@@ -0,0 +1,72 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__STATS_H
+#define H__SCLSH__STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/value.h>
+#include <stdint.h>
+
+/* Runtime statistics.
+ *
+ * Every thread counts how values are created and freed, how often their
+ * cached representations are found or have to be built from the string
+ * again (a list that keeps being regenerated and reparsed shows up as
+ * conversions), hash map traffic and the bytes handed to the parser. The
+ * counters are plain thread-local increments; building with the meson
+ * option stats=false compiles them out, leaving them at zero.
+ */
+
+typedef struct SclshRepStats_s {
+    uint64_t hits;  // The representation was cached
+    uint64_t conversions;  // It had to be built
+} SclshRepStats;
+
+typedef struct SclshStats_s {
+    uint64_t values_copied;  // Values owning a copy of their bytes
+    uint64_t values_sliced;  // Values borrowing bytes of another
+    uint64_t values_mapped;  // Values wrapping a file mapping
+    uint64_t values_recycled;  // Values that took the memory of a freed one
+    uint64_t strings_inline;  // Copied values short enough to hold their bytes
+    uint64_t values_updated;  // Values rewritten in place by incr and append
+    uint64_t strings_grown;  // Reallocations of strings growing in place
+    uint64_t values_freed;
+    uint64_t slices_freed;
+    uint64_t mappings_freed;
+    uint64_t slices_materialized;  // Slices that needed a copy after all
+    uint64_t reps_dropped;  // Representations thrown away while the value lives on
+    SclshRepStats list;
+    SclshRepStats script;  // Commands of a script
+    SclshRepStats command_line;
+    SclshRepStats interpolation;
+    SclshRepStats code;  // Compiled code
+    SclshRepStats glob;  // Compiled glob patterns
+    SclshRepStats regex;  // Compiled regular expressions
+    SclshRepStats chars;  // Character offsets of UTF-8 strings
+    uint64_t hash_lookups;
+    uint64_t hash_probes;  // Entries compared while looking up
+    uint64_t hash_resizes;
+    uint64_t parsed_bytes;
+} SclshStats;
+
+// Counters of the calling thread since it started or was last reset
+void sclsh_stats_snapshot(SclshStats* stats);
+void sclsh_stats_reset(void);
+// Heap blocks allocated for values: new values that could not take the
+// place of a freed one, copies too long to be kept inline and strings
+// reallocated to grow
+uint64_t sclsh_stats_value_allocations(const SclshStats* stats);
+// The snapshot as a list of names and values, as `interp stats` returns it
+SclshValue* sclsh_stats_to_value(const SclshStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__STATS_H
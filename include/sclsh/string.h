@@ -0,0 +1,42 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__STRING_H
+#define H__SCLSH__STRING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+
+/* String commands.
+ *
+ * string length, index, range, first, last, map, repeat, trim,
+ * trimleft, trimright, toupper, tolower, equal, compare and match,
+ * append, and lsearch, which finds a string in a list. Strings are
+ * UTF-8 and indices count characters; an index is an integer, end or
+ * end-N. Case mapping and -nocase only know ASCII letters, trim takes
+ * its set of characters as bytes. Patterns are globs (see glob.h).
+ *
+ * A string's characters are indexed the first time they are counted:
+ * an ASCII string's bytes are its characters, any other string keeps
+ * the byte offset of every 64th character as a representation of its
+ * value. Walking a string with string index takes constant time per
+ * character either way.
+ *
+ * Results are sized before they are built, so each takes one allocation
+ * at most, and commands that would return their argument unchanged
+ * return the argument itself. append grows the variable's value in
+ * place when nothing else refers to it.
+ */
+
+void sclsh_register_string_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__STRING_H
@@ -0,0 +1,70 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__THREAD_CHANNEL_H
+#define H__SCLSH__THREAD_CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+
+/* Bounded lock-free message queue for passing values between interpreters
+ * running on different threads. Values are handed off by ownership: the
+ * sender's reference moves into the channel and the receiver gets it back
+ * without copying. A value that is still shared by the sender is copied
+ * instead, as reference counts are not atomic.
+ */
+typedef struct SclshThreadChannel_s SclshThreadChannel;
+
+typedef enum {
+    SCLSH_THREAD_CHANNEL_MPMC = 0,  // Any number of senders and receivers
+    SCLSH_THREAD_CHANNEL_SPSC = 1,  // Exactly one sender and one receiver thread
+} SclshThreadChannelMode;
+
+typedef enum {
+    SCLSH_THREAD_CHANNEL_OK,
+    SCLSH_THREAD_CHANNEL_EMPTY,
+    SCLSH_THREAD_CHANNEL_FULL,
+    SCLSH_THREAD_CHANNEL_TIMEOUT,
+    SCLSH_THREAD_CHANNEL_CLOSED,
+} SclshThreadChannelStatus;
+
+// Capacity is rounded up to a power of two and may be at most 2^30; the
+// channel is registered under a process-wide name so other interpreters
+// can find it
+SclshThreadChannel* sclsh_thread_channel_new(size_t capacity, SclshThreadChannelMode mode);
+SclshThreadChannel* sclsh_thread_channel_ref(SclshThreadChannel* chan);
+void sclsh_thread_channel_unref(SclshThreadChannel* chan);
+SclshThreadChannel* sclsh_thread_channel_lookup(const char* name);
+const char* sclsh_thread_channel_name(SclshThreadChannel* chan);
+
+// Send and receive take and return ownership of one reference.
+// Negative timeout waits forever, zero does not wait at all.
+SclshThreadChannelStatus sclsh_thread_channel_send(
+    SclshThreadChannel* chan,
+    SclshValue* value,
+    long timeout_ms
+);
+SclshThreadChannelStatus sclsh_thread_channel_recv(
+    SclshThreadChannel* chan,
+    SclshValue** value,
+    long timeout_ms
+);
+SclshThreadChannelStatus sclsh_thread_channel_try_recv(
+    SclshThreadChannel* chan,
+    SclshValue** value
+);
+void sclsh_thread_channel_close(SclshThreadChannel* chan);
+
+void sclsh_register_thread_channel_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__THREAD_CHANNEL_H
@@ -22,6 +22,8 @@ typedef struct SclshStringBuffer_s {
 #define SCLSH_STRING_BUFFER(str) (SclshStringBuffer){ str, strlen(str) }
 
 extern uint32_t sclsh_fnv_hash(char* string);
+extern uint32_t sclsh_fnv_hash_bytes(const char* bytes, size_t length);  // Same hash for a string without its terminator
+extern uint64_t sclsh_fnv_hash64(const char* bytes, size_t length);  // A word at a time, for long inputs
 extern uint32_t sclsh_pointer_hash(void* pointer);
 
 typedef struct SclshStringBuilder_s SclshStringBuilder;
@@ -46,6 +48,11 @@ void sclsh_hash_map_free(SclshHashMap* map);
 void sclsh_hash_map_set(SclshHashMap* map, const char* key, void* value);
 void* sclsh_hash_map_get(SclshHashMap* map, const char* key);
 void sclsh_hash_map_remove(SclshHashMap* map, const char* key);
+// Keys are compared by length and bytes, so they may contain null bytes;
+// a key given as a C string is one without
+void sclsh_hash_map_set_buffer(SclshHashMap* map, SclshStringBuffer key, void* value);
+void* sclsh_hash_map_get_buffer(SclshHashMap* map, SclshStringBuffer key);
+void sclsh_hash_map_remove_buffer(SclshHashMap* map, SclshStringBuffer key);
 void sclsh_hash_map_for_each(
     SclshHashMap* map, 
     SclshHashMapIteratorCallback callback, 
@@ -23,6 +23,13 @@ typedef struct s_SclshValueList SclshValueList;
 SclshValue* sclsh_value_new(const char* string, 
                             size_t length);
 SclshValue* sclsh_value_from_cstr(const char* str);
+// Shared values of the calling thread that are never freed. Returning
+// one from a command costs no allocation; references to them are taken
+// and dropped like to any other value.
+SclshValue* sclsh_value_empty(void);
+SclshValue* sclsh_value_zero(void);
+SclshValue* sclsh_value_one(void);
+SclshValue* sclsh_value_boolean(bool b);  // "1" or "0"
 SclshValue* sclsh_value_ref(SclshValue* value);
 void sclsh_value_unref(SclshValue* value);
 
@@ -31,7 +38,11 @@ SclshValueList* sclsh_value_as_proc(SclshValue* value);
 
 void sclsh_value_list_free(SclshValueList* list);
 
+// The returned buffer is null-terminated and owned by the value
 SclshStringBuffer sclsh_value_as_string(SclshValue* value);
+// Same bytes without the null-termination guarantee, which saves copying
+// slices of file mappings (see channel.h)
+SclshStringBuffer sclsh_value_as_bytes(SclshValue* value);
 SclshValue* sclsh_string_builder_to_value(SclshStringBuilder* sb);
 
 typedef struct SclshListBuilder_s SclshListBuilder;
@@ -43,6 +54,9 @@ SclshValueList* sclsh_list_builder_value_list(SclshListBuilder* builder);
 SclshValue* sclsh_list_builder_value(SclshListBuilder* builder);
 
 SclshValue* sclsh_value_new_from_list(SclshValue** items, size_t count);
+// The bytes of count values one after another, sized up front and copied
+// into a single allocation
+SclshValue* sclsh_value_concat(SclshValue** parts, size_t count);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,73 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__VM_H
+#define H__SCLSH__VM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sclsh/sclsh.h>
+#include <sclsh/value.h>
+
+/* Scripts are compiled to a flat instruction sequence and run by a loop
+ * that keeps its frames and temporaries on heap-allocated stacks, so
+ * script-level nesting never recurses in C.
+ *
+ * A command that evaluates a script (a loop body, say) should not call
+ * sclsh_eval_script, which starts a separate run on the C stack, but
+ * return sclsh_eval_then. The script then runs as a new frame of the
+ * current run and the continuation receives its result, in the manner of
+ * Tcl's non-recursive engine. A script evaluated in tail position without
+ * a continuation reuses the frame of its caller. Such commands can be suspended by yield
+ * inside a coroutine; a yield that would have to cross a C call fails.
+ */
+
+// Receives the result of the script (a new reference) or NULL if it
+// failed, and returns what the command returns: a value, NULL for an
+// error, or the result of another sclsh_eval_then
+typedef SclshValue* (*SclshContinuation)(SclshContext* ctx, SclshValue* result, void* data);
+
+// Must be the last thing a command or continuation does, as its result
+// is what the caller returns. With a NULL continuation the result of the
+// script becomes the result of the command.
+SclshValue* sclsh_eval_then(
+    SclshContext* ctx,
+    SclshValue* script,
+    SclshContinuation then,
+    void* data
+);
+
+// Calls a command from C, e.g. to run it as a pipeline stage
+SclshValue* sclsh_command_invoke(
+    SclshContext* ctx,
+    SclshCommand* command,
+    size_t argc,
+    SclshValue** argv
+);
+
+// Evaluation nested deeper than this many frames fails with an error
+// rather than exhausting memory. Frames live on the heap, so the limit
+// can be raised freely; `interp recursionlimit` sets it from scripts.
+#define SCLSH_DEFAULT_RECURSION_LIMIT 1000
+
+size_t sclsh_recursion_limit(SclshInterpreter* interp);
+void sclsh_set_recursion_limit(SclshInterpreter* interp, size_t limit);
+
+// Name of the innermost running coroutine, NULL outside of coroutines
+const char* sclsh_current_coroutine(SclshInterpreter* interp);
+
+// eval, coroutine, yield and info
+void sclsh_register_vm_commands(SclshInterpreter* interp);
+// if, while, for, foreach, break, continue, return and incr for the cases
+// the compiler leaves to run time, see control.c
+void sclsh_register_control_commands(SclshInterpreter* interp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H__SCLSH__VM_H
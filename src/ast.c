@@ -6,6 +6,7 @@
 #include <sclsh/ast.h>
 #include <sclsh/parse.h>
 #include "value.h"
+#include "stats.h"
 
 void sclsh_node_list_free(SclshNodeList* node_list) {
     if (!node_list) {
@@ -24,7 +25,11 @@ SclshNodeList* sclsh_value_as_interpolation(SclshValue* value) {
     if (!value){
         return NULL;
     }
-    if (!value->as_interpolation) {
+    if (value->as_interpolation) {
+        SCLSH_STAT(interpolation.hits);
+    } else {
+        SCLSH_STAT(interpolation.conversions);
+        SCLSH_STAT_ADD(parsed_bytes, value->length);
         value->as_interpolation = sclsh_parse_interpolation(sclsh_value_as_string(value));
         if (!value->as_interpolation) {
             return NULL;  // Failed to parse as interpolation
@@ -36,7 +41,11 @@ SclshNodeList* sclsh_value_as_command_line(SclshValue* value) {
     if (!value) {
         return NULL;
     }
-    if (!value->as_command_line) {
+    if (value->as_command_line) {
+        SCLSH_STAT(command_line.hits);
+    } else {
+        SCLSH_STAT(command_line.conversions);
+        SCLSH_STAT_ADD(parsed_bytes, value->length);
         value->as_command_line = sclsh_parse_command_line(sclsh_value_as_string(value));
         if (!value->as_command_line) {
             return NULL;  // Failed to parse as command line
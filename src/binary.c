@@ -0,0 +1,399 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/binary.h>
+#include <sclsh/value.h>
+#include "value.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BIG_ENDIAN true
+#else
+#define HOST_BIG_ENDIAN false
+#endif
+
+typedef struct Field_s {
+    char type;
+    bool is_unsigned;  // u after the type
+    bool has_count;
+    bool all;  // The count is *
+    size_t count;  // 1 without one
+} Field;
+
+// Reads the field at *pos, skipping blanks before it. Returns false at
+// the end of the format.
+static bool next_field(SclshStringBuffer format, size_t* pos, Field* field) {
+    while (*pos < format.length && isspace((unsigned char)format.string[*pos])) {
+        (*pos)++;
+    }
+    if (*pos == format.length) {
+        return false;
+    }
+    memset(field, 0, sizeof(Field));
+    field->type = format.string[(*pos)++];
+    field->count = 1;
+    if (*pos < format.length && format.string[*pos] == 'u') {
+        field->is_unsigned = true;
+        (*pos)++;
+    }
+    if (*pos < format.length && format.string[*pos] == '*') {
+        field->has_count = true;
+        field->all = true;
+        (*pos)++;
+    } else if (*pos < format.length && isdigit((unsigned char)format.string[*pos])) {
+        field->has_count = true;
+        field->count = 0;
+        while (*pos < format.length && isdigit((unsigned char)format.string[*pos])) {
+            field->count = field->count * 10 + (size_t)(format.string[(*pos)++] - '0');
+        }
+    }
+    return true;
+}
+
+// Width in bytes of a number type, 0 if the letter is not one
+static size_t number_width(char type, bool* big, bool* real) {
+    *big = false;
+    *real = false;
+    switch (type) {
+        case 'c': return 1;
+        case 'S': *big = true; // Fall through
+        case 's': return 2;
+        case 'I': *big = true; // Fall through
+        case 'i': return 4;
+        case 'W': *big = true; // Fall through
+        case 'w': return 8;
+        case 'R': *big = true; // Fall through
+        case 'r': *real = true; return 4;
+        case 'Q': *big = true; // Fall through
+        case 'q': *real = true; return 8;
+        case 'f': *big = HOST_BIG_ENDIAN; *real = true; return 4;
+        case 'd': *big = HOST_BIG_ENDIAN; *real = true; return 8;
+        default: return 0;
+    }
+}
+
+static void put_number(char* out, uint64_t bits, size_t width, bool big) {
+    for (size_t k = 0; k < width; k++) {
+        out[big ? width - 1 - k : k] = (char)(bits >> (8 * k));
+    }
+}
+
+static uint64_t get_number(const char* in, size_t width, bool big) {
+    uint64_t bits = 0;
+    for (size_t k = 0; k < width; k++) {
+        bits |= (uint64_t)(unsigned char)in[big ? width - 1 - k : k] << (8 * k);
+    }
+    return bits;
+}
+
+// An integer in decimal or, after 0x, in hexadecimal, with an optional
+// sign. Anything from -2^63 to 2^64 - 1 fits, negative numbers in two's
+// complement.
+static bool parse_integer(const char* string, uint64_t* bits) {
+    const char* digits = string;
+    bool negative = *digits == '-';
+    if (*digits == '-' || *digits == '+') {
+        digits++;
+    }
+    int base = 10;
+    if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        base = 16;
+        digits += 2;
+    }
+    if (base == 10 ? !isdigit((unsigned char)*digits) : !isxdigit((unsigned char)*digits)) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    unsigned long long n = strtoull(digits, &end, base);
+    if (*end != '\0' || errno == ERANGE || (negative && n > (unsigned long long)LLONG_MAX + 1)) {
+        return false;
+    }
+    *bits = negative ? (uint64_t)0 - n : n;
+    return true;
+}
+
+// The bits a number argument is stored as. Integers may also be given
+// as integral reals, such as expr produces.
+static bool number_bits(SclshValue* value, size_t width, bool real, uint64_t* bits) {
+    char* string = sclsh_value_as_string(value).string;
+    if (!real && parse_integer(string, bits)) {
+        return true;
+    }
+    char* end;
+    double d = strtod(string, &end);
+    if (end == string || *end != '\0' || (!real && d != floor(d))) {
+        fprintf(stderr, "Expected %s but got '%s'\n", real ? "number" : "integer", string);
+        return false;
+    }
+    if (!real && (d < -9223372036854775808.0 || d >= 18446744073709551616.0)) {
+        fprintf(stderr, "Integer '%s' does not fit in 64 bits\n", string);
+        return false;
+    }
+    if (!real) {
+        *bits = d < 0 ? (uint64_t)(long long)d : (uint64_t)d;
+    } else if (width == 4) {
+        float f = (float)d;
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        *bits = u;
+    } else {
+        memcpy(bits, &d, sizeof(d));
+    }
+    return true;
+}
+
+static SclshValue* number_value(uint64_t bits, size_t width, bool real, bool is_unsigned) {
+    char buffer[32];
+    int length;
+    if (real) {
+        double d;
+        if (width == 4) {
+            uint32_t u = (uint32_t)bits;
+            float f;
+            memcpy(&f, &u, sizeof(f));
+            d = f;
+        } else {
+            memcpy(&d, &bits, sizeof(d));
+        }
+        length = snprintf(buffer, sizeof(buffer), "%.*g", width == 4 ? 9 : 17, d);
+        return sclsh_value_new(buffer, (size_t)length);
+    }
+    if (is_unsigned) {
+        length = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)bits);
+        return sclsh_value_new(buffer, (size_t)length);
+    }
+    if (width < 8 && (bits >> (8 * width - 1)) & 1) {
+        bits |= ~(uint64_t)0 << (8 * width);  // Extend the sign
+    }
+    return sclsh_value_with_integer(NULL, (long long)bits);
+}
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Lays the arguments out as format says. Without out this only measures
+ * the result, into *length, checking no more than that the arguments are
+ * there; with out it writes the bytes and converts the arguments, which
+ * may still fail.
+ */
+static bool format_fields(SclshStringBuffer format, size_t argc, SclshValue** argv, char* out, size_t* length) {
+    size_t pos = 0;
+    size_t arg = 0;
+    size_t at = 0;
+    Field field;
+    while (next_field(format, &pos, &field)) {
+        if (field.type == 'x') {
+            size_t count = field.all ? 0 : field.count;
+            if (out) {
+                memset(out + at, 0, count);
+            }
+            at += count;
+            continue;
+        }
+        bool big, real;
+        size_t width = number_width(field.type, &big, &real);
+        if (!width && field.type != 'a' && field.type != 'A' && field.type != 'H') {
+            fprintf(stderr, "binary format: unknown field type '%c'\n", field.type);
+            return false;
+        }
+        if (arg == argc) {
+            fprintf(stderr, "binary format: no argument for field '%c'\n", field.type);
+            return false;
+        }
+        SclshValue* value = argv[arg++];
+
+        if (field.type == 'a' || field.type == 'A') {
+            SclshStringBuffer bytes = sclsh_value_as_bytes(value);
+            size_t count = field.all ? bytes.length : field.count;
+            if (out) {
+                size_t copied = count < bytes.length ? count : bytes.length;
+                memcpy(out + at, bytes.string, copied);
+                memset(out + at + copied, field.type == 'a' ? '\0' : ' ', count - copied);
+            }
+            at += count;
+        } else if (field.type == 'H') {
+            SclshStringBuffer digits = sclsh_value_as_bytes(value);
+            size_t count = field.all ? digits.length : field.count;
+            for (size_t i = 0; out && i < count; i++) {
+                int nibble = i < digits.length ? hex_value(digits.string[i]) : 0;
+                if (nibble < 0) {
+                    fprintf(stderr, "binary format: bad hexadecimal digit '%c'\n", digits.string[i]);
+                    return false;
+                }
+                if (i % 2 == 0) {
+                    out[at + i / 2] = (char)(nibble << 4);
+                } else {
+                    out[at + i / 2] |= (char)nibble;
+                }
+            }
+            at += (count + 1) / 2;
+        } else {
+            SclshValue** items = &value;
+            size_t count = 1;
+            if (field.has_count) {
+                SclshValueList* list = sclsh_value_as_list(value);
+                size_t available = list ? list->count : 0;
+                count = field.all ? available : field.count;
+                if (count > available) {
+                    fprintf(stderr, "binary format: field '%c' needs a list of %zu numbers\n", field.type, count);
+                    return false;
+                }
+                items = list ? list->items : NULL;
+            }
+            for (size_t i = 0; out && i < count; i++) {
+                uint64_t bits;
+                if (!number_bits(items[i], width, real, &bits)) {
+                    return false;
+                }
+                put_number(out + at + i * width, bits, width, big);
+            }
+            at += count * width;
+        }
+    }
+    *length = at;
+    return true;
+}
+
+// binary format <format> ?arg ...?
+static SclshValue* binary_format(size_t argc, SclshValue** argv) {
+    SclshStringBuffer format = sclsh_value_as_bytes(argv[0]);
+    size_t length;
+    if (!format_fields(format, argc - 1, argv + 1, NULL, &length)) {
+        return NULL;
+    }
+    char* out;
+    SclshValue* result = sclsh_value_new_sized(length, &out);
+    if (result && !format_fields(format, argc - 1, argv + 1, out, &length)) {
+        sclsh_value_unref(result);
+        return NULL;
+    }
+    return result;
+}
+
+// binary scan <value> <format> ?var ...?, returning how many variables
+// were set: scanning stops at the first field past the end of the value
+static SclshValue* binary_scan(SclshContext* ctx, size_t argc, SclshValue** argv) {
+    SclshValue* data = argv[0];
+    SclshStringBuffer bytes = sclsh_value_as_bytes(data);
+    SclshStringBuffer format = sclsh_value_as_bytes(argv[1]);
+    SclshValue** variables = argv + 2;
+    size_t variable_count = argc - 2;
+
+    size_t pos = 0;
+    size_t at = 0;
+    size_t assigned = 0;
+    Field field;
+    while (next_field(format, &pos, &field)) {
+        size_t left = bytes.length - at;
+        if (field.type == 'x') {
+            size_t count = field.all ? left : field.count;
+            if (count > left) {
+                break;
+            }
+            at += count;
+            continue;
+        }
+        bool big, real;
+        size_t width = number_width(field.type, &big, &real);
+        if (!width && field.type != 'a' && field.type != 'A' && field.type != 'H') {
+            fprintf(stderr, "binary scan: unknown field type '%c'\n", field.type);
+            return NULL;
+        }
+        if (assigned == variable_count) {
+            fprintf(stderr, "binary scan: no variable for field '%c'\n", field.type);
+            return NULL;
+        }
+
+        SclshValue* value;
+        if (field.type == 'a' || field.type == 'A') {
+            size_t count = field.all ? left : field.count;
+            if (count > left) {
+                break;
+            }
+            size_t length = count;
+            while (field.type == 'A' && length > 0
+                   && (bytes.string[at + length - 1] == ' ' || bytes.string[at + length - 1] == '\0')) {
+                length--;
+            }
+            value = sclsh_value_new_slice(data, at, length);
+            at += count;
+        } else if (field.type == 'H') {
+            size_t count = field.all ? 2 * left : field.count;
+            if ((count + 1) / 2 > left) {
+                break;
+            }
+            char* out;
+            value = sclsh_value_new_sized(count, &out);
+            for (size_t i = 0; value && i < count; i++) {
+                unsigned char byte = (unsigned char)bytes.string[at + i / 2];
+                out[i] = "0123456789abcdef"[i % 2 == 0 ? byte >> 4 : byte & 0x0F];
+            }
+            at += (count + 1) / 2;
+        } else if (!field.has_count) {
+            if (width > left) {
+                break;
+            }
+            value = number_value(get_number(bytes.string + at, width, big), width, real, field.is_unsigned);
+            at += width;
+        } else {
+            size_t count = field.all ? left / width : field.count;
+            if (count > left / width) {
+                break;
+            }
+            SclshListBuilder* list = sclsh_list_builder_new();
+            for (size_t i = 0; i < count; i++) {
+                SclshValue* item = number_value(get_number(bytes.string + at, width, big), width, real, field.is_unsigned);
+                sclsh_list_builder_append(list, item);
+                sclsh_value_unref(item);
+                at += width;
+            }
+            value = sclsh_list_builder_value(list);
+            sclsh_list_builder_free(list);
+        }
+        if (!value) {
+            return NULL;
+        }
+        sclsh_context_set_variable(ctx, sclsh_value_as_string(variables[assigned++]).string, value);
+        sclsh_value_unref(value);
+    }
+    return sclsh_value_with_integer(NULL, (long long)assigned);
+}
+
+static SclshValue* cmd_binary(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    char* sub = argc > 0 ? sclsh_value_as_string(argv[0]).string : "";
+    if (strcmp(sub, "format") == 0 && argc >= 2) {
+        return binary_format(argc - 1, argv + 1);
+    }
+    if (strcmp(sub, "scan") == 0 && argc >= 3) {
+        return binary_scan(ctx, argc - 1, argv + 1);
+    }
+    fprintf(stderr, "Usage: binary format <format> ?arg ...? | binary scan <value> <format> ?var ...?\n");
+    return NULL;
+}
+
+void sclsh_register_binary_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "binary", cmd_binary, NULL, NULL);
+}
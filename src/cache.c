@@ -0,0 +1,196 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/cache.h>
+#include <sclsh/sclsh.h>
+#include <sclsh/util.h>
+#include "serialize.h"
+#include "value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC 0x434c4353u  // "SCLC"
+#define CACHE_FORMAT_VERSION 4
+
+char* sclsh_cache_directory(void) {
+    const char* dir = getenv("SCLSH_CACHE_DIR");
+    return dir && *dir ? strdup(dir) : NULL;
+}
+
+static int make_directories(char* path) {
+    for (char* p = path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            int res = mkdir(path, 0755);
+            *p = '/';
+            if (res != 0 && errno != EEXIST) {
+                return 0;
+            }
+        }
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static char* cache_entry_path(uint64_t hash) {
+    char* dir = sclsh_cache_directory();
+    if (!dir) {
+        return NULL;
+    }
+    if (!make_directories(dir)) {
+        free(dir);
+        return NULL;
+    }
+    size_t length = strlen(dir) + 1 + 16 + 5 + 1;
+    char* path = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%016llx.sclc", dir, (unsigned long long)hash);
+    }
+    free(dir);
+    return path;
+}
+
+static SclshValueList* load_entry(const char* entry_path, uint64_t hash, SclshValue* script) {
+    int fd = open(entry_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    SclshValue* mapping = sclsh_value_new_mapped(map, st.st_size);
+    if (!mapping) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    // Long words are slices of the entry, which stays mapped while the
+    // parse refers to it
+    SclshReader reader = {
+        .pos = map,
+        .end = (const char*)map + st.st_size,
+        .error = 0,
+        .mapping = mapping,
+    };
+    SclshValueList* commands = NULL;
+
+    uint32_t magic = sclsh_reader_u32(&reader);
+    uint32_t format = sclsh_reader_u32(&reader);
+    SclshStringBuffer version = sclsh_reader_bytes(&reader);
+    uint64_t entry_hash = sclsh_reader_u64(&reader);
+    SclshStringBuffer source = sclsh_reader_bytes(&reader);
+
+    if (!reader.error
+        && magic == CACHE_MAGIC
+        && format == CACHE_FORMAT_VERSION
+        && version.length == strlen(SCLSH_VERSION)
+        && memcmp(version.string, SCLSH_VERSION, version.length) == 0
+        && entry_hash == hash
+        // The hash only picks the file, the source decides
+        && source.length == script->length
+        && memcmp(source.string, script->string, script->length) == 0) {
+        uint32_t count = sclsh_reader_u32(&reader);
+        SclshListBuilder* builder = sclsh_list_builder_new();
+        for (uint32_t i = 0; i < count && !reader.error; i++) {
+            SclshValue* command = sclsh_reader_value(&reader);
+            if (command) {
+                sclsh_list_builder_append(builder, command);
+                sclsh_value_unref(command);
+            }
+        }
+        if (!reader.error) {
+            commands = sclsh_list_builder_value_list(builder);
+        }
+        sclsh_list_builder_free(builder);
+    }
+
+    sclsh_value_unref(mapping);
+    return commands;
+}
+
+static void store_entry(const char* entry_path, uint64_t hash, SclshValue* script) {
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    sclsh_serialize_u32(sb, CACHE_MAGIC);
+    sclsh_serialize_u32(sb, CACHE_FORMAT_VERSION);
+    sclsh_serialize_bytes(sb, SCLSH_VERSION, strlen(SCLSH_VERSION));
+    sclsh_serialize_u64(sb, hash);
+    sclsh_serialize_bytes(sb, script->string, script->length);
+
+    sclsh_serialize_u32(sb, (uint32_t)script->as_proc->count);
+    for (size_t i = 0; i < script->as_proc->count; i++) {
+        sclsh_serialize_value(sb, script->as_proc->items[i]);
+    }
+
+    SclshStringBuffer contents = sclsh_string_builder_value(sb);
+    sclsh_string_builder_free(sb);
+    sclsh_write_file_atomic(entry_path, contents);
+    free(contents.string);
+}
+
+static SclshValue* read_source(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return sclsh_value_empty();
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot read '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    SclshValue* source = sclsh_value_new(map, st.st_size);
+    munmap(map, st.st_size);
+    return source;
+}
+
+SclshValue* sclsh_cache_load_script(const char* path) {
+    SclshValue* script = read_source(path);
+    if (!script) {
+        return NULL;
+    }
+
+    uint64_t hash = sclsh_fnv_hash64(script->string, script->length);
+    char* entry_path = cache_entry_path(hash);
+    if (entry_path) {
+        script->as_proc = load_entry(entry_path, hash, script);
+    }
+
+    if (!script->as_proc) {
+        SclshValueList* commands = sclsh_value_as_proc(script);
+        if (commands) {
+            for (size_t i = 0; i < commands->count; i++) {
+                sclsh_value_as_command_line(commands->items[i]);
+            }
+            if (entry_path) {
+                store_entry(entry_path, hash, script);
+            }
+        }
+    }
+
+    free(entry_path);
+    return script;
+}
@@ -0,0 +1,744 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/channel.h>
+#include <sclsh/event.h>
+#include <sclsh/unwind.h>
+#include <sclsh/util.h>
+#include <sclsh/vm.h>
+#include "value.h"
+#include "interp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CHANNEL_BUFFER_SIZE (64 * 1024)
+#define RELEASE_STEP (64 * 1024 * 1024)  // Consumed mapping pages are dropped in steps this large
+
+struct SclshChannel_s {
+    int fd;  // -1 for mapped channels
+    bool owns_fd;
+    bool readable;
+    bool eof;
+    bool blocked;  // The last read stopped because a non-blocking descriptor ran dry
+
+    SclshValue* mapping;  // The whole file, for mapped channels
+    size_t position;  // Read position within the mapping
+    size_t released;  // Pages of the mapping before this were handed back
+
+    char* buffer;  // Read buffer of other channels
+    size_t start;
+    size_t end;
+    size_t capacity;
+
+    SclshOutput* output;  // NULL for read-only channels
+};
+
+struct SclshChannelTable_s {
+    SclshHashMap* channels;  // Name -> SclshChannel
+    unsigned long next_id;
+};
+
+static SclshChannel* channel_new(int fd, bool owns_fd, bool readable, bool writable) {
+    SclshChannel* chan = malloc(sizeof(SclshChannel));
+    if (!chan) return NULL;
+
+    chan->fd = fd;
+    chan->owns_fd = owns_fd;
+    chan->readable = readable;
+    chan->eof = false;
+    chan->blocked = false;
+    chan->mapping = NULL;
+    chan->position = 0;
+    chan->released = 0;
+    chan->buffer = NULL;
+    chan->start = 0;
+    chan->end = 0;
+    chan->capacity = 0;
+    chan->output = writable ? sclsh_output_new_fd(fd) : NULL;
+    return chan;
+}
+
+// Read-only regular files are mapped rather than read; returns NULL for
+// anything that cannot be mapped so the caller falls back to buffering
+static SclshChannel* map_file(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return NULL;
+    }
+    char* bytes = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (bytes == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(bytes, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    SclshChannel* chan = channel_new(-1, false, true, false);
+    if (!chan) {
+        munmap(bytes, (size_t)st.st_size);
+        return NULL;
+    }
+    chan->mapping = sclsh_value_new_mapped(bytes, (size_t)st.st_size);
+    close(fd);  // The mapping stays valid on its own
+    return chan;
+}
+
+SclshChannel* sclsh_channel_open(const char* path, const char* mode) {
+    if (!path || !mode) {
+        return NULL;
+    }
+    int flags;
+    if (strcmp(mode, "r") == 0) {
+        flags = O_RDONLY;
+    } else if (strcmp(mode, "r+") == 0) {
+        flags = O_RDWR;
+    } else if (strcmp(mode, "w") == 0) {
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+    } else if (strcmp(mode, "w+") == 0) {
+        flags = O_RDWR | O_CREAT | O_TRUNC;
+    } else if (strcmp(mode, "a") == 0) {
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+    } else if (strcmp(mode, "a+") == 0) {
+        flags = O_RDWR | O_CREAT | O_APPEND;
+    } else {
+        fprintf(stderr, "Invalid channel mode '%s'\n", mode);
+        return NULL;
+    }
+
+    int fd = open(path, flags | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (flags == O_RDONLY) {
+        SclshChannel* chan = map_file(fd);
+        if (chan) {
+            return chan;
+        }
+    }
+    int access = flags & O_ACCMODE;
+    SclshChannel* chan = channel_new(fd, true, access != O_WRONLY, access != O_RDONLY);
+    if (!chan) {
+        close(fd);
+    }
+    return chan;
+}
+
+SclshChannel* sclsh_channel_new_fd(int fd, int readable, int writable) {
+    return channel_new(fd, false, readable, writable);
+}
+
+void sclsh_channel_close(SclshChannel* chan) {
+    if (!chan) {
+        return;
+    }
+    sclsh_output_free(chan->output);
+    if (chan->owns_fd) {
+        close(chan->fd);
+    }
+    sclsh_value_unref(chan->mapping);  // Slices still in use keep it mapped
+    free(chan->buffer);
+    free(chan);
+}
+
+// Hands pages that have been read back to the kernel. Private read-only
+// mappings are refilled from the file on the next access, so slices that
+// still point there remain valid.
+static void release_consumed(SclshChannel* chan) {
+    if (chan->position < chan->released + RELEASE_STEP) {
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t upto = chan->position & ~(page - 1);
+    madvise(chan->mapping->string + chan->released, upto - chan->released, MADV_DONTNEED);
+    chan->released = upto;
+}
+
+static int mapped_gets(SclshChannel* chan, SclshValue** line) {
+    size_t length = chan->mapping->length;
+    if (chan->position >= length) {
+        chan->eof = true;
+        return 0;
+    }
+    const char* start = chan->mapping->string + chan->position;
+    size_t left = length - chan->position;
+    const char* newline = memchr(start, '\n', left);
+
+    size_t line_length;
+    size_t consumed;
+    if (newline) {
+        line_length = (size_t)(newline - start);
+        consumed = line_length + 1;
+        if (line_length > 0 && start[line_length - 1] == '\r') {
+            line_length--;
+        }
+    } else {
+        line_length = left;
+        consumed = left;
+        chan->eof = true;
+    }
+    *line = sclsh_value_new_slice(chan->mapping, chan->position, line_length);
+    chan->position += consumed;
+    release_consumed(chan);
+    return *line ? 1 : -1;
+}
+
+// Appends to the read buffer; returns the number of bytes read, 0 at end
+// of file or -1 on error
+static ssize_t fill_buffer(SclshChannel* chan) {
+    if (!chan->buffer) {
+        chan->buffer = malloc(CHANNEL_BUFFER_SIZE);
+        if (!chan->buffer) {
+            return -1;
+        }
+        chan->capacity = CHANNEL_BUFFER_SIZE;
+    }
+    if (chan->start > 0) {
+        memmove(chan->buffer, chan->buffer + chan->start, chan->end - chan->start);
+        chan->end -= chan->start;
+        chan->start = 0;
+    }
+    if (chan->end == chan->capacity) {
+        char* buffer = realloc(chan->buffer, chan->capacity * 2);  // Line longer than the buffer
+        if (!buffer) {
+            return -1;
+        }
+        chan->buffer = buffer;
+        chan->capacity *= 2;
+    }
+    ssize_t res;
+    do {
+        res = read(chan->fd, chan->buffer + chan->end, chan->capacity - chan->end);
+    } while (res < 0 && errno == EINTR);
+    if (res > 0) {
+        chan->end += (size_t)res;
+    }
+    return res;
+}
+
+static int buffered_gets(SclshChannel* chan, SclshValue** line) {
+    size_t scanned = 0;  // Bytes already searched for a newline
+    for (;;) {
+        char* start = chan->buffer + chan->start;
+        size_t available = chan->end - chan->start;
+        char* newline = available > scanned
+            ? memchr(start + scanned, '\n', available - scanned)
+            : NULL;
+        if (newline) {
+            size_t line_length = (size_t)(newline - start);
+            chan->start += line_length + 1;
+            if (line_length > 0 && start[line_length - 1] == '\r') {
+                line_length--;
+            }
+            *line = sclsh_value_new(start, line_length);
+            return *line ? 1 : -1;
+        }
+        scanned = available;
+
+        ssize_t res = fill_buffer(chan);
+        if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            chan->blocked = true;  // No complete line yet, what is there stays buffered
+            return 0;
+        }
+        if (res < 0) {
+            return -1;
+        }
+        if (res == 0) {
+            chan->eof = true;
+            if (available == 0) {
+                return 0;
+            }
+            *line = sclsh_value_new(chan->buffer + chan->start, available);
+            chan->start = chan->end;
+            return *line ? 1 : -1;
+        }
+    }
+}
+
+static bool prepare_read(SclshChannel* chan) {
+    if (!chan->readable) {
+        fprintf(stderr, "Channel is not readable\n");
+        return false;
+    }
+    if (chan->output && !sclsh_output_flush(chan->output)) {
+        return false;  // Reads must see what was written before them
+    }
+    return true;
+}
+
+int sclsh_channel_gets(SclshChannel* chan, SclshValue** line) {
+    if (!chan || !line || !prepare_read(chan)) {
+        return -1;
+    }
+    *line = NULL;
+    chan->blocked = false;
+    if (chan->mapping) {
+        return mapped_gets(chan, line);
+    }
+    return buffered_gets(chan, line);
+}
+
+SclshValue* sclsh_channel_read(SclshChannel* chan, size_t max) {
+    if (!chan || !prepare_read(chan)) {
+        return NULL;
+    }
+    chan->blocked = false;
+
+    if (chan->mapping) {
+        size_t left = chan->mapping->length - chan->position;
+        size_t count = max < left ? max : left;
+        if (count < max) {
+            chan->eof = true;
+        }
+        SclshValue* value = sclsh_value_new_slice(chan->mapping, chan->position, count);
+        chan->position += count;
+        release_consumed(chan);
+        return value;
+    }
+
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    if (!sb) {
+        return NULL;
+    }
+    size_t remaining = max;
+    while (remaining > 0) {
+        if (chan->start == chan->end) {
+            ssize_t res = fill_buffer(chan);
+            if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                chan->blocked = true;
+                break;
+            }
+            if (res < 0) {
+                fprintf(stderr, "Read failed: %s\n", strerror(errno));
+                sclsh_string_builder_free(sb);
+                return NULL;
+            }
+            if (res == 0) {
+                chan->eof = true;
+                break;
+            }
+        }
+        size_t available = chan->end - chan->start;
+        size_t count = remaining < available ? remaining : available;
+        sclsh_string_builder_append_bytes(sb, chan->buffer + chan->start, count);
+        chan->start += count;
+        remaining -= count;
+    }
+    SclshValue* value = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    return value;
+}
+
+int sclsh_channel_seek(SclshChannel* chan, off_t offset, int whence) {
+    if (!chan) {
+        return 0;
+    }
+
+    if (chan->mapping) {
+        off_t base = whence == SEEK_SET ? 0
+            : whence == SEEK_CUR ? (off_t)chan->position
+            : (off_t)chan->mapping->length;
+        off_t target = base + offset;
+        if (target < 0 || target > (off_t)chan->mapping->length) {
+            fprintf(stderr, "Seek position out of range\n");
+            return 0;
+        }
+        chan->position = (size_t)target;
+        if (chan->position < chan->released) {
+            chan->released = chan->position & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+        }
+        chan->eof = false;
+        return 1;
+    }
+
+    if (chan->output && !sclsh_output_flush(chan->output)) {
+        return 0;
+    }
+    if (whence == SEEK_CUR) {
+        offset -= (off_t)(chan->end - chan->start);  // Read ahead into the buffer
+    }
+    if (lseek(chan->fd, offset, whence) < 0) {
+        fprintf(stderr, "Seek failed: %s\n", strerror(errno));
+        return 0;
+    }
+    chan->start = chan->end = 0;
+    chan->eof = false;
+    return 1;
+}
+
+int sclsh_channel_eof(SclshChannel* chan) {
+    return chan && chan->eof ? 1 : 0;
+}
+
+int sclsh_channel_blocked(SclshChannel* chan) {
+    return chan && chan->blocked ? 1 : 0;
+}
+
+int sclsh_channel_fd(SclshChannel* chan) {
+    return chan ? chan->fd : -1;
+}
+
+int sclsh_channel_pending(SclshChannel* chan) {
+    if (!chan) {
+        return 0;
+    }
+    if (chan->mapping) {
+        return chan->position < chan->mapping->length;
+    }
+    return chan->end > chan->start;
+}
+
+int sclsh_channel_set_blocking(SclshChannel* chan, int blocking) {
+    if (!chan) {
+        return 0;
+    }
+    if (chan->fd < 0) {
+        return 1;  // Mapped files never block
+    }
+    int flags = fcntl(chan->fd, F_GETFL);
+    if (flags < 0) {
+        return 0;
+    }
+    flags = blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK;
+    if (fcntl(chan->fd, F_SETFL, flags) < 0) {
+        fprintf(stderr, "Cannot change blocking mode: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+SclshOutput* sclsh_channel_output(SclshChannel* chan) {
+    if (!chan || !chan->output) {
+        return NULL;
+    }
+    // Writes continue from where reading stopped, not from the read-ahead
+    if (chan->end > chan->start) {
+        lseek(chan->fd, -(off_t)(chan->end - chan->start), SEEK_CUR);
+        chan->start = chan->end = 0;
+    }
+    return chan->output;
+}
+
+static SclshChannelTable* channel_table(SclshInterpreter* interp) {
+    if (interp->channels) {
+        return interp->channels;
+    }
+    SclshChannelTable* table = malloc(sizeof(SclshChannelTable));
+    if (!table) {
+        return NULL;
+    }
+    table->channels = sclsh_hash_map_new();
+    table->next_id = 0;
+
+    sclsh_hash_map_set(table->channels, "stdin", sclsh_channel_new_fd(STDIN_FILENO, 1, 0));
+    SclshChannel* err = sclsh_channel_new_fd(STDERR_FILENO, 0, 1);
+    sclsh_output_set_buffering(sclsh_channel_output(err), SCLSH_OUTPUT_NONE);
+    sclsh_hash_map_set(table->channels, "stderr", err);
+
+    interp->channels = table;
+    return table;
+}
+
+static void close_entry(const char* key, void* value, void* user_data) {
+    (void)key; (void)user_data;
+    sclsh_channel_close(value);
+}
+
+void sclsh_channel_table_free(SclshChannelTable* table) {
+    if (!table) {
+        return;
+    }
+    sclsh_hash_map_for_each(table->channels, close_entry, NULL);
+    sclsh_hash_map_free(table->channels);
+    free(table);
+}
+
+const char* sclsh_interpreter_add_channel(SclshInterpreter* interp, SclshChannel* chan) {
+    if (!interp || !chan) {
+        return NULL;
+    }
+    SclshChannelTable* table = channel_table(interp);
+    if (!table) {
+        return NULL;
+    }
+    static _Thread_local char name[32];
+    snprintf(name, sizeof(name), "file%lu", table->next_id++);
+    sclsh_hash_map_set(table->channels, name, chan);
+    return name;
+}
+
+SclshChannel* sclsh_interpreter_channel(SclshInterpreter* interp, const char* name) {
+    if (!interp || !name) {
+        return NULL;
+    }
+    SclshChannelTable* table = channel_table(interp);
+    return table ? sclsh_hash_map_get(table->channels, name) : NULL;
+}
+
+int sclsh_interpreter_close_channel(SclshInterpreter* interp, const char* name) {
+    SclshChannel* chan = sclsh_interpreter_channel(interp, name);
+    if (!chan) {
+        return 0;
+    }
+    sclsh_hash_map_remove(interp->channels->channels, name);
+    if (interp->events && chan->fd >= 0) {
+        sclsh_event_unwatch(interp->events, chan->fd);
+    }
+    sclsh_channel_close(chan);
+    return 1;
+}
+
+SclshOutput* sclsh_interpreter_channel_output(SclshInterpreter* interp, const char* name) {
+    if (!interp || !name) {
+        return NULL;
+    }
+    if (strcmp(name, "stdout") == 0) {
+        return sclsh_interpreter_output(interp);
+    }
+    SclshChannel* chan = sclsh_interpreter_channel(interp, name);
+    if (!chan) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+        return NULL;
+    }
+    SclshOutput* out = sclsh_channel_output(chan);
+    if (!out) {
+        fprintf(stderr, "Channel '%s' is not writable\n", name);
+    }
+    return out;
+}
+
+static SclshChannel* channel_arg(SclshContext* ctx, SclshValue* name_value) {
+    char* name = sclsh_value_as_string(name_value).string;
+    SclshChannel* chan = sclsh_interpreter_channel(sclsh_context_interpreter(ctx), name);
+    if (!chan) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+    }
+    return chan;
+}
+
+static SclshValue* cmd_open(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: open <file> ?mode?\n");
+        return NULL;
+    }
+    const char* mode = argc == 2 ? sclsh_value_as_string(argv[1]).string : "r";
+    SclshChannel* chan = sclsh_channel_open(sclsh_value_as_string(argv[0]).string, mode);
+    if (!chan) {
+        return NULL;
+    }
+    return sclsh_value_from_cstr(sclsh_interpreter_add_channel(sclsh_context_interpreter(ctx), chan));
+}
+
+static SclshValue* cmd_close(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1) {
+        fprintf(stderr, "Usage: close <channel>\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    if (!sclsh_interpreter_close_channel(sclsh_context_interpreter(ctx), name)) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+        return NULL;
+    }
+    return sclsh_value_empty();
+}
+
+static SclshValue* cmd_gets(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: gets <channel> ?variable?\n");
+        return NULL;
+    }
+    SclshChannel* chan = channel_arg(ctx, argv[0]);
+    if (!chan) {
+        return NULL;
+    }
+    SclshValue* line = NULL;
+    int res = sclsh_channel_gets(chan, &line);
+    if (res < 0) {
+        fprintf(stderr, "gets: read failed\n");
+        return NULL;
+    }
+    if (!line) {
+        line = sclsh_value_empty();
+    }
+    if (argc == 1) {
+        return line;
+    }
+
+    // With a variable the line goes there and the result is its length,
+    // or -1 at end of file
+    char count[32];
+    snprintf(count, sizeof(count), "%ld", res ? (long)sclsh_value_as_bytes(line).length : -1L);
+    sclsh_context_set_variable(ctx, sclsh_value_as_string(argv[1]).string, line);
+    sclsh_value_unref(line);
+    return sclsh_value_from_cstr(count);
+}
+
+static SclshValue* cmd_read(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: read <channel> ?numBytes?\n");
+        return NULL;
+    }
+    SclshChannel* chan = channel_arg(ctx, argv[0]);
+    if (!chan) {
+        return NULL;
+    }
+    size_t max = SIZE_MAX;
+    if (argc == 2) {
+        max = (size_t)strtoull(sclsh_value_as_string(argv[1]).string, NULL, 10);
+    }
+    return sclsh_channel_read(chan, max);
+}
+
+static SclshValue* cmd_seek(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: seek <channel> <offset> ?start|current|end?\n");
+        return NULL;
+    }
+    SclshChannel* chan = channel_arg(ctx, argv[0]);
+    if (!chan) {
+        return NULL;
+    }
+    int whence = SEEK_SET;
+    if (argc == 3) {
+        char* origin = sclsh_value_as_string(argv[2]).string;
+        if (strcmp(origin, "current") == 0) {
+            whence = SEEK_CUR;
+        } else if (strcmp(origin, "end") == 0) {
+            whence = SEEK_END;
+        } else if (strcmp(origin, "start") != 0) {
+            fprintf(stderr, "Invalid seek origin '%s'\n", origin);
+            return NULL;
+        }
+    }
+    off_t offset = (off_t)strtoll(sclsh_value_as_string(argv[1]).string, NULL, 10);
+    if (!sclsh_channel_seek(chan, offset, whence)) {
+        return NULL;
+    }
+    return sclsh_value_empty();
+}
+
+static SclshValue* cmd_eof(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1) {
+        fprintf(stderr, "Usage: eof <channel>\n");
+        return NULL;
+    }
+    SclshChannel* chan = channel_arg(ctx, argv[0]);
+    if (!chan) {
+        return NULL;
+    }
+    return sclsh_value_new(sclsh_channel_eof(chan) ? "1" : "0", 1);
+}
+
+typedef struct ForeachLine_s {
+    SclshChannel* chan;  // Opened by foreach-line itself, NULL for a named channel
+    char* chan_name;
+    char* var_name;
+    SclshValue* body;
+} ForeachLine;
+
+static SclshValue* foreach_line_finish(ForeachLine* loop, SclshValue* result) {
+    if (loop->chan) {
+        sclsh_channel_close(loop->chan);
+    }
+    free(loop->chan_name);
+    free(loop->var_name);
+    sclsh_value_unref(loop->body);
+    free(loop);
+    return result;
+}
+
+// Runs after every evaluation of the body and starts the next one, so the
+// loop never nests on the C stack and the body may yield
+static SclshValue* foreach_line_next(SclshContext* ctx, SclshValue* body_result, void* data) {
+    ForeachLine* loop = data;
+    if (!body_result) {
+        SclshUnwindKind kind = sclsh_get_unwind();
+        if (kind == SCLSH_UNWIND_BREAK) {
+            sclsh_clear_unwind();
+            return foreach_line_finish(loop, sclsh_value_empty());
+        }
+        if (kind != SCLSH_UNWIND_CONTINUE) {
+            return foreach_line_finish(loop, NULL);
+        }
+        sclsh_clear_unwind();
+    }
+    sclsh_value_unref(body_result);
+
+    // A named channel is looked up every time, the body may have closed it
+    SclshChannel* chan = loop->chan;
+    if (!chan) {
+        chan = sclsh_interpreter_channel(sclsh_context_interpreter(ctx), loop->chan_name);
+        if (!chan) {
+            fprintf(stderr, "foreach-line: channel '%s' was closed\n", loop->chan_name);
+            return foreach_line_finish(loop, NULL);
+        }
+    }
+
+    SclshValue* line = NULL;
+    int res = sclsh_channel_gets(chan, &line);
+    if (res == 0) {
+        return foreach_line_finish(loop, sclsh_value_empty());
+    }
+    if (res < 0) {
+        fprintf(stderr, "foreach-line: read failed\n");
+        return foreach_line_finish(loop, NULL);
+    }
+    sclsh_context_set_variable(ctx, loop->var_name, line);
+    sclsh_value_unref(line);
+    return sclsh_eval_then(ctx, loop->body, foreach_line_next, loop);
+}
+
+// foreach-line line access.log { ... } streams the file (or an already
+// open channel) through the body one line at a time
+static SclshValue* cmd_foreach_line(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 3) {
+        fprintf(stderr, "Usage: foreach-line <variable> <file|channel> <body>\n");
+        return NULL;
+    }
+    char* source = sclsh_value_as_string(argv[1]).string;
+    SclshChannel* chan = NULL;
+    if (!sclsh_interpreter_channel(sclsh_context_interpreter(ctx), source)) {
+        chan = sclsh_channel_open(source, "r");
+        if (!chan) {
+            return NULL;
+        }
+    }
+
+    ForeachLine* loop = malloc(sizeof(ForeachLine));
+    if (!loop) {
+        sclsh_channel_close(chan);
+        return NULL;
+    }
+    loop->chan = chan;
+    loop->chan_name = strdup(source);
+    loop->var_name = strdup(sclsh_value_as_string(argv[0]).string);
+    loop->body = sclsh_value_ref(argv[2]);
+    return foreach_line_next(ctx, sclsh_value_empty(), loop);
+}
+
+void sclsh_register_channel_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "open", cmd_open, NULL, NULL);
+    sclsh_command_new(interp, "close", cmd_close, NULL, NULL);
+    sclsh_command_new(interp, "gets", cmd_gets, NULL, NULL);
+    sclsh_command_new(interp, "read", cmd_read, NULL, NULL);
+    sclsh_command_new(interp, "seek", cmd_seek, NULL, NULL);
+    sclsh_command_new(interp, "eof", cmd_eof, NULL, NULL);
+    sclsh_command_new(interp, "foreach-line", cmd_foreach_line, NULL, NULL);
+}
@@ -0,0 +1,130 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__INTERNAL_CODE
+#define H__SCLSH__INTERNAL_CODE
+
+#include <sclsh/sclsh.h>
+#include <sclsh/util.h>
+#include <stdint.h>
+
+/* Compiled form of a script, cached on the script value.
+ *
+ * Every word of a command is pushed on the value stack and INVOKE calls
+ * the command named by the first of them with the rest as arguments.
+ * Bracketed substitutions are compiled inline, so a script leaves exactly
+ * one value on the stack no matter how deeply its commands nest. A quoted
+ * word pushes the segments of its template (see sclsh_parse_interpolation)
+ * and CONCAT joins them.
+ *
+ * Inside a procedure body, variables named literally are resolved to
+ * slots of the call's context when the body is compiled, and `set` with a
+ * literal name stores straight into the slot.
+ *
+ * if, while, for, foreach, incr, break, continue and return with literal
+ * bodies are compiled to jumps. break and continue raised by a command at
+ * run time (inside eval, say) are caught through the loop ranges: the
+ * stack is cut back to the loop's depth and execution resumes at the
+ * loop's target.
+ */
+typedef enum {
+    SCLSH_OP_PUSH,  // Push constant arg
+    SCLSH_OP_LOAD,  // Push the variable named by constant arg
+    SCLSH_OP_LOAD_LOCAL,  // Push local variable slot arg
+    SCLSH_OP_STORE,  // Set the variable named by constant arg to the top value
+    SCLSH_OP_STORE_LOCAL,  // Set local variable slot arg to the top value
+    SCLSH_OP_INVOKE,  // Call a command with the top arg values as its words
+    SCLSH_OP_EXEC,  // Run the command line in constant arg as a pipeline
+    SCLSH_OP_POP,  // Drop the result of the previous command
+    SCLSH_OP_JUMP,  // Continue at instruction arg
+    SCLSH_OP_BRANCH_FALSE,  // Pop an expression and jump to arg if it is false
+    SCLSH_OP_RETURN,  // End the frame with the top value as its result
+    SCLSH_OP_INCR,  // Add the top value to the variable named by constant arg
+    SCLSH_OP_INCR_LOCAL,  // Add the top value to local variable slot arg
+    SCLSH_OP_FOREACH_START,  // Start counting through the list on top
+    SCLSH_OP_FOREACH_TEST,  // Jump to arg if the list is exhausted
+    SCLSH_OP_FOREACH_ITEM,  // Push the next item, or constant arg past the end
+    SCLSH_OP_FOREACH_END,  // Drop the list and its counter
+    SCLSH_OP_CONCAT,  // Replace the top arg values by their concatenation
+} SclshOpcode;
+
+typedef struct SclshInstruction_s {
+    uint32_t op;
+    uint32_t arg;
+} SclshInstruction;
+
+typedef struct SclshLoopRange_s {
+    uint32_t start;  // Instructions of the body
+    uint32_t end;
+    uint32_t break_target;
+    uint32_t continue_target;
+    uint32_t depth;  // Values the frame holds below the body
+    uint32_t counter_depth;  // foreach counters the frame holds below the body
+} SclshLoopRange;
+
+typedef struct SclshCode_s {
+    long ref_count;  // Running frames keep the code alive
+    size_t count;
+    SclshInstruction* instructions;
+    size_t constant_count;
+    SclshValue** constants;
+    size_t range_count;  // Inner loops come first
+    SclshLoopRange* ranges;
+} SclshCode;
+
+typedef struct SclshProc_s {
+    long ref_count;  // Running calls keep the procedure alive
+    char* name;
+    SclshValue* params;  // Parameter list as written
+    SclshValue* body;
+    char* usage;  // For wrong numbers of arguments, e.g. "f a ?b? ?arg ...?"
+    size_t param_count;  // Including args
+    size_t required_count;
+    SclshValue** defaults;  // NULL for required parameters
+    bool variadic;  // The last parameter is args and collects the rest
+    size_t local_count;  // Parameters take the first slots
+    size_t local_capacity;
+    char** local_names;
+    SclshHashMap* slots;  // Local name -> slot + 1
+    SclshCode* code;  // NULL until a restored procedure is first called
+} SclshProc;
+
+SclshCode* sclsh_value_as_code(SclshValue* value);
+// Compiles the body of a procedure, adding a slot for every variable it
+// names literally
+SclshCode* sclsh_code_compile_proc(SclshProc* proc);
+// Defines a procedure saved in an image. Its parameters and body were
+// checked when it was first defined, so they are only parsed and compiled
+// when it is first called; a load that calls few of its procedures pays
+// for few of them.
+int sclsh_proc_restore(
+    SclshInterpreter* interp,
+    const char* name,
+    SclshValue* params,
+    SclshValue* body
+);
+// Slot of a local variable, adding one if create is set. Returns -1 if
+// the name has no slot.
+long sclsh_proc_slot(SclshProc* proc, const char* name, bool create);
+// Whether compiled code carries out the command itself instead of
+// invoking whatever the name refers to
+bool sclsh_code_inlines(const char* name);
+// Code that invokes argv as a single command, without parsing anything
+SclshCode* sclsh_code_new_invocation(size_t argc, SclshValue** argv);
+
+SclshCode* sclsh_code_ref(SclshCode* code);
+void sclsh_code_unref(SclshCode* code);
+
+SclshProc* sclsh_proc_ref(SclshProc* proc);
+void sclsh_proc_unref(SclshProc* proc);
+
+// Sum of a variable (NULL if unset, counting as 0) and amount for incr,
+// updating a value only the variable refers to in place, see control.c
+SclshValue* sclsh_incr_value(SclshValue* variable, SclshValue* amount);
+
+// Calls a procedure with its arguments (the words after the name), see vm.c
+SclshValue* sclsh_call_proc(SclshContext* ctx, SclshProc* proc, size_t argc, SclshValue** argv);
+
+#endif
@@ -1,31 +1,99 @@
 #include <sclsh/commands.h>
 #include <sclsh/sclsh.h>
 #include <sclsh/expr.h>
+#include <sclsh/thread_channel.h>
+#include <sclsh/image.h>
+#include <sclsh/output.h>
+#include <sclsh/channel.h>
+#include <sclsh/event.h>
+#include <sclsh/vm.h>
+#include <sclsh/proc.h>
+#include <sclsh/profile.h>
+#include <sclsh/stats.h>
+#include <sclsh/string.h>
+#include <sclsh/regexp.h>
+#include <sclsh/binary.h>
+#include <sclsh/cache.h>
 #include "value.h"
+#include "interp.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 static SclshValue* cmd_exit(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
     // Exit command implementation
-    (void)ctx; (void)argc; (void)argv; (void)user_data; // Suppress unused parameter warnings
+    (void)argc; (void)argv; (void)user_data; // Suppress unused parameter warnings
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    // Open channels may still buffer writes; closing them flushes those
+    sclsh_channel_table_free(interp->channels);
+    interp->channels = NULL;
+    sclsh_output_flush(sclsh_interpreter_output(interp));
     exit(0);
     return NULL; // No return value needed for exit command
 }
 
+#define PUTS_MAX_IOV 64
+
 static SclshValue* cmd_puts(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
     // Puts command implementation
-    (void)ctx; (void)user_data; // Suppress unused parameter warnings
+    (void)user_data; // Suppress unused parameter warning
     if (argc < 1) {
-        fprintf(stderr, "Usage: puts <string>\n");
+        fprintf(stderr, "Usage: puts ?-chan <channel>? <string>\n");
         return NULL;
     }
-    for (size_t i = 0; i < argc; i++) {
-        SclshStringBuffer str_buf = sclsh_value_as_string(argv[i]);
-        printf("%.*s", (int)str_buf.length, str_buf.string);
+    SclshOutput* out = sclsh_interpreter_output(sclsh_context_interpreter(ctx));
+    size_t first = 0;
+    SclshStringBuffer option = sclsh_value_as_bytes(argv[0]);
+    if (argc >= 2 && option.length == 5 && memcmp(option.string, "-chan", 5) == 0) {
+        out = sclsh_interpreter_channel_output(
+            sclsh_context_interpreter(ctx), sclsh_value_as_string(argv[1]).string
+        );
+        if (!out) {
+            return NULL;
+        }
+        first = 2;
+    }
+
+    // All arguments and the newline go out as one batch
+    struct iovec iov[PUTS_MAX_IOV];
+    int count = 0;
+    for (size_t i = first; i < argc; i++) {
+        SclshStringBuffer str_buf = sclsh_value_as_bytes(argv[i]);
+        if (count == PUTS_MAX_IOV - 1) {
+            sclsh_output_writev(out, iov, count);
+            count = 0;
+        }
+        iov[count].iov_base = str_buf.string;
+        iov[count].iov_len = str_buf.length;
+        count++;
+    }
+    iov[count].iov_base = "\n";
+    iov[count].iov_len = 1;
+    if (!sclsh_output_writev(out, iov, count + 1)) {
+        fprintf(stderr, "puts: write failed\n");
+        return NULL;
     }
-    printf("\n");
-    return sclsh_value_new("", 0);
+    return sclsh_value_empty();
+}
+
+static SclshValue* cmd_flush(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc > 1) {
+        fprintf(stderr, "Usage: flush ?channel?\n");
+        return NULL;
+    }
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    SclshOutput* out = argc == 1
+        ? sclsh_interpreter_channel_output(interp, sclsh_value_as_string(argv[0]).string)
+        : sclsh_interpreter_output(interp);
+    if (!out) {
+        return NULL;
+    }
+    if (!sclsh_output_flush(out)) {
+        fprintf(stderr, "flush: write failed\n");
+        return NULL;
+    }
+    return sclsh_value_empty();
 }
 static SclshValue* cmd_expr(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
     // Placeholder for expression evaluation command
@@ -34,13 +102,14 @@ static SclshValue* cmd_expr(SclshContext* ctx, size_t argc, SclshValue** argv, v
         fprintf(stderr, "Usage: expr <expression>\n");
         return NULL;
     }
-    SclshValue* expr = sclsh_value_new_from_list(argv, argc);
-    SclshValue* res = sclsh_expr_eval(ctx, expr);
+    if (argc == 1) {
+        return sclsh_expr_eval(ctx, argv[0]);  // A braced expression is already a list
+    }
+    SclshValue* res = sclsh_expr_eval_words(ctx, argc, argv);
     if (!res) {
         fprintf(stderr, "Expression evaluation failed\n");
         return NULL;
     }
-    sclsh_value_unref(expr);
     return res;
 }
 
@@ -53,7 +122,88 @@ static SclshValue* cmd_set(SclshContext* ctx, size_t argc, SclshValue** argv, vo
     }
     SclshStringBuffer var_name_buf = sclsh_value_as_string(argv[0]);
     sclsh_context_set_variable(ctx, var_name_buf.string, argv[1]);
-    return argv[1]; // No return value needed for set command
+    return sclsh_value_ref(argv[1]);
+}
+
+static SclshValue* cmd_source(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1) {
+        fprintf(stderr, "Usage: source <file>\n");
+        return NULL;
+    }
+    SclshValue* script = sclsh_cache_load_script(sclsh_value_as_string(argv[0]).string);
+    if (!script) {
+        return NULL;
+    }
+    SclshValue* result = sclsh_eval_then(ctx, script, NULL, NULL);
+    sclsh_value_unref(script);  // A pushed frame holds on to the compiled code
+    return result;
+}
+
+static SclshValue* cmd_interp(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    if (argc < 1) {
+        fprintf(stderr, "Usage: interp image save|load <file> | interp recursionlimit ?limit? | interp stats ?reset?\n");
+        return NULL;
+    }
+    char* sub = sclsh_value_as_string(argv[0]).string;
+
+    if (strcmp(sub, "image") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: interp image save|load <file>\n");
+            return NULL;
+        }
+        char* op = sclsh_value_as_string(argv[1]).string;
+        char* path = sclsh_value_as_string(argv[2]).string;
+        int ok;
+        if (strcmp(op, "save") == 0) {
+            ok = sclsh_image_save(interp, path);
+        } else if (strcmp(op, "load") == 0) {
+            ok = sclsh_image_load(interp, path);
+        } else {
+            fprintf(stderr, "Unknown interp image operation '%s'\n", op);
+            return NULL;
+        }
+        return ok ? sclsh_value_empty() : NULL;
+    }
+
+    if (strcmp(sub, "stats") == 0) {
+        if (argc == 2 && strcmp(sclsh_value_as_string(argv[1]).string, "reset") == 0) {
+            sclsh_stats_reset();
+            return sclsh_value_empty();
+        }
+        if (argc != 1) {
+            fprintf(stderr, "Usage: interp stats ?reset?\n");
+            return NULL;
+        }
+        SclshStats stats;
+        sclsh_stats_snapshot(&stats);
+        return sclsh_stats_to_value(&stats);
+    }
+
+    if (strcmp(sub, "recursionlimit") == 0) {
+        if (argc > 2) {
+            fprintf(stderr, "Usage: interp recursionlimit ?limit?\n");
+            return NULL;
+        }
+        if (argc == 2) {
+            char* end;
+            char* text = sclsh_value_as_string(argv[1]).string;
+            unsigned long long limit = strtoull(text, &end, 10);
+            if (*text == '\0' || *end != '\0' || limit == 0) {
+                fprintf(stderr, "Invalid recursion limit '%s'\n", text);
+                return NULL;
+            }
+            sclsh_set_recursion_limit(interp, (size_t)limit);
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%zu", sclsh_recursion_limit(interp));
+        return sclsh_value_from_cstr(buffer);
+    }
+
+    fprintf(stderr, "Unknown interp subcommand '%s'\n", sub);
+    return NULL;
 }
 
 void sclsh_register_core_commands(SclshInterpreter* interp) {
@@ -63,6 +213,20 @@ void sclsh_register_core_commands(SclshInterpreter* interp) {
 
     sclsh_command_new(interp, "exit", cmd_exit, NULL, NULL);
     sclsh_command_new(interp, "puts", cmd_puts, NULL, NULL);
+    sclsh_command_new(interp, "flush", cmd_flush, NULL, NULL);
     sclsh_command_new(interp, "expr", cmd_expr, NULL, NULL);
     sclsh_command_new(interp, "set", cmd_set, NULL, NULL);
+    sclsh_command_new(interp, "source", cmd_source, NULL, NULL);
+    sclsh_command_new(interp, "interp", cmd_interp, NULL, NULL);
+
+    sclsh_register_thread_channel_commands(interp);
+    sclsh_register_channel_commands(interp);
+    sclsh_register_event_commands(interp);
+    sclsh_register_vm_commands(interp);
+    sclsh_register_control_commands(interp);
+    sclsh_register_proc_commands(interp);
+    sclsh_register_profile_commands(interp);
+    sclsh_register_string_commands(interp);
+    sclsh_register_regexp_commands(interp);
+    sclsh_register_binary_commands(interp);
 }
@@ -0,0 +1,642 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/ast.h>
+#include <sclsh/exec.h>
+#include "code.h"
+#include "value.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Jumps whose target is patched in once it is known
+typedef struct Jumps_s {
+    size_t* at;
+    size_t count;
+    size_t capacity;
+} Jumps;
+
+typedef struct Loop_s {
+    size_t depth;
+    size_t counter_depth;
+    Jumps breaks;
+    Jumps continues;
+    struct Loop_s* outer;
+} Loop;
+
+typedef struct CodeBuilder_s {
+    SclshCode* code;
+    size_t instruction_capacity;
+    size_t constant_capacity;
+    size_t range_capacity;
+    SclshProc* proc;  // Resolves variables to slots, NULL outside procedures
+    size_t depth;  // Values on the stack of the frame at this point
+    size_t counter_depth;  // Active foreach loops
+    Loop* loop;  // Innermost loop being compiled
+    bool failed;
+} CodeBuilder;
+
+static SclshCode* code_new(void) {
+    SclshCode* code = malloc(sizeof(SclshCode));
+    if (!code) return NULL;
+
+    code->ref_count = 1;
+    code->count = 0;
+    code->instructions = NULL;
+    code->constant_count = 0;
+    code->constants = NULL;
+    code->range_count = 0;
+    code->ranges = NULL;
+    return code;
+}
+
+SclshCode* sclsh_code_ref(SclshCode* code) {
+    if (code) {
+        code->ref_count++;
+    }
+    return code;
+}
+
+void sclsh_code_unref(SclshCode* code) {
+    if (!code || --code->ref_count > 0) {
+        return;
+    }
+    for (size_t i = 0; i < code->constant_count; i++) {
+        sclsh_value_unref(code->constants[i]);
+    }
+    free(code->constants);
+    free(code->instructions);
+    free(code->ranges);
+    free(code);
+}
+
+static void emit(CodeBuilder* builder, SclshOpcode op, uint32_t arg) {
+    SclshCode* code = builder->code;
+    if (code->count == builder->instruction_capacity) {
+        size_t capacity = builder->instruction_capacity ? builder->instruction_capacity * 2 : 16;
+        SclshInstruction* instructions = realloc(code->instructions, sizeof(SclshInstruction) * capacity);
+        if (!instructions) {
+            builder->failed = true;
+            return;
+        }
+        code->instructions = instructions;
+        builder->instruction_capacity = capacity;
+    }
+    code->instructions[code->count].op = op;
+    code->instructions[code->count].arg = arg;
+    code->count++;
+
+    switch (op) {
+        case SCLSH_OP_PUSH:
+        case SCLSH_OP_LOAD:
+        case SCLSH_OP_LOAD_LOCAL:
+        case SCLSH_OP_EXEC:
+        case SCLSH_OP_FOREACH_ITEM:
+            builder->depth++;
+            break;
+        case SCLSH_OP_INVOKE:
+        case SCLSH_OP_CONCAT:
+            builder->depth -= arg - 1;
+            break;
+        case SCLSH_OP_POP:
+        case SCLSH_OP_BRANCH_FALSE:
+        case SCLSH_OP_RETURN:
+        case SCLSH_OP_FOREACH_END:
+            builder->depth--;
+            break;
+        default:
+            break;
+    }
+}
+
+static size_t here(CodeBuilder* builder) {
+    return builder->code->count;
+}
+
+static void add_jump(CodeBuilder* builder, Jumps* jumps, SclshOpcode op) {
+    if (jumps->count == jumps->capacity) {
+        size_t capacity = jumps->capacity ? jumps->capacity * 2 : 4;
+        size_t* at = realloc(jumps->at, sizeof(size_t) * capacity);
+        if (!at) {
+            builder->failed = true;
+            return;
+        }
+        jumps->at = at;
+        jumps->capacity = capacity;
+    }
+    jumps->at[jumps->count++] = here(builder);
+    emit(builder, op, 0);
+}
+
+static void patch_jumps(CodeBuilder* builder, Jumps* jumps, size_t target) {
+    for (size_t i = 0; i < jumps->count; i++) {
+        if (jumps->at[i] < builder->code->count) {
+            builder->code->instructions[jumps->at[i]].arg = (uint32_t)target;
+        }
+    }
+    free(jumps->at);
+    jumps->at = NULL;
+    jumps->count = jumps->capacity = 0;
+}
+
+static void add_range(CodeBuilder* builder, SclshLoopRange range) {
+    SclshCode* code = builder->code;
+    if (code->range_count == builder->range_capacity) {
+        size_t capacity = builder->range_capacity ? builder->range_capacity * 2 : 4;
+        SclshLoopRange* ranges = realloc(code->ranges, sizeof(SclshLoopRange) * capacity);
+        if (!ranges) {
+            builder->failed = true;
+            return;
+        }
+        code->ranges = ranges;
+        builder->range_capacity = capacity;
+    }
+    code->ranges[code->range_count++] = range;
+}
+
+static uint32_t add_constant(CodeBuilder* builder, SclshValue* value) {
+    SclshCode* code = builder->code;
+    if (code->constant_count == builder->constant_capacity) {
+        size_t capacity = builder->constant_capacity ? builder->constant_capacity * 2 : 8;
+        SclshValue** constants = realloc(code->constants, sizeof(SclshValue*) * capacity);
+        if (!constants) {
+            builder->failed = true;
+            return 0;
+        }
+        code->constants = constants;
+        builder->constant_capacity = capacity;
+    }
+    code->constants[code->constant_count] = sclsh_value_ref(value);
+    return (uint32_t)code->constant_count++;
+}
+
+static void emit_empty(CodeBuilder* builder) {
+    SclshValue* empty = sclsh_value_empty();
+    emit(builder, SCLSH_OP_PUSH, add_constant(builder, empty));
+    sclsh_value_unref(empty);
+}
+
+long sclsh_proc_slot(SclshProc* proc, const char* name, bool create) {
+    uintptr_t slot = (uintptr_t)sclsh_hash_map_get(proc->slots, name);
+    if (slot > 0) {
+        return (long)slot - 1;
+    }
+    if (!create) {
+        return -1;
+    }
+    if (proc->local_count == proc->local_capacity) {
+        size_t capacity = proc->local_capacity ? proc->local_capacity * 2 : 8;
+        char** names = realloc(proc->local_names, sizeof(char*) * capacity);
+        if (!names) {
+            return -1;
+        }
+        proc->local_names = names;
+        proc->local_capacity = capacity;
+    }
+    proc->local_names[proc->local_count] = strdup(name);
+    sclsh_hash_map_set(proc->slots, name, (void*)(uintptr_t)(proc->local_count + 1));
+    return (long)proc->local_count++;
+}
+
+// Emits op_local with the slot of name inside procedures and op with the
+// name as a constant elsewhere
+static void emit_variable(CodeBuilder* builder, SclshOpcode op, SclshOpcode op_local, SclshValue* name) {
+    if (builder->proc) {
+        long slot = sclsh_proc_slot(builder->proc, sclsh_value_as_string(name).string, true);
+        if (slot < 0) {
+            builder->failed = true;
+            return;
+        }
+        emit(builder, op_local, (uint32_t)slot);
+    } else {
+        emit(builder, op, add_constant(builder, name));
+    }
+}
+
+static bool is_literal(SclshNode* node, const char* text) {
+    if (node->type != SCLSH_WORD_BARE && node->type != SCLSH_WORD_BRACE) {
+        return false;
+    }
+    return !text || strcmp(sclsh_value_as_string(node->value).string, text) == 0;
+}
+
+static void compile_script(CodeBuilder* builder, SclshValue* script);
+
+static void compile_word(CodeBuilder* builder, SclshNode* node);
+
+// A quoted word: its literal segments become constants, substitutions
+// are compiled like the words they stand for
+static void compile_interpolation(CodeBuilder* builder, SclshValue* word) {
+    SclshNodeList* segments = sclsh_value_as_interpolation(word);
+    if (!segments) {
+        builder->failed = true;
+        return;
+    }
+    if (segments->count == 0) {
+        emit_empty(builder);
+        return;
+    }
+    for (size_t i = 0; i < segments->count; i++) {
+        compile_word(builder, &segments->nodes[i]);
+    }
+    if (segments->count > 1) {
+        emit(builder, SCLSH_OP_CONCAT, (uint32_t)segments->count);
+    }
+}
+
+static void compile_word(CodeBuilder* builder, SclshNode* node) {
+    switch (node->type) {
+        case SCLSH_WORD_QUOTED:
+            compile_interpolation(builder, node->value);
+            break;
+        case SCLSH_WORD_VARIABLE:
+            emit_variable(builder, SCLSH_OP_LOAD, SCLSH_OP_LOAD_LOCAL, node->value);
+            break;
+        case SCLSH_WORD_BRACKET:
+            compile_script(builder, node->value);  // Command substitution runs inline
+            break;
+        default:
+            emit(builder, SCLSH_OP_PUSH, add_constant(builder, node->value));  // Braced and bare words are literal
+            break;
+    }
+}
+
+// Control structures
+
+// Leaves the stack of the innermost loop as it was when the loop started
+// and jumps to one of its targets. The code after it is unreachable, but
+// is compiled as if the command had pushed its result.
+static void compile_loop_exit(CodeBuilder* builder, Jumps* jumps) {
+    size_t depth = builder->depth;
+    while (builder->depth > builder->loop->depth) {
+        emit(builder, SCLSH_OP_POP, 0);
+    }
+    add_jump(builder, jumps, SCLSH_OP_JUMP);
+    builder->depth = depth + 1;
+}
+
+static void begin_loop(CodeBuilder* builder, Loop* loop) {
+    memset(loop, 0, sizeof(Loop));
+    loop->depth = builder->depth;
+    loop->counter_depth = builder->counter_depth;
+    loop->outer = builder->loop;
+    builder->loop = loop;
+}
+
+static void end_loop(
+    CodeBuilder* builder,
+    Loop* loop,
+    size_t body_start,
+    size_t body_end,
+    size_t break_target,
+    size_t continue_target
+) {
+    patch_jumps(builder, &loop->breaks, break_target);
+    patch_jumps(builder, &loop->continues, continue_target);
+    builder->loop = loop->outer;
+
+    SclshLoopRange range = {
+        .start = (uint32_t)body_start,
+        .end = (uint32_t)body_end,
+        .break_target = (uint32_t)break_target,
+        .continue_target = (uint32_t)continue_target,
+        .depth = (uint32_t)loop->depth,
+        .counter_depth = (uint32_t)loop->counter_depth,
+    };
+    add_range(builder, range);
+}
+
+// Body of a loop: leaves nothing on the stack
+static void compile_body(CodeBuilder* builder, SclshNode* body) {
+    compile_script(builder, body->value);
+    emit(builder, SCLSH_OP_POP, 0);
+}
+
+// if cond ?then? body ?elseif cond ?then? body ...? ?else? ?body?
+static bool compile_if(CodeBuilder* builder, SclshNode* nodes, size_t count) {
+    // Check the shape first, anything unusual is left to the command
+    size_t i = 1;
+    for (;;) {
+        if (i + 1 >= count) {
+            return false;
+        }
+        i++;  // Past the condition
+        if (is_literal(&nodes[i], "then")) {
+            i++;
+        }
+        if (i >= count || !is_literal(&nodes[i], NULL)) {
+            return false;
+        }
+        i++;  // Body
+        if (i == count) {
+            break;
+        }
+        if (is_literal(&nodes[i], "elseif")) {
+            i++;
+            continue;
+        }
+        if (is_literal(&nodes[i], "else")) {
+            i++;
+        }
+        if (i + 1 != count || !is_literal(&nodes[i], NULL)) {
+            return false;
+        }
+        break;
+    }
+
+    Jumps ends = { 0 };
+    size_t depth = builder->depth;
+    i = 1;
+    for (;;) {
+        compile_word(builder, &nodes[i++]);
+        size_t branch = here(builder);
+        emit(builder, SCLSH_OP_BRANCH_FALSE, 0);
+        if (is_literal(&nodes[i], "then")) {
+            i++;
+        }
+        compile_script(builder, nodes[i++].value);
+        add_jump(builder, &ends, SCLSH_OP_JUMP);
+        builder->depth = depth;
+        builder->code->instructions[branch].arg = (uint32_t)here(builder);
+
+        if (i == count) {
+            emit_empty(builder);
+            break;
+        }
+        if (is_literal(&nodes[i], "elseif")) {
+            i++;
+            continue;
+        }
+        if (is_literal(&nodes[i], "else")) {
+            i++;
+        }
+        compile_script(builder, nodes[i].value);
+        break;
+    }
+    patch_jumps(builder, &ends, here(builder));
+    return true;
+}
+
+// while cond body
+static bool compile_while(CodeBuilder* builder, SclshNode* nodes, size_t count) {
+    if (count != 3 || !is_literal(&nodes[2], NULL)) {
+        return false;
+    }
+    Loop loop;
+    begin_loop(builder, &loop);
+    size_t top = here(builder);
+    compile_word(builder, &nodes[1]);
+    size_t branch = here(builder);
+    emit(builder, SCLSH_OP_BRANCH_FALSE, 0);
+    size_t body_start = here(builder);
+    compile_body(builder, &nodes[2]);
+    size_t body_end = here(builder);
+    emit(builder, SCLSH_OP_JUMP, (uint32_t)top);
+
+    size_t end = here(builder);
+    builder->code->instructions[branch].arg = (uint32_t)end;
+    end_loop(builder, &loop, body_start, body_end, end, top);
+    emit_empty(builder);
+    return true;
+}
+
+// for init cond step body
+static bool compile_for(CodeBuilder* builder, SclshNode* nodes, size_t count) {
+    if (count != 5 || !is_literal(&nodes[1], NULL) || !is_literal(&nodes[3], NULL) || !is_literal(&nodes[4], NULL)) {
+        return false;
+    }
+    compile_script(builder, nodes[1].value);
+    emit(builder, SCLSH_OP_POP, 0);
+
+    Loop loop;
+    begin_loop(builder, &loop);
+    size_t top = here(builder);
+    compile_word(builder, &nodes[2]);
+    size_t branch = here(builder);
+    emit(builder, SCLSH_OP_BRANCH_FALSE, 0);
+    size_t body_start = here(builder);
+    compile_body(builder, &nodes[4]);
+    size_t body_end = here(builder);
+    size_t step = here(builder);
+    compile_body(builder, &nodes[3]);
+    emit(builder, SCLSH_OP_JUMP, (uint32_t)top);
+
+    size_t end = here(builder);
+    builder->code->instructions[branch].arg = (uint32_t)end;
+    end_loop(builder, &loop, body_start, body_end, end, step);
+    emit_empty(builder);
+    return true;
+}
+
+// foreach varlist list body
+static bool compile_foreach(CodeBuilder* builder, SclshNode* nodes, size_t count) {
+    if (count != 4 || !is_literal(&nodes[1], NULL) || !is_literal(&nodes[3], NULL)) {
+        return false;
+    }
+    SclshValueList* vars = sclsh_value_as_list(nodes[1].value);
+    if (!vars || vars->count == 0) {
+        return false;
+    }
+
+    compile_word(builder, &nodes[2]);
+    emit(builder, SCLSH_OP_FOREACH_START, 0);
+    builder->counter_depth++;
+
+    SclshValue* empty = sclsh_value_empty();
+    uint32_t empty_constant = add_constant(builder, empty);
+    sclsh_value_unref(empty);
+
+    Loop loop;
+    begin_loop(builder, &loop);
+    size_t top = here(builder);
+    size_t test = here(builder);
+    emit(builder, SCLSH_OP_FOREACH_TEST, 0);
+    for (size_t i = 0; i < vars->count; i++) {
+        emit(builder, SCLSH_OP_FOREACH_ITEM, empty_constant);
+        emit_variable(builder, SCLSH_OP_STORE, SCLSH_OP_STORE_LOCAL, vars->items[i]);
+        emit(builder, SCLSH_OP_POP, 0);
+    }
+    size_t body_start = here(builder);
+    compile_body(builder, &nodes[3]);
+    size_t body_end = here(builder);
+    emit(builder, SCLSH_OP_JUMP, (uint32_t)top);
+
+    size_t end = here(builder);
+    builder->code->instructions[test].arg = (uint32_t)end;
+    end_loop(builder, &loop, body_start, body_end, end, top);
+    emit(builder, SCLSH_OP_FOREACH_END, 0);
+    builder->counter_depth--;
+    emit_empty(builder);
+    return true;
+}
+
+// Commands that compiled code runs without invoking them, which is why
+// they cannot be redefined
+static const char* const inlined_commands[] = {
+    "set", "if", "while", "for", "foreach", "incr", "break", "continue", "return", NULL
+};
+
+bool sclsh_code_inlines(const char* name) {
+    for (size_t i = 0; inlined_commands[i]; i++) {
+        if (strcmp(name, inlined_commands[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Compiles the command if it is a control structure with literal bodies,
+// returning false to leave it to the command of the same name
+static bool compile_control(CodeBuilder* builder, SclshNodeList* command_line) {
+    SclshNode* nodes = command_line->nodes;
+    size_t count = command_line->count;
+    if (!is_literal(&nodes[0], NULL)) {
+        return false;
+    }
+    const char* name = sclsh_value_as_string(nodes[0].value).string;
+
+    if (strcmp(name, "if") == 0) {
+        return compile_if(builder, nodes, count);
+    }
+    if (strcmp(name, "while") == 0) {
+        return compile_while(builder, nodes, count);
+    }
+    if (strcmp(name, "for") == 0) {
+        return compile_for(builder, nodes, count);
+    }
+    if (strcmp(name, "foreach") == 0) {
+        return compile_foreach(builder, nodes, count);
+    }
+    if (strcmp(name, "incr") == 0 && (count == 2 || count == 3) && is_literal(&nodes[1], NULL)) {
+        if (count == 3) {
+            compile_word(builder, &nodes[2]);
+        } else {
+            SclshValue* one = sclsh_value_new("1", 1);
+            emit(builder, SCLSH_OP_PUSH, add_constant(builder, one));
+            sclsh_value_unref(one);
+        }
+        emit_variable(builder, SCLSH_OP_INCR, SCLSH_OP_INCR_LOCAL, nodes[1].value);
+        return true;
+    }
+    // Outside of a loop these raise their exception at run time
+    if (count == 1 && builder->loop && strcmp(name, "break") == 0) {
+        compile_loop_exit(builder, &builder->loop->breaks);
+        return true;
+    }
+    if (count == 1 && builder->loop && strcmp(name, "continue") == 0) {
+        compile_loop_exit(builder, &builder->loop->continues);
+        return true;
+    }
+    // Only the body of a procedure can return straight from its frame
+    if (count <= 2 && builder->proc && strcmp(name, "return") == 0) {
+        size_t depth = builder->depth;
+        if (count == 2) {
+            compile_word(builder, &nodes[1]);
+        } else {
+            emit_empty(builder);
+        }
+        emit(builder, SCLSH_OP_RETURN, 0);
+        builder->depth = depth + 1;
+        return true;
+    }
+    return false;
+}
+
+static void compile_command(CodeBuilder* builder, SclshValue* command) {
+    SclshNodeList* command_line = sclsh_value_as_command_line(command);
+    if (!command_line) {
+        builder->failed = true;
+        return;
+    }
+    if (command_line->count == 0) {
+        emit_empty(builder);
+        return;
+    }
+    // Pipelines and redirections evaluate their own words, see exec.c
+    if (sclsh_exec_is_pipeline(command_line)) {
+        emit(builder, SCLSH_OP_EXEC, add_constant(builder, command));
+        return;
+    }
+    // set with a literal name stores without invoking anything
+    SclshNode* nodes = command_line->nodes;
+    if (command_line->count == 3 && is_literal(&nodes[0], "set") && is_literal(&nodes[1], NULL)) {
+        compile_word(builder, &nodes[2]);
+        emit_variable(builder, SCLSH_OP_STORE, SCLSH_OP_STORE_LOCAL, nodes[1].value);
+        return;
+    }
+    if (compile_control(builder, command_line)) {
+        return;
+    }
+    for (size_t i = 0; i < command_line->count; i++) {
+        compile_word(builder, &nodes[i]);
+    }
+    emit(builder, SCLSH_OP_INVOKE, (uint32_t)command_line->count);
+}
+
+static void compile_script(CodeBuilder* builder, SclshValue* script) {
+    SclshValueList* commands = sclsh_value_as_proc(script);
+    if (!commands) {
+        builder->failed = true;
+        return;
+    }
+    if (commands->count == 0) {
+        emit_empty(builder);
+        return;
+    }
+    for (size_t i = 0; i < commands->count; i++) {
+        if (i > 0) {
+            emit(builder, SCLSH_OP_POP, 0);  // Only the last result is kept
+        }
+        compile_command(builder, commands->items[i]);
+    }
+}
+
+static SclshCode* finish(CodeBuilder* builder) {
+    if (builder->failed) {
+        sclsh_code_unref(builder->code);
+        return NULL;
+    }
+    return builder->code;
+}
+
+SclshCode* sclsh_value_as_code(SclshValue* value) {
+    if (!value) {
+        return NULL;
+    }
+    if (value->as_code) {
+        SCLSH_STAT(code.hits);
+    } else {
+        SCLSH_STAT(code.conversions);
+        CodeBuilder builder = { .code = code_new() };
+        if (!builder.code) {
+            return NULL;
+        }
+        compile_script(&builder, value);
+        value->as_code = finish(&builder);
+    }
+    return value->as_code;
+}
+
+SclshCode* sclsh_code_compile_proc(SclshProc* proc) {
+    CodeBuilder builder = { .code = code_new(), .proc = proc };
+    if (!builder.code) {
+        return NULL;
+    }
+    compile_script(&builder, proc->body);
+    return finish(&builder);
+}
+
+SclshCode* sclsh_code_new_invocation(size_t argc, SclshValue** argv) {
+    CodeBuilder builder = { .code = code_new() };
+    if (!builder.code) {
+        return NULL;
+    }
+    for (size_t i = 0; i < argc; i++) {
+        emit(&builder, SCLSH_OP_PUSH, add_constant(&builder, argv[i]));
+    }
+    emit(&builder, SCLSH_OP_INVOKE, (uint32_t)argc);
+    return finish(&builder);
+}
@@ -0,0 +1,358 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/vm.h>
+#include <sclsh/expr.h>
+#include <sclsh/unwind.h>
+#include <sclsh/glob.h>
+#include "code.h"
+#include "value.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Control structures as commands.
+ *
+ * The compiler turns if, while, for, foreach and friends with literal
+ * bodies into jumps (see compile.c); these commands run the rest, e.g. a
+ * body held in a variable. Loops evaluate their bodies through
+ * continuations, so they never nest on the C stack and may yield.
+ *
+ * break, continue and return fail with the matching unwind kind set
+ * (see unwind.h), which loops and procedure bodies catch.
+ */
+
+// Integer value of a word for incr, which also takes integral reals such
+// as those expr produces
+static bool as_integer(SclshValue* value, long long* n) {
+    char* string = sclsh_value_as_string(value).string;
+    char* end;
+    *n = strtoll(string, &end, 10);
+    if (end != string && *end == '\0') {
+        return true;
+    }
+    double d = strtod(string, &end);
+    if (end != string && *end == '\0' && d == floor(d) && fabs(d) < 9.2e18) {
+        *n = (long long)d;
+        return true;
+    }
+    fprintf(stderr, "Expected integer but got '%s'\n", string);
+    return false;
+}
+
+SclshValue* sclsh_incr_value(SclshValue* variable, SclshValue* amount) {
+    long long current = 0;
+    long long delta;
+    if ((variable && !as_integer(variable, &current)) || !as_integer(amount, &delta)) {
+        return NULL;
+    }
+    return sclsh_value_with_integer(variable, (long long)((unsigned long long)current + (unsigned long long)delta));
+}
+
+// Ends a loop when its body failed. Returns true if the loop goes on
+// (after continue), otherwise sets *result: "" after break, NULL for
+// anything else.
+static bool body_failed(SclshValue** result) {
+    SclshUnwindKind kind = sclsh_get_unwind();
+    if (kind == SCLSH_UNWIND_CONTINUE) {
+        sclsh_clear_unwind();
+        return true;
+    }
+    if (kind == SCLSH_UNWIND_BREAK) {
+        sclsh_clear_unwind();
+        *result = sclsh_value_empty();
+        return false;
+    }
+    *result = NULL;
+    return false;
+}
+
+static SclshValue* cmd_if(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    size_t i = 0;
+    for (;;) {
+        if (i + 1 >= argc) {
+            break;
+        }
+        bool taken = sclsh_expr_eval_bool(ctx, argv[i++]);
+        if (strcmp(sclsh_value_as_string(argv[i]).string, "then") == 0 && ++i == argc) {
+            break;
+        }
+        SclshValue* body = argv[i++];
+        if (taken) {
+            return sclsh_eval_then(ctx, body, NULL, NULL);
+        }
+        if (i == argc) {
+            return sclsh_value_empty();
+        }
+        char* word = sclsh_value_as_string(argv[i]).string;
+        if (strcmp(word, "elseif") == 0) {
+            i++;
+            continue;
+        }
+        if (strcmp(word, "else") == 0) {
+            i++;
+        }
+        if (i + 1 != argc) {
+            break;
+        }
+        return sclsh_eval_then(ctx, argv[i], NULL, NULL);
+    }
+    fprintf(stderr, "Usage: if <condition> ?then? <body> ?elseif <condition> ?then? <body> ...? ?else? ?body?\n");
+    return NULL;
+}
+
+/* switch ?-exact|-glob? ?--? <string> {<pattern> <body> ...}, the pairs
+ * also given as separate words. The first matching pattern wins, default
+ * as the last one matches anything, and a body of - runs the body of
+ * the next pair.
+ */
+static SclshValue* cmd_switch(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    bool glob = false;
+    size_t i = 0;
+    for (; i + 1 < argc; i++) {
+        char* option = sclsh_value_as_string(argv[i]).string;
+        if (option[0] != '-') {
+            break;
+        }
+        if (strcmp(option, "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(option, "-glob") == 0) {
+            glob = true;
+        } else if (strcmp(option, "-exact") == 0) {
+            glob = false;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", option);
+            return NULL;
+        }
+    }
+    SclshValue** clauses = argv + i + 1;
+    size_t count = i < argc ? argc - i - 1 : 0;
+    if (count == 1) {
+        SclshValueList* list = sclsh_value_as_list(clauses[0]);
+        clauses = list ? list->items : NULL;
+        count = list ? list->count : 0;
+    }
+    if (count == 0 || count % 2 != 0) {
+        fprintf(stderr, "Usage: switch ?-exact|-glob? ?--? <string> {<pattern> <body> ...}\n");
+        return NULL;
+    }
+
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[i]);
+    for (size_t k = 0; k < count; k += 2) {
+        SclshStringBuffer pattern = sclsh_value_as_bytes(clauses[k]);
+        bool matched;
+        if (k + 2 == count && pattern.length == 7 && memcmp(pattern.string, "default", 7) == 0) {
+            matched = true;
+        } else if (glob) {
+            matched = sclsh_glob_match(clauses[k], string);
+        } else {
+            matched = pattern.length == string.length && memcmp(pattern.string, string.string, string.length) == 0;
+        }
+        if (matched) {
+            while (k + 2 < count && strcmp(sclsh_value_as_string(clauses[k + 1]).string, "-") == 0) {
+                k += 2;
+            }
+            return sclsh_eval_then(ctx, clauses[k + 1], NULL, NULL);
+        }
+    }
+    return sclsh_value_empty();
+}
+
+typedef struct Loop_s {
+    SclshValue* condition;  // NULL for foreach
+    SclshValue* step;  // for only
+    SclshValue* body;
+    bool stepping;  // for: the step is running, not the body
+    char* var_name;  // foreach only
+    SclshValue* list;
+    size_t index;
+} Loop;
+
+static SclshValue* loop_finish(Loop* loop, SclshValue* result) {
+    sclsh_value_unref(loop->condition);
+    sclsh_value_unref(loop->step);
+    sclsh_value_unref(loop->body);
+    sclsh_value_unref(loop->list);
+    free(loop->var_name);
+    free(loop);
+    return result;
+}
+
+static Loop* loop_new(SclshValue* condition, SclshValue* step, SclshValue* body) {
+    Loop* loop = calloc(1, sizeof(Loop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->condition = sclsh_value_ref(condition);
+    loop->step = sclsh_value_ref(step);
+    loop->body = sclsh_value_ref(body);
+    return loop;
+}
+
+// Runs after the body (and for the step) of while and for
+static SclshValue* loop_next(SclshContext* ctx, SclshValue* result, void* data) {
+    Loop* loop = data;
+    if (!result) {
+        if (loop->stepping || !body_failed(&result)) {
+            return loop_finish(loop, result);
+        }
+    }
+    sclsh_value_unref(result);
+
+    if (loop->step && !loop->stepping) {
+        loop->stepping = true;
+        return sclsh_eval_then(ctx, loop->step, loop_next, loop);
+    }
+    loop->stepping = false;
+    if (!sclsh_expr_eval_bool(ctx, loop->condition)) {
+        return loop_finish(loop, sclsh_value_empty());
+    }
+    return sclsh_eval_then(ctx, loop->body, loop_next, loop);
+}
+
+static SclshValue* cmd_while(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 2) {
+        fprintf(stderr, "Usage: while <condition> <body>\n");
+        return NULL;
+    }
+    Loop* loop = loop_new(argv[0], NULL, argv[1]);
+    if (!loop) {
+        return NULL;
+    }
+    return loop_next(ctx, sclsh_value_empty(), loop);
+}
+
+// Runs after the initialization of for
+static SclshValue* for_start(SclshContext* ctx, SclshValue* result, void* data) {
+    Loop* loop = data;
+    if (!result) {
+        return loop_finish(loop, NULL);
+    }
+    loop->stepping = true;  // Goes straight to the condition
+    return loop_next(ctx, result, loop);
+}
+
+static SclshValue* cmd_for(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 4) {
+        fprintf(stderr, "Usage: for <init> <condition> <step> <body>\n");
+        return NULL;
+    }
+    Loop* loop = loop_new(argv[1], argv[2], argv[3]);
+    if (!loop) {
+        return NULL;
+    }
+    return sclsh_eval_then(ctx, argv[0], for_start, loop);
+}
+
+static SclshValue* foreach_next(SclshContext* ctx, SclshValue* result, void* data) {
+    Loop* loop = data;
+    if (!result && !body_failed(&result)) {
+        return loop_finish(loop, result);
+    }
+    sclsh_value_unref(result);
+
+    SclshValueList* vars = sclsh_value_as_list(loop->condition);
+    SclshValueList* items = sclsh_value_as_list(loop->list);
+    if (!items || loop->index >= items->count) {
+        return loop_finish(loop, sclsh_value_empty());
+    }
+    for (size_t i = 0; i < vars->count; i++) {
+        char* name = sclsh_value_as_string(vars->items[i]).string;
+        if (loop->index < items->count) {
+            sclsh_context_set_variable(ctx, name, items->items[loop->index++]);
+        } else {
+            SclshValue* empty = sclsh_value_empty();
+            sclsh_context_set_variable(ctx, name, empty);
+            sclsh_value_unref(empty);
+        }
+    }
+    return sclsh_eval_then(ctx, loop->body, foreach_next, loop);
+}
+
+static SclshValue* cmd_foreach(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 3) {
+        fprintf(stderr, "Usage: foreach <variables> <list> <body>\n");
+        return NULL;
+    }
+    SclshValueList* vars = sclsh_value_as_list(argv[0]);
+    if (!vars || vars->count == 0) {
+        fprintf(stderr, "foreach: no variables given\n");
+        return NULL;
+    }
+    Loop* loop = loop_new(argv[0], NULL, argv[2]);  // The variables take the place of the condition
+    if (!loop) {
+        return NULL;
+    }
+    loop->list = sclsh_value_ref(argv[1]);
+    return foreach_next(ctx, sclsh_value_empty(), loop);
+}
+
+static SclshValue* cmd_break(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx; (void)argv; (void)user_data; // Suppress unused parameter warnings
+    if (argc != 0) {
+        fprintf(stderr, "Usage: break\n");
+        return NULL;
+    }
+    sclsh_set_unwind(SCLSH_UNWIND_BREAK, NULL);
+    return NULL;
+}
+
+static SclshValue* cmd_continue(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx; (void)argv; (void)user_data; // Suppress unused parameter warnings
+    if (argc != 0) {
+        fprintf(stderr, "Usage: continue\n");
+        return NULL;
+    }
+    sclsh_set_unwind(SCLSH_UNWIND_CONTINUE, NULL);
+    return NULL;
+}
+
+static SclshValue* cmd_return(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx; (void)user_data; // Suppress unused parameter warnings
+    if (argc > 1) {
+        fprintf(stderr, "Usage: return ?value?\n");
+        return NULL;
+    }
+    sclsh_set_unwind(SCLSH_UNWIND_RETURN, argc == 1 ? argv[0] : NULL);
+    return NULL;
+}
+
+static SclshValue* cmd_incr(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: incr <variable> ?amount?\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    SclshValue* one = argc == 2 ? NULL : sclsh_value_one();
+    SclshValue* value = sclsh_incr_value(sclsh_context_get_variable(ctx, name), argc == 2 ? argv[1] : one);
+    sclsh_value_unref(one);
+    if (value) {
+        sclsh_context_set_variable(ctx, name, value);
+    }
+    return value;
+}
+
+void sclsh_register_control_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "if", cmd_if, NULL, NULL);
+    sclsh_command_new(interp, "switch", cmd_switch, NULL, NULL);
+    sclsh_command_new(interp, "while", cmd_while, NULL, NULL);
+    sclsh_command_new(interp, "for", cmd_for, NULL, NULL);
+    sclsh_command_new(interp, "foreach", cmd_foreach, NULL, NULL);
+    sclsh_command_new(interp, "break", cmd_break, NULL, NULL);
+    sclsh_command_new(interp, "continue", cmd_continue, NULL, NULL);
+    sclsh_command_new(interp, "return", cmd_return, NULL, NULL);
+    sclsh_command_new(interp, "incr", cmd_incr, NULL, NULL);
+}
@@ -0,0 +1,759 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/event.h>
+#include <sclsh/output.h>
+#include <sclsh/util.h>
+#include "value.h"
+#include "interp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define MAX_EVENTS 256
+
+typedef struct Handler_s {
+    SclshEventCallback callback;
+    void* user_data;
+    SclshUserDataDestructor* user_data_destructor;
+} Handler;
+
+typedef struct Timer_s {
+    uint64_t deadline;  // CLOCK_MONOTONIC nanoseconds
+    unsigned long id;
+    Handler handler;
+} Timer;
+
+typedef struct Watch_s {
+    int fd;
+    SclshChannel* chan;  // Channel watches only
+    Handler handlers[2];  // Readable, writable
+    uint32_t registered;  // Events currently registered with epoll
+    bool always_ready;  // Regular files cannot be polled
+    bool queued;  // On the immediate list
+    bool removed;
+    struct Watch_s* next_garbage;
+} Watch;
+
+// Handlers being run; releasing one of them is deferred until it returns
+typedef struct Running_s {
+    void* user_data;
+    SclshUserDataDestructor* deferred;
+    struct Running_s* outer;
+} Running;
+
+// Variables vwait is waiting for, innermost first
+typedef struct VariableWait_s {
+    const char* name;
+    bool written;
+    struct VariableWait_s* outer;
+} VariableWait;
+
+struct SclshEventLoop_s {
+    SclshInterpreter* interp;
+    int epoll_fd;
+    int timer_fd;
+
+    Timer* timers;  // Binary heap ordered by deadline, then id
+    size_t timer_count;
+    size_t timer_capacity;
+    uint64_t armed;  // Deadline the timerfd is set for, 0 when disarmed
+    unsigned long next_timer_id;
+
+    Watch** watches;  // Indexed by descriptor
+    size_t watch_capacity;
+    size_t watch_count;
+    Watch** immediate;  // Ready without asking the kernel
+    size_t immediate_count;
+    size_t immediate_capacity;
+    Watch* garbage;  // Removed watches, freed once no dispatch is in progress
+
+    int depth;  // Nesting of run_once through vwait
+    Running* running;
+    VariableWait* waits;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+SclshEventLoop* sclsh_interpreter_event_loop(SclshInterpreter* interp) {
+    if (!interp) {
+        return NULL;
+    }
+    if (interp->events) {
+        return interp->events;
+    }
+
+    SclshEventLoop* loop = calloc(1, sizeof(SclshEventLoop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->interp = interp;
+    loop->next_timer_id = 1;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };  // NULL marks the timerfd
+    if (loop->epoll_fd < 0 || loop->timer_fd < 0
+        || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &ev) < 0) {
+        fprintf(stderr, "Cannot create event loop: %s\n", strerror(errno));
+        if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+        if (loop->timer_fd >= 0) close(loop->timer_fd);
+        free(loop);
+        return NULL;
+    }
+    interp->events = loop;
+    return loop;
+}
+
+static void run_handler(SclshEventLoop* loop, Handler handler) {
+    Running running = { .user_data = handler.user_data, .deferred = NULL, .outer = loop->running };
+    loop->running = &running;
+    int ok = handler.callback(loop->interp, handler.user_data);
+    loop->running = running.outer;
+    if (!ok) {
+        fprintf(stderr, "Error in event handler\n");
+    }
+    if (running.deferred) {
+        running.deferred(handler.user_data);
+    }
+}
+
+static void release_handler(SclshEventLoop* loop, Handler* handler) {
+    if (handler->callback && handler->user_data_destructor) {
+        Running* running = loop->running;
+        while (running && running->user_data != handler->user_data) {
+            running = running->outer;
+        }
+        if (running) {
+            running->deferred = handler->user_data_destructor;
+        } else {
+            handler->user_data_destructor(handler->user_data);
+        }
+    }
+    handler->callback = NULL;
+    handler->user_data = NULL;
+    handler->user_data_destructor = NULL;
+}
+
+static void free_garbage(SclshEventLoop* loop) {
+    while (loop->garbage) {
+        Watch* next = loop->garbage->next_garbage;
+        free(loop->garbage);
+        loop->garbage = next;
+    }
+}
+
+void sclsh_event_loop_free(SclshEventLoop* loop) {
+    if (!loop) {
+        return;
+    }
+    for (size_t i = 0; i < loop->timer_count; i++) {
+        release_handler(loop, &loop->timers[i].handler);
+    }
+    for (size_t fd = 0; fd < loop->watch_capacity; fd++) {
+        Watch* watch = loop->watches[fd];
+        if (watch) {
+            release_handler(loop, &watch->handlers[0]);
+            release_handler(loop, &watch->handlers[1]);
+            free(watch);
+        }
+    }
+    free_garbage(loop);
+    free(loop->timers);
+    free(loop->watches);
+    free(loop->immediate);
+    close(loop->timer_fd);
+    close(loop->epoll_fd);
+    free(loop);
+}
+
+int sclsh_event_loop_fd(SclshEventLoop* loop) {
+    return loop ? loop->epoll_fd : -1;
+}
+
+int sclsh_event_loop_has_handlers(SclshEventLoop* loop) {
+    return loop && (loop->timer_count > 0 || loop->watch_count > 0) ? 1 : 0;
+}
+
+// Timer heap
+
+static bool timer_before(const Timer* a, const Timer* b) {
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->id < b->id);
+}
+
+static void timer_swap(Timer* a, Timer* b) {
+    Timer tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void sift_up(Timer* heap, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!timer_before(&heap[index], &heap[parent])) {
+            break;
+        }
+        timer_swap(&heap[index], &heap[parent]);
+        index = parent;
+    }
+}
+
+static void sift_down(Timer* heap, size_t count, size_t index) {
+    for (;;) {
+        size_t smallest = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < count && timer_before(&heap[left], &heap[smallest])) smallest = left;
+        if (right < count && timer_before(&heap[right], &heap[smallest])) smallest = right;
+        if (smallest == index) {
+            break;
+        }
+        timer_swap(&heap[index], &heap[smallest]);
+        index = smallest;
+    }
+}
+
+static Timer remove_timer_at(SclshEventLoop* loop, size_t index) {
+    Timer timer = loop->timers[index];
+    loop->timer_count--;
+    if (index < loop->timer_count) {
+        loop->timers[index] = loop->timers[loop->timer_count];
+        sift_down(loop->timers, loop->timer_count, index);
+        sift_up(loop->timers, index);
+    }
+    return timer;
+}
+
+// Points the timerfd at the earliest deadline
+static void arm_timer(SclshEventLoop* loop) {
+    uint64_t deadline = loop->timer_count > 0 ? loop->timers[0].deadline : 0;
+    if (deadline == loop->armed) {
+        return;
+    }
+    struct itimerspec spec = { 0 };  // All zero disarms
+    spec.it_value.tv_sec = (time_t)(deadline / 1000000000u);
+    spec.it_value.tv_nsec = (long)(deadline % 1000000000u);
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+    loop->armed = deadline;
+}
+
+unsigned long sclsh_event_after(
+    SclshEventLoop* loop,
+    long delay_ms,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+) {
+    if (!loop || !callback) {
+        return 0;
+    }
+    if (loop->timer_count == loop->timer_capacity) {
+        size_t capacity = loop->timer_capacity ? loop->timer_capacity * 2 : 16;
+        Timer* timers = realloc(loop->timers, sizeof(Timer) * capacity);
+        if (!timers) {
+            return 0;
+        }
+        loop->timers = timers;
+        loop->timer_capacity = capacity;
+    }
+    unsigned long id = loop->next_timer_id++;
+    Timer* timer = &loop->timers[loop->timer_count];
+    timer->deadline = now_ns() + (uint64_t)(delay_ms > 0 ? delay_ms : 0) * 1000000u;
+    timer->id = id;
+    timer->handler.callback = callback;
+    timer->handler.user_data = user_data;
+    timer->handler.user_data_destructor = user_data_destructor;
+    sift_up(loop->timers, loop->timer_count++);  // May move the timer
+    arm_timer(loop);
+    return id;
+}
+
+int sclsh_event_cancel(SclshEventLoop* loop, unsigned long id) {
+    if (!loop) {
+        return 0;
+    }
+    for (size_t i = 0; i < loop->timer_count; i++) {
+        if (loop->timers[i].id == id) {
+            Timer timer = remove_timer_at(loop, i);
+            release_handler(loop, &timer.handler);
+            arm_timer(loop);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Runs the timers that were due when called; timers they add wait for
+// the next round even if their delay is zero
+static int run_due_timers(SclshEventLoop* loop) {
+    uint64_t now = now_ns();
+    unsigned long last_id = loop->next_timer_id - 1;
+    int handled = 0;
+    while (loop->timer_count > 0
+           && loop->timers[0].deadline <= now
+           && loop->timers[0].id <= last_id) {
+        Timer timer = remove_timer_at(loop, 0);
+        run_handler(loop, timer.handler);
+        if (timer.handler.user_data_destructor) {
+            timer.handler.user_data_destructor(timer.handler.user_data);
+        }
+        handled++;
+    }
+    return handled;
+}
+
+// Descriptor watches
+
+static void queue_immediate(SclshEventLoop* loop, Watch* watch) {
+    if (watch->queued) {
+        return;
+    }
+    if (loop->immediate_count == loop->immediate_capacity) {
+        size_t capacity = loop->immediate_capacity ? loop->immediate_capacity * 2 : 16;
+        Watch** immediate = realloc(loop->immediate, sizeof(Watch*) * capacity);
+        if (!immediate) {
+            return;
+        }
+        loop->immediate = immediate;
+        loop->immediate_capacity = capacity;
+    }
+    loop->immediate[loop->immediate_count++] = watch;
+    watch->queued = true;
+}
+
+static Watch* watch_for(SclshEventLoop* loop, int fd) {
+    if ((size_t)fd >= loop->watch_capacity) {
+        size_t capacity = loop->watch_capacity ? loop->watch_capacity : 64;
+        while (capacity <= (size_t)fd) {
+            capacity *= 2;
+        }
+        Watch** watches = realloc(loop->watches, sizeof(Watch*) * capacity);
+        if (!watches) {
+            return NULL;
+        }
+        memset(watches + loop->watch_capacity, 0, sizeof(Watch*) * (capacity - loop->watch_capacity));
+        loop->watches = watches;
+        loop->watch_capacity = capacity;
+    }
+    if (!loop->watches[fd]) {
+        Watch* watch = calloc(1, sizeof(Watch));
+        if (!watch) {
+            return NULL;
+        }
+        watch->fd = fd;
+        loop->watches[fd] = watch;
+        loop->watch_count++;
+    }
+    return loop->watches[fd];
+}
+
+static void drop_watch(SclshEventLoop* loop, Watch* watch) {
+    if (watch->registered) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+    }
+    loop->watches[watch->fd] = NULL;
+    loop->watch_count--;
+    watch->removed = true;
+    watch->next_garbage = loop->garbage;
+    loop->garbage = watch;
+}
+
+// Brings the epoll registration in line with the installed handlers
+static int update_watch(SclshEventLoop* loop, Watch* watch) {
+    if (!watch->handlers[0].callback && !watch->handlers[1].callback) {
+        drop_watch(loop, watch);
+        return 1;
+    }
+    if (watch->always_ready) {
+        return 1;
+    }
+    uint32_t wanted = (watch->handlers[0].callback ? EPOLLIN : 0)
+                    | (watch->handlers[1].callback ? EPOLLOUT : 0);
+    if (wanted == watch->registered) {
+        return 1;
+    }
+    struct epoll_event ev = { .events = wanted, .data.ptr = watch };
+    int op = watch->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(loop->epoll_fd, op, watch->fd, &ev) < 0) {
+        if (errno == EPERM) {
+            watch->always_ready = true;
+            queue_immediate(loop, watch);
+            return 1;
+        }
+        fprintf(stderr, "Cannot watch descriptor %d: %s\n", watch->fd, strerror(errno));
+        return 0;
+    }
+    watch->registered = wanted;
+    return 1;
+}
+
+int sclsh_event_watch(
+    SclshEventLoop* loop,
+    int fd,
+    SclshEventKind kind,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+) {
+    if (!loop || fd < 0) {
+        return 0;
+    }
+    if (!callback && ((size_t)fd >= loop->watch_capacity || !loop->watches[fd])) {
+        return 1;  // Nothing to remove
+    }
+    Watch* watch = watch_for(loop, fd);
+    if (!watch) {
+        return 0;
+    }
+    Handler* handler = &watch->handlers[kind == SCLSH_EVENT_READABLE ? 0 : 1];
+    release_handler(loop, handler);
+    handler->callback = callback;
+    handler->user_data = user_data;
+    handler->user_data_destructor = user_data_destructor;
+    if (!update_watch(loop, watch)) {
+        release_handler(loop, handler);
+        update_watch(loop, watch);
+        return 0;
+    }
+    return 1;
+}
+
+int sclsh_event_watch_channel(
+    SclshEventLoop* loop,
+    SclshChannel* chan,
+    SclshEventKind kind,
+    SclshEventCallback callback,
+    void* user_data,
+    SclshUserDataDestructor* user_data_destructor
+) {
+    int fd = sclsh_channel_fd(chan);
+    if (fd < 0) {
+        fprintf(stderr, "Channel has no descriptor to watch\n");
+        return 0;
+    }
+    if (!sclsh_event_watch(loop, fd, kind, callback, user_data, user_data_destructor)) {
+        return 0;
+    }
+    Watch* watch = (size_t)fd < loop->watch_capacity ? loop->watches[fd] : NULL;
+    if (watch) {
+        watch->chan = chan;
+        if (watch->handlers[0].callback && sclsh_channel_pending(chan)) {
+            queue_immediate(loop, watch);
+        }
+    }
+    return 1;
+}
+
+void sclsh_event_unwatch(SclshEventLoop* loop, int fd) {
+    if (!loop || fd < 0 || (size_t)fd >= loop->watch_capacity || !loop->watches[fd]) {
+        return;
+    }
+    Watch* watch = loop->watches[fd];
+    release_handler(loop, &watch->handlers[0]);
+    release_handler(loop, &watch->handlers[1]);
+    drop_watch(loop, watch);
+}
+
+static int dispatch_watch(SclshEventLoop* loop, Watch* watch, bool readable, bool writable) {
+    int handled = 0;
+    if (readable && watch->handlers[0].callback) {
+        run_handler(loop, watch->handlers[0]);
+        handled++;
+    }
+    if (writable && !watch->removed && watch->handlers[1].callback) {
+        run_handler(loop, watch->handlers[1]);
+        handled++;
+    }
+    // Input a handler left in the channel buffer is not visible to epoll
+    if (!watch->removed && (watch->always_ready
+        || (watch->chan && watch->handlers[0].callback && sclsh_channel_pending(watch->chan)))) {
+        queue_immediate(loop, watch);
+    }
+    return handled;
+}
+
+int sclsh_event_loop_run_once(SclshEventLoop* loop, long timeout_ms) {
+    if (!loop) {
+        return -1;
+    }
+    if (loop->immediate_count > 0) {
+        timeout_ms = 0;
+    }
+    if (timeout_ms != 0) {
+        sclsh_output_flush(sclsh_interpreter_output(loop->interp));  // Show progress before blocking
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int count;
+    do {
+        count = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout_ms < 0 ? -1 : (int)timeout_ms);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        fprintf(stderr, "Event loop wait failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    loop->depth++;
+    int handled = 0;
+
+    Watch** ready = loop->immediate;
+    size_t ready_count = loop->immediate_count;
+    loop->immediate = NULL;
+    loop->immediate_count = 0;
+    loop->immediate_capacity = 0;
+    for (size_t i = 0; i < ready_count; i++) {
+        ready[i]->queued = false;
+    }
+    for (size_t i = 0; i < ready_count; i++) {
+        Watch* watch = ready[i];
+        if (!watch->removed) {
+            handled += dispatch_watch(loop, watch, true, watch->always_ready);
+        }
+    }
+    free(ready);
+
+    for (int i = 0; i < count; i++) {
+        Watch* watch = events[i].data.ptr;
+        if (!watch) {
+            uint64_t expirations;
+            ssize_t res = read(loop->timer_fd, &expirations, sizeof(expirations));
+            (void)res;  // Only clears the readiness; due timers are found below
+            loop->armed = 0;
+            continue;
+        }
+        if (watch->removed) {
+            continue;  // Dropped by an earlier handler in this round
+        }
+        uint32_t flags = events[i].events;
+        handled += dispatch_watch(
+            loop, watch,
+            flags & (EPOLLIN | EPOLLHUP | EPOLLERR),
+            flags & (EPOLLOUT | EPOLLHUP | EPOLLERR)
+        );
+    }
+
+    handled += run_due_timers(loop);
+    arm_timer(loop);
+
+    if (--loop->depth == 0) {
+        free_garbage(loop);
+    }
+    return handled;
+}
+
+void sclsh_event_note_variable(SclshEventLoop* loop, const char* name) {
+    for (VariableWait* wait = loop->waits; wait; wait = wait->outer) {
+        if (strcmp(wait->name, name) == 0) {
+            wait->written = true;
+        }
+    }
+}
+
+// Script commands
+
+static int run_script(SclshInterpreter* interp, void* user_data) {
+    SclshValue* result = sclsh_eval_script(sclsh_global_context(interp), user_data);
+    if (!result) {
+        return 0;
+    }
+    sclsh_value_unref(result);
+    return 1;
+}
+
+static void release_script(void* user_data) {
+    sclsh_value_unref(user_data);
+}
+
+static SclshValue* cmd_after(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: after <ms> ?script? | after idle <script> | after cancel <id>\n");
+        return NULL;
+    }
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    char* first = sclsh_value_as_string(argv[0]).string;
+
+    if (strcmp(first, "cancel") == 0) {
+        unsigned long id = 0;
+        if (argc != 2 || sscanf(sclsh_value_as_string(argv[1]).string, "after#%lu", &id) != 1) {
+            fprintf(stderr, "Usage: after cancel <id>\n");
+            return NULL;
+        }
+        sclsh_event_cancel(interp->events, id);  // Unknown ids are ignored
+        return sclsh_value_empty();
+    }
+
+    char* end;
+    long delay = strcmp(first, "idle") == 0 ? 0 : strtol(first, &end, 10);
+    if (strcmp(first, "idle") != 0 && (*end != '\0' || end == first)) {
+        fprintf(stderr, "Invalid delay '%s'\n", first);
+        return NULL;
+    }
+
+    if (argc == 1) {
+        // Plain sleep, no events are processed meanwhile
+        sclsh_output_flush(sclsh_interpreter_output(interp));
+        struct timespec ts = { .tv_sec = delay / 1000, .tv_nsec = (delay % 1000) * 1000000 };
+        while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+        }
+        return sclsh_value_empty();
+    }
+
+    SclshEventLoop* loop = sclsh_interpreter_event_loop(interp);
+    if (!loop) {
+        return NULL;
+    }
+    unsigned long id = sclsh_event_after(
+        loop, delay, run_script, sclsh_value_ref(argv[1]), release_script
+    );
+    if (!id) {
+        sclsh_value_unref(argv[1]);
+        return NULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "after#%lu", id);
+    return sclsh_value_from_cstr(name);
+}
+
+static SclshValue* cmd_fileevent(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 3) {
+        fprintf(stderr, "Usage: fileevent <channel> readable|writable <script>\n");
+        return NULL;
+    }
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    char* name = sclsh_value_as_string(argv[0]).string;
+    SclshChannel* chan = sclsh_interpreter_channel(interp, name);
+    if (!chan) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+        return NULL;
+    }
+    char* kind_name = sclsh_value_as_string(argv[1]).string;
+    SclshEventKind kind;
+    if (strcmp(kind_name, "readable") == 0) {
+        kind = SCLSH_EVENT_READABLE;
+    } else if (strcmp(kind_name, "writable") == 0) {
+        kind = SCLSH_EVENT_WRITABLE;
+    } else {
+        fprintf(stderr, "Invalid event '%s'\n", kind_name);
+        return NULL;
+    }
+    SclshEventLoop* loop = sclsh_interpreter_event_loop(interp);
+    if (!loop) {
+        return NULL;
+    }
+
+    int ok;
+    if (sclsh_value_as_bytes(argv[2]).length == 0) {
+        ok = sclsh_event_watch_channel(loop, chan, kind, NULL, NULL, NULL);
+    } else {
+        ok = sclsh_event_watch_channel(
+            loop, chan, kind, run_script, sclsh_value_ref(argv[2]), release_script
+        );
+        if (!ok) {
+            sclsh_value_unref(argv[2]);
+        }
+    }
+    return ok ? sclsh_value_empty() : NULL;
+}
+
+static SclshValue* cmd_vwait(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1) {
+        fprintf(stderr, "Usage: vwait <variable>\n");
+        return NULL;
+    }
+    SclshEventLoop* loop = sclsh_interpreter_event_loop(sclsh_context_interpreter(ctx));
+    if (!loop) {
+        return NULL;
+    }
+
+    VariableWait wait = {
+        .name = sclsh_value_as_string(argv[0]).string,
+        .written = false,
+        .outer = loop->waits,
+    };
+    loop->waits = &wait;
+    bool ok = true;
+    while (!wait.written) {
+        if (!sclsh_event_loop_has_handlers(loop)) {
+            fprintf(stderr, "vwait: no event handlers left, would wait forever\n");
+            ok = false;
+            break;
+        }
+        if (sclsh_event_loop_run_once(loop, -1) < 0) {
+            ok = false;
+            break;
+        }
+    }
+    loop->waits = wait.outer;
+    return ok ? sclsh_value_empty() : NULL;
+}
+
+static SclshValue* cmd_update(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)argv; (void)user_data; // Suppress unused parameter warnings
+    if (argc != 0) {
+        fprintf(stderr, "Usage: update\n");
+        return NULL;
+    }
+    SclshEventLoop* loop = sclsh_context_interpreter(ctx)->events;
+    while (loop && sclsh_event_loop_run_once(loop, 0) > 0) {
+    }
+    return sclsh_value_empty();
+}
+
+static SclshValue* cmd_fconfigure(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 3 || strcmp(sclsh_value_as_string(argv[1]).string, "-blocking") != 0) {
+        fprintf(stderr, "Usage: fconfigure <channel> -blocking <bool>\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    SclshChannel* chan = sclsh_interpreter_channel(sclsh_context_interpreter(ctx), name);
+    if (!chan) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+        return NULL;
+    }
+    if (!sclsh_channel_set_blocking(chan, atoi(sclsh_value_as_string(argv[2]).string) != 0)) {
+        return NULL;
+    }
+    return sclsh_value_empty();
+}
+
+static SclshValue* cmd_fblocked(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1) {
+        fprintf(stderr, "Usage: fblocked <channel>\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    SclshChannel* chan = sclsh_interpreter_channel(sclsh_context_interpreter(ctx), name);
+    if (!chan) {
+        fprintf(stderr, "Unknown channel '%s'\n", name);
+        return NULL;
+    }
+    return sclsh_value_new(sclsh_channel_blocked(chan) ? "1" : "0", 1);
+}
+
+void sclsh_register_event_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "after", cmd_after, NULL, NULL);
+    sclsh_command_new(interp, "fileevent", cmd_fileevent, NULL, NULL);
+    sclsh_command_new(interp, "vwait", cmd_vwait, NULL, NULL);
+    sclsh_command_new(interp, "update", cmd_update, NULL, NULL);
+    sclsh_command_new(interp, "fconfigure", cmd_fconfigure, NULL, NULL);
+    sclsh_command_new(interp, "fblocked", cmd_fblocked, NULL, NULL);
+}
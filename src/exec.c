@@ -0,0 +1,697 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/exec.h>
+#include <sclsh/util.h>
+#include <sclsh/vm.h>
+#include "value.h"
+#include "interp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+struct SclshPathCache_s {
+    char* path;  // Value of PATH the entries were resolved against
+    SclshHashMap* entries;  // Command name -> absolute path
+};
+
+static void free_entry(const char* key, void* value, void* user_data) {
+    (void)key; (void)user_data;
+    free(value);
+}
+
+void sclsh_path_cache_free(SclshPathCache* cache) {
+    if (!cache) {
+        return;
+    }
+    sclsh_hash_map_for_each(cache->entries, free_entry, NULL);
+    sclsh_hash_map_free(cache->entries);
+    free(cache->path);
+    free(cache);
+}
+
+static void path_cache_forget(SclshPathCache* cache, const char* name) {
+    char* entry = sclsh_hash_map_get(cache->entries, name);
+    if (entry) {
+        sclsh_hash_map_remove(cache->entries, name);
+        free(entry);
+    }
+}
+
+static char* search_path(const char* path, const char* name) {
+    size_t name_length = strlen(name);
+    const char* dir = path;
+    for (;;) {
+        const char* end = strchr(dir, ':');
+        size_t dir_length = end ? (size_t)(end - dir) : strlen(dir);
+
+        char* candidate = malloc(dir_length + name_length + 3);
+        if (!candidate) {
+            return NULL;
+        }
+        if (dir_length == 0) {
+            candidate[0] = '.';  // Empty PATH element means the current directory
+            dir_length = 1;
+        } else {
+            memcpy(candidate, dir, dir_length);
+        }
+        candidate[dir_length] = '/';
+        memcpy(candidate + dir_length + 1, name, name_length + 1);
+
+        struct stat st;
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+        free(candidate);
+
+        if (!end) {
+            return NULL;
+        }
+        dir = end + 1;
+    }
+}
+
+const char* sclsh_exec_resolve(SclshInterpreter* interp, const char* name) {
+    if (!interp || !name || !*name) {
+        return NULL;
+    }
+    if (strchr(name, '/')) {
+        return name;
+    }
+
+    const char* path = getenv("PATH");
+    if (!path) {
+        path = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    SclshPathCache* cache = interp->path_cache;
+    if (!cache) {
+        cache = malloc(sizeof(SclshPathCache));
+        if (!cache) {
+            return NULL;
+        }
+        cache->path = NULL;
+        cache->entries = sclsh_hash_map_new();
+        interp->path_cache = cache;
+    }
+    // Any change to PATH invalidates every entry
+    if (!cache->path || strcmp(cache->path, path) != 0) {
+        sclsh_hash_map_for_each(cache->entries, free_entry, NULL);
+        sclsh_hash_map_free(cache->entries);
+        cache->entries = sclsh_hash_map_new();
+        free(cache->path);
+        cache->path = strdup(path);
+    }
+
+    char* resolved = sclsh_hash_map_get(cache->entries, name);
+    if (!resolved) {
+        resolved = search_path(path, name);
+        if (resolved) {
+            sclsh_hash_map_set(cache->entries, name, resolved);
+        }
+    }
+    return resolved;
+}
+
+typedef enum {
+    REDIRECT_IN,
+    REDIRECT_OUT,
+    REDIRECT_APPEND,
+    REDIRECT_ERR,
+    REDIRECT_ERR_APPEND,
+    REDIRECT_ERR_TO_OUT,
+} RedirectKind;
+
+static const struct {
+    const char* op;
+    RedirectKind kind;
+} redirect_ops[] = {
+    { "<", REDIRECT_IN },
+    { ">", REDIRECT_OUT },
+    { ">>", REDIRECT_APPEND },
+    { "2>", REDIRECT_ERR },
+    { "2>>", REDIRECT_ERR_APPEND },
+    { "2>&1", REDIRECT_ERR_TO_OUT },
+};
+
+typedef struct Redirection_s {
+    RedirectKind kind;
+    SclshValue* target;  // NULL for 2>&1
+} Redirection;
+
+typedef struct Stage_s {
+    size_t argc;
+    SclshValue** argv;  // argv[0] is the command name
+    size_t redirection_count;
+    Redirection* redirections;
+    SclshCommand* builtin;
+    const char* path;
+    int fds[3];  // Descriptors for stdin/stdout/stderr, -1 to inherit
+    pid_t pid;
+} Stage;
+
+// Only bare words act as operators, so `{|}` or `"|"` stay literal
+static int node_is(SclshNode* node, const char* op) {
+    return node->type == SCLSH_WORD_BARE
+        && node->value->length == strlen(op)
+        && memcmp(node->value->string, op, node->value->length) == 0;
+}
+
+static int redirect_kind(SclshNode* node) {
+    for (size_t i = 0; i < sizeof(redirect_ops) / sizeof(redirect_ops[0]); i++) {
+        if (node_is(node, redirect_ops[i].op)) {
+            return (int)redirect_ops[i].kind;
+        }
+    }
+    return -1;
+}
+
+int sclsh_exec_is_pipeline(SclshNodeList* command_line) {
+    if (!command_line) {
+        return 0;
+    }
+    for (size_t i = 0; i < command_line->count; i++) {
+        SclshNode* node = &command_line->nodes[i];
+        if (node_is(node, "|") || redirect_kind(node) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void free_stages(Stage* stages, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < stages[i].argc; j++) {
+            sclsh_value_unref(stages[i].argv[j]);
+        }
+        for (size_t j = 0; j < stages[i].redirection_count; j++) {
+            sclsh_value_unref(stages[i].redirections[j].target);
+        }
+        free(stages[i].argv);
+        free(stages[i].redirections);
+    }
+    free(stages);
+}
+
+// Splits a command line at `|` and evaluates the words of every stage
+static Stage* build_stages(SclshContext* ctx, SclshNodeList* command_line, size_t* stage_count) {
+    size_t count = 1;
+    for (size_t i = 0; i < command_line->count; i++) {
+        if (node_is(&command_line->nodes[i], "|")) {
+            count++;
+        }
+    }
+    Stage* stages = calloc(count, sizeof(Stage));
+    if (!stages) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        stages[i].argv = malloc(sizeof(SclshValue*) * (command_line->count + 1));
+        stages[i].redirections = malloc(sizeof(Redirection) * command_line->count);
+        stages[i].pid = -1;
+    }
+
+    size_t current = 0;
+    for (size_t i = 0; i < command_line->count; i++) {
+        SclshNode* node = &command_line->nodes[i];
+        Stage* stage = &stages[current];
+        int kind = redirect_kind(node);
+
+        if (node_is(node, "|")) {
+            current++;
+            continue;
+        }
+        if (kind >= 0) {
+            Redirection* redirection = &stage->redirections[stage->redirection_count];
+            redirection->kind = (RedirectKind)kind;
+            redirection->target = NULL;
+            if (kind != REDIRECT_ERR_TO_OUT) {
+                if (i + 1 >= command_line->count) {
+                    fprintf(stderr, "Missing file name after '%s'\n", node->value->string);
+                    free_stages(stages, count);
+                    return NULL;
+                }
+                redirection->target = sclsh_eval_word(ctx, &command_line->nodes[++i]);
+                if (!redirection->target) {
+                    free_stages(stages, count);
+                    return NULL;
+                }
+            }
+            stage->redirection_count++;
+            continue;
+        }
+
+        SclshValue* word = sclsh_eval_word(ctx, node);
+        if (!word) {
+            free_stages(stages, count);
+            return NULL;
+        }
+        stage->argv[stage->argc++] = word;
+    }
+
+    // A stage of nothing but redirections copies its input to its output
+    for (size_t i = 0; i < count; i++) {
+        if (stages[i].argc == 0 && stages[i].redirection_count == 0) {
+            fprintf(stderr, "Empty command in pipeline\n");
+            free_stages(stages, count);
+            return NULL;
+        }
+    }
+
+    *stage_count = count;
+    return stages;
+}
+
+// Opens the files named by a stage's redirections, in order, on top of
+// the descriptors it got from the pipeline. Opened descriptors are added
+// to opened so they can be closed once the stage has started.
+static int apply_redirections(Stage* stage, int* opened, size_t* opened_count) {
+    for (size_t i = 0; i < stage->redirection_count; i++) {
+        Redirection* redirection = &stage->redirections[i];
+        if (redirection->kind == REDIRECT_ERR_TO_OUT) {
+            stage->fds[2] = stage->fds[1] >= 0 ? stage->fds[1] : STDOUT_FILENO;
+            continue;
+        }
+
+        int flags = O_CLOEXEC;
+        int target = 1;
+        switch (redirection->kind) {
+            case REDIRECT_IN: flags |= O_RDONLY; target = 0; break;
+            case REDIRECT_OUT: flags |= O_WRONLY | O_CREAT | O_TRUNC; target = 1; break;
+            case REDIRECT_APPEND: flags |= O_WRONLY | O_CREAT | O_APPEND; target = 1; break;
+            case REDIRECT_ERR: flags |= O_WRONLY | O_CREAT | O_TRUNC; target = 2; break;
+            case REDIRECT_ERR_APPEND: flags |= O_WRONLY | O_CREAT | O_APPEND; target = 2; break;
+            default: break;
+        }
+        char* path = sclsh_value_as_string(redirection->target).string;
+        int fd = open(path, flags, 0666);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot open '%s': %s\n", path, strerror(errno));
+            return 0;
+        }
+        opened[(*opened_count)++] = fd;
+        stage->fds[target] = fd;
+    }
+    return 1;
+}
+
+static int spawn_stage(SclshInterpreter* interp, Stage* stage) {
+    char** argv = malloc(sizeof(char*) * (stage->argc + 1));
+    if (!argv) {
+        return 0;
+    }
+    for (size_t i = 0; i < stage->argc; i++) {
+        argv[i] = sclsh_value_as_string(stage->argv[i]).string;
+    }
+    argv[stage->argc] = NULL;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int fd = 0; fd < 3; fd++) {
+        if (stage->fds[fd] >= 0 && stage->fds[fd] != fd) {
+            posix_spawn_file_actions_adddup2(&actions, stage->fds[fd], fd);
+        }
+    }
+
+    // The shell ignores SIGPIPE while builtins write into pipes; children
+    // must get the default behaviour back
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    int res = posix_spawn(&stage->pid, stage->path, &actions, &attr, argv, environ);
+    if (res == ENOENT && interp->path_cache && stage->path != argv[0]) {
+        // The executable moved since it was cached; look it up again
+        path_cache_forget(interp->path_cache, argv[0]);
+        stage->path = sclsh_exec_resolve(interp, argv[0]);
+        if (stage->path) {
+            res = posix_spawn(&stage->pid, stage->path, &actions, &attr, argv, environ);
+        }
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (res != 0) {
+        fprintf(stderr, "Cannot execute '%s': %s\n", argv[0], strerror(res));
+        stage->pid = -1;
+    }
+    free(argv);
+    return res == 0;
+}
+
+#define COPY_CHUNK (1 << 20)
+
+// copy_file_range, sendfile and splice each refuse some descriptor
+// combinations; these errors mean "try the next method"
+static int copy_unsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV || err == EBADF
+        || err == EOPNOTSUPP || err == ESPIPE;
+}
+
+ssize_t sclsh_copy_fd(int in_fd, int out_fd) {
+    ssize_t total = 0;
+    ssize_t res;
+
+    // Between regular files the kernel can share extents or copy in place
+    while ((res = copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0)) > 0) {
+        total += res;
+    }
+    if (res == 0) {
+        return total;
+    }
+    if (!copy_unsupported(errno)) {
+        return -1;
+    }
+
+    // Input that can be mapped (files, memfds) goes straight to any output
+    while ((res = sendfile(out_fd, in_fd, NULL, COPY_CHUNK)) > 0) {
+        total += res;
+    }
+    if (res == 0) {
+        return total;
+    }
+    if (!copy_unsupported(errno)) {
+        return -1;
+    }
+
+    // Pipe on either end: move pages through the pipe buffer
+    while ((res = splice(in_fd, NULL, out_fd, NULL, COPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0) {
+        total += res;
+    }
+    if (res == 0) {
+        return total;
+    }
+    if (!copy_unsupported(errno)) {
+        return -1;
+    }
+
+    char* buffer = malloc(COPY_CHUNK);
+    if (!buffer) {
+        return -1;
+    }
+    while ((res = read(in_fd, buffer, COPY_CHUNK)) > 0) {
+        ssize_t written = 0;
+        while (written < res) {
+            ssize_t n = write(out_fd, buffer + written, res - written);
+            if (n < 0) {
+                free(buffer);
+                return -1;
+            }
+            written += n;
+        }
+        total += res;
+    }
+    free(buffer);
+    return res < 0 ? -1 : total;
+}
+
+static SclshValue* run_copy_stage(Stage* stage, SclshOutput* interp_output) {
+    // Like other shells, `> file` on its own only creates the file
+    if (stage->fds[0] < 0) {
+        return sclsh_value_zero();
+    }
+    int out_fd = stage->fds[1] >= 0 ? stage->fds[1] : STDOUT_FILENO;
+    fflush(stdout);
+    sclsh_output_flush(interp_output);
+    ssize_t copied = sclsh_copy_fd(stage->fds[0], out_fd);
+    if (copied < 0 && errno != EPIPE) {
+        fprintf(stderr, "Copy failed: %s\n", strerror(errno));
+        return NULL;
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%zd", copied < 0 ? 0 : copied);
+    return sclsh_value_from_cstr(buffer);
+}
+
+static SclshValue* run_builtin_stage(SclshContext* ctx, Stage* stage) {
+    int saved[3] = { -1, -1, -1 };
+
+    // The interpreter's output may not be a descriptor at all (embedders
+    // capture it), so a redirected builtin gets an output of its own
+    SclshOutput* stage_output = NULL;
+    SclshOutput* previous_output = NULL;
+    if (stage->fds[1] >= 0) {
+        stage_output = sclsh_output_new_fd(stage->fds[1]);
+        previous_output = sclsh_interpreter_set_output(ctx->interp, stage_output);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int fd = 0; fd < 3; fd++) {
+        if (stage->fds[fd] >= 0 && stage->fds[fd] != fd) {
+            saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+            dup2(stage->fds[fd], fd);
+        }
+    }
+
+    SclshValue* result = sclsh_command_invoke(ctx, stage->builtin, stage->argc - 1, stage->argv + 1);
+
+    if (stage_output) {
+        sclsh_interpreter_set_output(ctx->interp, previous_output);
+        sclsh_output_free(stage_output);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    for (int fd = 0; fd < 3; fd++) {
+        if (saved[fd] >= 0) {
+            dup2(saved[fd], fd);
+            close(saved[fd]);
+        }
+    }
+    return result;
+}
+
+static int wait_stage(Stage* stage) {
+    int status;
+    while (waitpid(stage->pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return 127;
+        }
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+static int in_process(Stage* stage) {
+    return stage->builtin || stage->argc == 0;
+}
+
+// Descriptors opened for a pipeline are tracked so that each is closed
+// exactly once, as soon as the stages using it no longer need it
+typedef struct OpenFds_s {
+    int* fds;
+    size_t count;
+} OpenFds;
+
+static void close_tracked(OpenFds* open_fds, int fd) {
+    for (size_t i = 0; i < open_fds->count; i++) {
+        if (open_fds->fds[i] == fd) {
+            close(fd);
+            open_fds->fds[i] = -1;
+        }
+    }
+}
+
+static void close_stage_fds(OpenFds* open_fds, Stage* stage, int keep_output) {
+    close_tracked(open_fds, stage->fds[0]);
+    if (!keep_output) {
+        close_tracked(open_fds, stage->fds[1]);
+    }
+    if (stage->fds[2] != stage->fds[1]) {
+        close_tracked(open_fds, stage->fds[2]);
+    }
+}
+
+// Runs stages whose words have been evaluated already and frees them
+static SclshValue* run_stages(SclshContext* ctx, Stage* stages, size_t count) {
+    SclshInterpreter* interp = ctx->interp;
+    size_t redirection_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        stages[i].fds[0] = stages[i].fds[1] = stages[i].fds[2] = -1;
+        redirection_count += stages[i].redirection_count;
+        if (stages[i].argc == 0) {
+            continue;
+        }
+        SclshStringBuffer name_bytes = sclsh_value_as_bytes(stages[i].argv[0]);
+        char* name = name_bytes.string;
+        stages[i].builtin = sclsh_get_command_buffer(interp, name_bytes);
+        if (!stages[i].builtin) {
+            // No program has a null byte in its name
+            stages[i].path = strlen(name) == name_bytes.length ? sclsh_exec_resolve(interp, name) : NULL;
+            if (!stages[i].path) {
+                fprintf(stderr, "Command '%s' not found\n", name);
+                free_stages(stages, count);
+                return NULL;
+            }
+        }
+    }
+
+    // Every descriptor the shell opens for the pipeline is close-on-exec;
+    // children only see what is dup'ed onto their standard streams
+    OpenFds open_fds = {
+        .fds = malloc(sizeof(int) * (2 * count + redirection_count)),
+        .count = 0,
+    };
+    int ok = 1;
+
+    // An external reader drains a pipe while its writer runs. In-process
+    // stages run one after another, so one only reads its input once
+    // everything before it has finished: whatever writes to it, builtin or
+    // program, writes to a memfd instead, which cannot fill up. The memfd
+    // is rewound and handed to the reader as its input.
+    for (size_t i = 0; i + 1 < count && ok; i++) {
+        int read_fd, write_fd;
+        if (in_process(&stages[i + 1])) {
+            read_fd = write_fd = memfd_create("sclsh-stage", MFD_CLOEXEC);
+            if (read_fd < 0) {
+                fprintf(stderr, "Cannot create stage buffer: %s\n", strerror(errno));
+                ok = 0;
+                break;
+            }
+            open_fds.fds[open_fds.count++] = read_fd;
+        } else {
+            int pipe_fds[2];
+            if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+                fprintf(stderr, "Cannot create pipe: %s\n", strerror(errno));
+                ok = 0;
+                break;
+            }
+            read_fd = pipe_fds[0];
+            write_fd = pipe_fds[1];
+            open_fds.fds[open_fds.count++] = read_fd;
+            open_fds.fds[open_fds.count++] = write_fd;
+        }
+        stages[i].fds[1] = write_fd;
+        stages[i + 1].fds[0] = read_fd;
+    }
+
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = apply_redirections(&stages[i], open_fds.fds, &open_fds.count);
+    }
+
+    // External stages start first so they are already draining their
+    // pipes by the time in-process stages write into them. The shell's
+    // copies of their descriptors are closed right away so that readers
+    // see end of input when the writer exits.
+    sclsh_output_flush(interp->output);
+    for (size_t i = 0; i < count && ok; i++) {
+        if (!in_process(&stages[i])) {
+            ok = spawn_stage(interp, &stages[i]);
+            close_stage_fds(&open_fds, &stages[i], i + 1 < count && in_process(&stages[i + 1]));
+        }
+    }
+
+    SclshValue* result = NULL;
+    int status = 0;
+    if (ok) {
+        struct sigaction ignore = { .sa_handler = SIG_IGN };
+        struct sigaction previous;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGPIPE, &ignore, &previous);
+        for (size_t i = 0; i < count; i++) {
+            if (!in_process(&stages[i])) {
+                continue;
+            }
+            if (i > 0 && !in_process(&stages[i - 1])) {
+                // The program writing this stage's input has to be done
+                // with it first
+                status = wait_stage(&stages[i - 1]);
+                stages[i - 1].pid = -1;
+                lseek(stages[i].fds[0], 0, SEEK_SET);
+            }
+            sclsh_value_unref(result);
+            if (stages[i].builtin) {
+                result = run_builtin_stage(ctx, &stages[i]);
+            } else {
+                result = run_copy_stage(&stages[i], interp->output);
+            }
+
+            int hand_over = i + 1 < count && in_process(&stages[i + 1]);
+            if (hand_over) {
+                lseek(stages[i].fds[1], 0, SEEK_SET);
+            }
+            close_stage_fds(&open_fds, &stages[i], hand_over);
+        }
+        sigaction(SIGPIPE, &previous, NULL);
+    }
+
+    for (size_t i = 0; i < open_fds.count; i++) {
+        if (open_fds.fds[i] >= 0) {
+            close(open_fds.fds[i]);
+        }
+    }
+    free(open_fds.fds);
+
+    for (size_t i = 0; i < count; i++) {
+        if (stages[i].pid > 0) {
+            status = wait_stage(&stages[i]);
+        }
+    }
+
+    if (ok && !in_process(&stages[count - 1])) {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%d", status);
+        sclsh_value_unref(result);
+        result = sclsh_value_from_cstr(buffer);
+    } else if (!ok) {
+        sclsh_value_unref(result);
+        result = NULL;
+    }
+
+    free_stages(stages, count);
+    return result;
+}
+
+SclshValue* sclsh_exec_command_line(SclshContext* ctx, SclshNodeList* command_line) {
+    if (!ctx || !command_line || command_line->count == 0) {
+        return NULL;
+    }
+
+    size_t count;
+    Stage* stages = build_stages(ctx, command_line, &count);
+    if (!stages) {
+        return NULL;
+    }
+    return run_stages(ctx, stages, count);
+}
+
+SclshValue* sclsh_exec_words(SclshContext* ctx, size_t argc, SclshValue** argv) {
+    if (!ctx || argc == 0) {
+        return NULL;
+    }
+
+    Stage* stage = calloc(1, sizeof(Stage));
+    if (!stage) {
+        return NULL;
+    }
+    stage->argv = malloc(sizeof(SclshValue*) * (argc + 1));
+    if (!stage->argv) {
+        free(stage);
+        return NULL;
+    }
+    for (size_t i = 0; i < argc; i++) {
+        stage->argv[i] = sclsh_value_ref(argv[i]);
+    }
+    stage->argc = argc;
+    stage->pid = -1;
+    return run_stages(ctx, stage, 1);
+}
@@ -15,20 +15,22 @@ static double value_to_double(SclshContext* ctx, SclshValue* value) {
     return str_buf.length > 0 ? atof(str_buf.string) : 0.0;
 }
 
-double sclsh_expr_eval_double(SclshContext* ctx, SclshValue* expr) {
-    SclshValueList *list = sclsh_value_as_list(expr);
-    if (!list || list->count == 0) {
-        return 0.0; // Empty or invalid expression
+// Evaluates the words of an expression; *boolean tells whether the last
+// operator was a comparison
+static double eval_words(SclshContext* ctx, size_t count, SclshValue** words, bool* boolean) {
+    *boolean = false;
+    if (count == 0) {
+        return 0.0; // Empty expression
     }
-    double result = value_to_double(ctx, list->items[0]);
-    for (size_t i = 1; i < list->count; i += 2) {
-        char* op = sclsh_value_as_string(list->items[i]).string;
-        if (i + 1 >= list->count) {
+    double result = value_to_double(ctx, words[0]);
+    for (size_t i = 1; i < count; i += 2) {
+        char* op = sclsh_value_as_string(words[i]).string;
+        if (i + 1 >= count) {
             fprintf(stderr, "Invalid expression: missing operand after operator '%s'\n", op);
             return 0.0; // Invalid expression
         }
-        double next_value = value_to_double(ctx, list->items[i + 1]);
-        puts(op);
+        double next_value = value_to_double(ctx, words[i + 1]);
+        *boolean = op[0] == '<' || op[0] == '>' || (op[0] != '\0' && op[1] == '=');
         if (strcmp(op, "+") == 0) {
             result += next_value;
         } else if (strcmp(op, "-") == 0) {
@@ -68,12 +70,33 @@ double sclsh_expr_eval_double(SclshContext* ctx, SclshValue* expr) {
     }
     return result;
 }
+
+// Empty or invalid expressions count as empty lists
+static SclshValueList* expr_words(SclshValue* expr) {
+    static SclshValueList empty = { .count = 0 };
+    SclshValueList* list = sclsh_value_as_list(expr);
+    return list ? list : &empty;
+}
+
+double sclsh_expr_eval_double(SclshContext* ctx, SclshValue* expr) {
+    SclshValueList* list = expr_words(expr);
+    bool boolean;
+    return eval_words(ctx, list->count, list->items, &boolean);
+}
 int sclsh_expr_eval_bool(SclshContext* ctx, SclshValue* expr) {
     return sclsh_expr_eval_double(ctx, expr) != 0.0;
 }
-SclshValue* sclsh_expr_eval(SclshContext* ctx, SclshValue* expr) {
-    double result = sclsh_expr_eval_double(ctx, expr);
+SclshValue* sclsh_expr_eval_words(SclshContext* ctx, size_t count, SclshValue** words) {
+    bool boolean;
+    double result = eval_words(ctx, count, words, &boolean);
+    if (boolean) {
+        return sclsh_value_boolean(result != 0.0);  // Shared, no allocation
+    }
     char buffer[32];
     snprintf(buffer, sizeof(buffer), "%f", result);
     return sclsh_value_new(buffer, strlen(buffer));
 }
+SclshValue* sclsh_expr_eval(SclshContext* ctx, SclshValue* expr) {
+    SclshValueList* list = expr_words(expr);
+    return sclsh_expr_eval_words(ctx, list->count, list->items);
+}
@@ -0,0 +1,253 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/glob.h>
+#include "value.h"
+#include "stats.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A pattern is a sequence of atoms, each either a star or a set of bytes
+ * matching one byte. The automaton has a state for every atom, meaning
+ * that the atoms before it have matched, plus a final accepting state.
+ * All states are tracked at once as bits (shift-and): on each byte the
+ * states whose atom is a set containing the byte advance, star states
+ * stay, and a star state also stands for the state after it since a
+ * star may match nothing. Runs of stars are collapsed when compiling so
+ * that this needs a single step.
+ */
+struct SclshGlob_s {
+    size_t atoms;
+    size_t words;  // 64-bit words of a state set, atoms + 1 bits
+    bool literal;  // No wildcards: the bytes are compared as they are
+    bool trailing_star;  // Once the last atom is reached anything matches
+    size_t length;  // Of a literal pattern
+    // A literal pattern keeps its bytes here. Otherwise: the set of star
+    // atoms, then for each byte value the set of atoms matching it.
+    uint64_t sets[];
+};
+
+static void add_state(uint64_t* set, size_t state) {
+    set[state / 64] |= (uint64_t)1 << (state % 64);
+}
+
+static bool has_state(const uint64_t* set, size_t state) {
+    return (set[state / 64] >> (state % 64)) & 1;
+}
+
+static bool is_literal(SclshStringBuffer pattern) {
+    for (size_t i = 0; i < pattern.length; i++) {
+        char ch = pattern.string[i];
+        if (ch == '*' || ch == '?' || ch == '[' || ch == '\\') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds the atom at *pos to glob, if not NULL, as atom number atom.
+// Returns false for a star following another.
+static bool compile_atom(SclshStringBuffer pattern, size_t* pos, SclshGlob* glob, size_t atom, bool after_star) {
+    const char* p = pattern.string;
+    size_t length = pattern.length;
+    uint64_t* star = glob ? glob->sets : NULL;
+    uint64_t* bytes = glob ? glob->sets + glob->words : NULL;
+    size_t words = glob ? glob->words : 0;
+
+    char ch = p[*pos];
+    if (ch == '*') {
+        (*pos)++;
+        if (after_star) {
+            return false;
+        }
+        if (glob) {
+            add_state(star, atom);
+        }
+        return true;
+    }
+    if (ch == '[') {
+        // The set runs to the next unescaped ], without one [ is literal
+        size_t end = *pos + 1;
+        while (end < length && p[end] != ']') {
+            end += p[end] == '\\' && end + 1 < length ? 2 : 1;
+        }
+        if (end < length) {
+            size_t i = *pos + 1;
+            while (i < end) {
+                if (p[i] == '\\' && i + 1 < end) {
+                    i++;
+                }
+                unsigned char first = (unsigned char)p[i++];
+                unsigned char last = first;
+                if (i + 1 < end && p[i] == '-') {
+                    i++;
+                    if (p[i] == '\\' && i + 1 < end) {
+                        i++;
+                    }
+                    last = (unsigned char)p[i++];
+                    if (last < first) {
+                        unsigned char swap = first;
+                        first = last;
+                        last = swap;
+                    }
+                }
+                for (unsigned int c = first; glob && c <= last; c++) {
+                    add_state(bytes + c * words, atom);
+                }
+            }
+            *pos = end + 1;
+            return true;
+        }
+    }
+    if (ch == '?') {
+        for (unsigned int c = 0; glob && c < 256; c++) {
+            add_state(bytes + c * words, atom);
+        }
+        (*pos)++;
+        return true;
+    }
+    if (ch == '\\' && *pos + 1 < length) {
+        (*pos)++;
+    }
+    if (glob) {
+        add_state(bytes + (unsigned char)p[*pos] * words, atom);
+    }
+    (*pos)++;
+    return true;
+}
+
+// Walks the atoms of pattern, adding them to glob if not NULL, and
+// returns how many there are
+static size_t compile_atoms(SclshStringBuffer pattern, SclshGlob* glob) {
+    size_t atoms = 0;
+    size_t pos = 0;
+    bool after_star = false;
+    while (pos < pattern.length) {
+        bool star = pattern.string[pos] == '*';
+        if (compile_atom(pattern, &pos, glob, atoms, after_star)) {
+            atoms++;
+        }
+        after_star = star;
+    }
+    return atoms;
+}
+
+static SclshGlob* glob_compile(SclshStringBuffer pattern) {
+    SclshGlob* glob;
+    if (is_literal(pattern)) {
+        glob = calloc(1, sizeof(SclshGlob) + pattern.length + 1);
+        if (!glob) {
+            return NULL;
+        }
+        glob->literal = true;
+        glob->length = pattern.length;
+        memcpy(glob->sets, pattern.string, pattern.length);
+        return glob;
+    }
+
+    size_t atoms = compile_atoms(pattern, NULL);
+    size_t words = atoms / 64 + 1;
+    glob = calloc(1, sizeof(SclshGlob) + 257 * words * sizeof(uint64_t));
+    if (!glob) {
+        return NULL;
+    }
+    glob->atoms = atoms;
+    glob->words = words;
+    compile_atoms(pattern, glob);
+    glob->trailing_star = atoms > 0 && has_state(glob->sets, atoms - 1);
+    return glob;
+}
+
+void sclsh_glob_free(SclshGlob* glob) {
+    free(glob);
+}
+
+static SclshGlob* value_as_glob(SclshValue* value) {
+    if (value->as_glob) {
+        SCLSH_STAT(glob.hits);
+    } else {
+        SCLSH_STAT(glob.conversions);
+        value->as_glob = glob_compile(sclsh_value_as_bytes(value));
+    }
+    return value->as_glob;
+}
+
+// States that a star reaches without consuming anything
+static uint64_t close_word(uint64_t state, uint64_t star) {
+    return state | ((state & star) << 1);
+}
+
+// Patterns of up to 63 atoms fit their states in one word
+static bool match_word(const SclshGlob* glob, const unsigned char* string, size_t length) {
+    uint64_t star = glob->sets[0];
+    const uint64_t* bytes = glob->sets + 1;
+    uint64_t last = glob->trailing_star ? (uint64_t)1 << (glob->atoms - 1) : 0;
+    uint64_t state = close_word(1, star);
+    for (size_t i = 0; i < length; i++) {
+        if (state & last) {
+            return true;
+        }
+        state = close_word(((state & bytes[string[i]]) << 1) | (state & star), star);
+        if (!state) {
+            return false;
+        }
+    }
+    return (state >> glob->atoms) & 1;
+}
+
+// Same as match_word with the states spread over several words
+static bool match_words(const SclshGlob* glob, const unsigned char* string, size_t length) {
+    size_t words = glob->words;
+    const uint64_t* star = glob->sets;
+    const uint64_t* bytes = glob->sets + words;
+    uint64_t* state = calloc(words, sizeof(uint64_t));
+    if (!state) {
+        return false;
+    }
+    state[0] = 1;
+    bool matched = false;
+    for (size_t i = 0;; i++) {
+        // Closure under stars, carrying bits from word to word
+        uint64_t carry = 0;
+        bool alive = false;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t stars = state[w] & star[w];
+            state[w] |= (stars << 1) | carry;
+            carry = stars >> 63;
+            alive = alive || state[w];
+        }
+        if (!alive) {
+            break;
+        }
+        if (i == length || (glob->trailing_star && has_state(state, glob->atoms - 1))) {
+            matched = i < length || has_state(state, glob->atoms);
+            break;
+        }
+        const uint64_t* matching = bytes + string[i] * words;
+        carry = 0;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t moved = state[w] & matching[w];
+            state[w] = (moved << 1) | carry | (state[w] & star[w]);
+            carry = moved >> 63;
+        }
+    }
+    free(state);
+    return matched;
+}
+
+bool sclsh_glob_match(SclshValue* pattern, SclshStringBuffer string) {
+    SclshGlob* glob = value_as_glob(pattern);
+    if (!glob) {
+        return false;
+    }
+    if (glob->literal) {
+        return string.length == glob->length && memcmp(string.string, glob->sets, glob->length) == 0;
+    }
+    if (glob->words == 1) {
+        return match_word(glob, (const unsigned char*)string.string, string.length);
+    }
+    return match_words(glob, (const unsigned char*)string.string, string.length);
+}
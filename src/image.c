@@ -0,0 +1,206 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/image.h>
+#include <sclsh/util.h>
+#include <sclsh/proc.h>
+#include "code.h"
+#include "serialize.h"
+#include "value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define IMAGE_MAGIC 0x494c4353u  // "SCLI"
+#define IMAGE_FORMAT_VERSION 5
+
+/* An image is a header followed by tagged sections, each holding a count
+ * and that many records, terminated by SECTION_END. Loaders skip nothing:
+ * an unknown tag means the image is from an incompatible build.
+ *
+ * Records hold strings only, names with their null terminator. A loaded
+ * image stays mapped for as long as any value read from it: names are
+ * used in place and longer values are slices of the mapping, so loading
+ * copies little and parses nothing. Reps are rebuilt when first used.
+ */
+typedef enum {
+    SECTION_END = 0,
+    SECTION_GLOBALS = 1,
+    SECTION_PROCS = 2,
+} ImageSection;
+
+typedef struct GlobalsWriter_s {
+    SclshStringBuilder* sb;
+    uint32_t count;
+} GlobalsWriter;
+
+static void count_global(const char* name, SclshValue* value, void* user_data) {
+    (void)name; (void)value;
+    ((GlobalsWriter*)user_data)->count++;
+}
+
+static void write_string(SclshStringBuilder* sb, SclshValue* value) {
+    SclshStringBuffer bytes = sclsh_value_as_bytes(value);
+    sclsh_serialize_bytes(sb, bytes.string, bytes.length);
+}
+
+static void write_global(const char* name, SclshValue* value, void* user_data) {
+    GlobalsWriter* writer = user_data;
+    sclsh_serialize_bytes(writer->sb, name, strlen(name) + 1);
+    write_string(writer->sb, value);
+}
+
+static void count_proc(const char* name, SclshValue* params, SclshValue* body, void* user_data) {
+    (void)name; (void)params; (void)body;
+    ((GlobalsWriter*)user_data)->count++;
+}
+
+static void write_proc(const char* name, SclshValue* params, SclshValue* body, void* user_data) {
+    GlobalsWriter* writer = user_data;
+    sclsh_serialize_bytes(writer->sb, name, strlen(name) + 1);
+    write_string(writer->sb, params);
+    write_string(writer->sb, body);
+}
+
+int sclsh_image_save(SclshInterpreter* interp, const char* path) {
+    if (!interp || !path) {
+        return 0;
+    }
+    SclshContext* globals = sclsh_global_context(interp);
+
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    sclsh_serialize_u32(sb, IMAGE_MAGIC);
+    sclsh_serialize_u32(sb, IMAGE_FORMAT_VERSION);
+    sclsh_serialize_bytes(sb, SCLSH_VERSION, strlen(SCLSH_VERSION));
+
+    GlobalsWriter writer = { .sb = sb, .count = 0 };
+    sclsh_context_for_each_variable(globals, count_global, &writer);
+    sclsh_serialize_u32(sb, SECTION_GLOBALS);
+    sclsh_serialize_u32(sb, writer.count);
+    sclsh_context_for_each_variable(globals, write_global, &writer);
+
+    // Procedures are compiled again when they are first called
+    GlobalsWriter procs = { .sb = sb, .count = 0 };
+    sclsh_for_each_proc(interp, count_proc, &procs);
+    sclsh_serialize_u32(sb, SECTION_PROCS);
+    sclsh_serialize_u32(sb, procs.count);
+    sclsh_for_each_proc(interp, write_proc, &procs);
+
+    sclsh_serialize_u32(sb, SECTION_END);
+
+    SclshStringBuffer contents = sclsh_string_builder_value(sb);
+    sclsh_string_builder_free(sb);
+    int ok = sclsh_write_file_atomic(path, contents);
+    free(contents.string);
+    if (!ok) {
+        fprintf(stderr, "Cannot write image '%s'\n", path);
+    }
+    return ok;
+}
+
+// A name with its null terminator, in place in the mapping
+static const char* read_name(SclshReader* reader) {
+    SclshStringBuffer name = sclsh_reader_bytes(reader);
+    if (!reader->error && (name.length == 0 || name.string[name.length - 1] != '\0')) {
+        reader->error = 1;
+    }
+    return reader->error ? NULL : name.string;
+}
+
+static void load_globals(SclshReader* reader, SclshContext* globals) {
+    uint32_t count = sclsh_reader_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->error; i++) {
+        const char* name = read_name(reader);
+        SclshValue* value = sclsh_reader_string(reader);
+        if (name && value) {
+            sclsh_context_set_variable(globals, name, value);
+        }
+        sclsh_value_unref(value);
+    }
+}
+
+static void load_procs(SclshReader* reader, SclshInterpreter* interp) {
+    uint32_t count = sclsh_reader_u32(reader);
+    for (uint32_t i = 0; i < count && !reader->error; i++) {
+        const char* name = read_name(reader);
+        SclshValue* params = sclsh_reader_string(reader);
+        SclshValue* body = sclsh_reader_string(reader);
+        if (name && params && body && !sclsh_proc_restore(interp, name, params, body)) {
+            reader->error = 1;
+        }
+        sclsh_value_unref(params);
+        sclsh_value_unref(body);
+    }
+}
+
+int sclsh_image_load(SclshInterpreter* interp, const char* path) {
+    if (!interp || !path) {
+        return 0;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open image '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        fprintf(stderr, "Cannot read image '%s'\n", path);
+        return 0;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map image '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+    SclshValue* mapping = sclsh_value_new_mapped(map, st.st_size);
+    if (!mapping) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    SclshReader reader = {
+        .pos = map,
+        .end = (const char*)map + st.st_size,
+        .error = 0,
+        .mapping = mapping,
+    };
+    uint32_t magic = sclsh_reader_u32(&reader);
+    uint32_t format = sclsh_reader_u32(&reader);
+    SclshStringBuffer version = sclsh_reader_bytes(&reader);
+
+    int ok = !reader.error
+        && magic == IMAGE_MAGIC
+        && format == IMAGE_FORMAT_VERSION
+        && version.length == strlen(SCLSH_VERSION)
+        && memcmp(version.string, SCLSH_VERSION, version.length) == 0;
+    if (!ok) {
+        fprintf(stderr, "'%s' is not an image for sclsh %s\n", path, SCLSH_VERSION);
+    } else {
+        uint32_t section;
+        while ((section = sclsh_reader_u32(&reader)) != SECTION_END && !reader.error) {
+            if (section == SECTION_GLOBALS) {
+                load_globals(&reader, sclsh_global_context(interp));
+            } else if (section == SECTION_PROCS) {
+                load_procs(&reader, interp);
+            } else {
+                reader.error = 1;
+            }
+        }
+        if (reader.error) {
+            fprintf(stderr, "Image '%s' is truncated or corrupt\n", path);
+            ok = 0;
+        }
+    }
+
+    sclsh_value_unref(mapping);  // Unmapped once no value uses it
+    return ok;
+}
@@ -0,0 +1,89 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__INTERNAL_INTERP
+#define H__SCLSH__INTERNAL_INTERP
+
+#include <sclsh/sclsh.h>
+#include <sclsh/ast.h>
+#include <sclsh/util.h>
+
+#include <sclsh/output.h>
+
+#include <stdint.h>
+
+typedef struct SclshPathCache_s SclshPathCache;
+typedef struct SclshChannelTable_s SclshChannelTable;
+typedef struct SclshEventLoop_s SclshEventLoop;
+typedef struct SclshExecution_s SclshExecution;
+typedef struct SclshProfile_s SclshProfile;
+typedef struct SclshSampler_s SclshSampler;
+
+struct SclshInterpreter_s {
+    SclshContext* global_context;
+    SclshHashMap* commands;
+    SclshPathCache* path_cache;  // Resolved external commands, see exec.c
+    SclshOutput* output;  // Standard output of scripts
+    SclshChannelTable* channels;  // Open file channels, see channel.c
+    SclshEventLoop* events;  // Created by the first event command, see event.c
+    SclshExecution* execution;  // Innermost active run of compiled code, see vm.c
+    SclshExecution* spare_executions;  // Released runs with their stacks
+    size_t spare_execution_count;
+    size_t recursion_limit;  // Maximum number of nested frames
+    SclshProfile* profile;  // Results of the last profile, see profile.c
+    SclshProfile* profiling;  // Same as profile while it is running, NULL otherwise
+    SclshSampler* sampler;  // Stacks sampled so far, see sample.c
+    SclshSampler* sampling;  // Same as sampler while the timer runs
+    bool instrumented;  // profiling or sampling is set, the one thing the dispatcher tests
+};
+
+struct SclshCommand_s {
+    char* name;  // Command name
+    SclshCommandFunc func;  // Function to execute the command
+    void* user_data;  // User data for the command
+    SclshUserDataDestructor* user_data_destructor;  // Destructor for user data
+    uint32_t sample_id;  // Name of the command in stack samples, 0 until first sampled
+};
+
+struct SclshContext_s {
+    SclshInterpreter* interp;  // Pointer to the interpreter
+    SclshHashMap* variables;  // Variables without a slot, created on demand in procedure calls
+    struct SclshProc_s* proc;  // Procedure whose locals live in slots, NULL otherwise
+    SclshValue** locals;  // One slot per local of proc, NULL while unset
+};
+
+void sclsh_path_cache_free(SclshPathCache* cache);
+void sclsh_channel_table_free(SclshChannelTable* table);
+void sclsh_event_loop_free(SclshEventLoop* loop);
+void sclsh_spare_executions_free(SclshInterpreter* interp);
+// Releases the variables of a context that is not freed by
+// sclsh_destroy_context, i.e. the context of a procedure call
+void sclsh_context_clear(SclshContext* ctx);
+// Wakes vwait when a global variable is set
+void sclsh_event_note_variable(SclshEventLoop* loop, const char* name);
+
+// Hooks of the dispatcher, called only while interp->profiling is set.
+// An invocation is entered before its command is called. One that pushed
+// a frame of run is pending until run has fewer than level frames, the
+// others complete as soon as the command returns.
+void sclsh_profile_enter(SclshProfile* profile, const char* name, const void* run);
+void sclsh_profile_pending(SclshProfile* profile, const void* run, size_t level);
+// Completes the invocations of run that wait for more than level frames
+void sclsh_profile_complete(SclshProfile* profile, const void* run, size_t level);
+void sclsh_profile_free(SclshProfile* profile);
+// The same for the stack of the sampling profiler, while interp->sampling
+// is set. command is NULL for programs.
+void sclsh_sampler_enter(SclshSampler* sampler, SclshCommand* command, const char* name, const void* run);
+void sclsh_sampler_pending(SclshSampler* sampler, const void* run, size_t level);
+void sclsh_sampler_complete(SclshSampler* sampler, const void* run, size_t level);
+void sclsh_sampler_free(SclshSampler* sampler);
+
+// Removes a command, running the destructor of its user data
+void sclsh_command_delete(SclshInterpreter* interp, const char* name);
+
+// Evaluates a single word of a command line, returning a new reference
+SclshValue* sclsh_eval_word(SclshContext* ctx, SclshNode* node);
+
+#endif
@@ -0,0 +1,217 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/output.h>
+#include <sclsh/util.h>
+#include "interp.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#define OUTPUT_MAX_IOV 64
+
+struct SclshOutput_s {
+    SclshOutputSink sink;
+    SclshOutputBuffering buffering;
+    char* buffer;
+    size_t length;
+    size_t capacity;
+};
+
+static ssize_t fd_write(void* user_data, const struct iovec* iov, int iovcnt) {
+    int fd = (int)(intptr_t)user_data;
+    for (;;) {
+        ssize_t res = writev(fd, iov, iovcnt);
+        if (res >= 0) {
+            return res;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+        // Non-blocking descriptor: output is never dropped, wait for room
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        poll(&pfd, 1, -1);
+    }
+}
+
+static ssize_t memory_write(void* user_data, const struct iovec* iov, int iovcnt) {
+    SclshStringBuilder* sb = user_data;
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        sclsh_string_builder_append_bytes(sb, iov[i].iov_base, iov[i].iov_len);
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+static void memory_free(void* user_data) {
+    sclsh_string_builder_free(user_data);
+}
+
+SclshOutput* sclsh_output_new_sink(SclshOutputSink sink, SclshOutputBuffering buffering) {
+    SclshOutput* out = malloc(sizeof(SclshOutput));
+    if (!out) return NULL;
+
+    out->buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (!out->buffer) {
+        free(out);
+        return NULL;
+    }
+    out->sink = sink;
+    out->buffering = buffering;
+    out->length = 0;
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    return out;
+}
+
+SclshOutput* sclsh_output_new_fd(int fd) {
+    SclshOutputSink sink = {
+        .write = fd_write,
+        .user_data = (void*)(intptr_t)fd,
+        .user_data_destructor = NULL,
+    };
+    return sclsh_output_new_sink(sink, isatty(fd) ? SCLSH_OUTPUT_LINE : SCLSH_OUTPUT_FULL);
+}
+
+SclshOutput* sclsh_output_new_memory(void) {
+    SclshOutputSink sink = {
+        .write = memory_write,
+        .user_data = sclsh_string_builder_new(),
+        .user_data_destructor = memory_free,
+    };
+    return sclsh_output_new_sink(sink, SCLSH_OUTPUT_FULL);
+}
+
+void sclsh_output_free(SclshOutput* out) {
+    if (!out) {
+        return;
+    }
+    sclsh_output_flush(out);
+    if (out->sink.user_data_destructor) {
+        out->sink.user_data_destructor(out->sink.user_data);
+    }
+    free(out->buffer);
+    free(out);
+}
+
+void sclsh_output_set_buffering(SclshOutput* out, SclshOutputBuffering buffering) {
+    if (!out) {
+        return;
+    }
+    out->buffering = buffering;
+    if (buffering != SCLSH_OUTPUT_FULL) {
+        sclsh_output_flush(out);
+    }
+}
+
+// Hands the whole vector to the sink, resuming after partial writes.
+// The vector is consumed in the process.
+static int write_all(SclshOutput* out, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t res = out->sink.write(out->sink.user_data, iov, iovcnt);
+        if (res < 0) {
+            return 0;
+        }
+        size_t done = (size_t)res;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 1;
+}
+
+int sclsh_output_flush(SclshOutput* out) {
+    if (!out || out->length == 0) {
+        return 1;
+    }
+    struct iovec iov = { .iov_base = out->buffer, .iov_len = out->length };
+    out->length = 0;
+    return write_all(out, &iov, 1);
+}
+
+int sclsh_output_writev(SclshOutput* out, const struct iovec* iov, int iovcnt) {
+    if (!out) {
+        return 0;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+
+    if (out->buffering != SCLSH_OUTPUT_NONE && out->length + total <= out->capacity) {
+        int newline = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            memcpy(out->buffer + out->length, iov[i].iov_base, iov[i].iov_len);
+            out->length += iov[i].iov_len;
+            if (out->buffering == SCLSH_OUTPUT_LINE && !newline) {
+                newline = memchr(iov[i].iov_base, '\n', iov[i].iov_len) != NULL;
+            }
+        }
+        return newline ? sclsh_output_flush(out) : 1;
+    }
+
+    // Too large to buffer: send what is buffered and the new data in one
+    // batch, straight from the caller's memory
+    if (iovcnt + 1 > OUTPUT_MAX_IOV) {
+        for (int i = 0; i < iovcnt; i += OUTPUT_MAX_IOV - 1) {
+            int chunk = iovcnt - i < OUTPUT_MAX_IOV - 1 ? iovcnt - i : OUTPUT_MAX_IOV - 1;
+            if (!sclsh_output_writev(out, iov + i, chunk)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    struct iovec batch[OUTPUT_MAX_IOV];
+    int count = 0;
+    if (out->length > 0) {
+        batch[count].iov_base = out->buffer;
+        batch[count].iov_len = out->length;
+        count++;
+        out->length = 0;
+    }
+    memcpy(batch + count, iov, sizeof(struct iovec) * iovcnt);
+    return write_all(out, batch, count + iovcnt);
+}
+
+int sclsh_output_write(SclshOutput* out, const char* bytes, size_t length) {
+    struct iovec iov = { .iov_base = (void*)bytes, .iov_len = length };
+    return sclsh_output_writev(out, &iov, 1);
+}
+
+SclshValue* sclsh_output_memory_value(SclshOutput* out) {
+    if (!out || out->sink.write != memory_write) {
+        return NULL;
+    }
+    sclsh_output_flush(out);
+    return sclsh_string_builder_to_value(out->sink.user_data);
+}
+
+SclshOutput* sclsh_interpreter_output(SclshInterpreter* interp) {
+    return interp ? interp->output : NULL;
+}
+
+SclshOutput* sclsh_interpreter_set_output(SclshInterpreter* interp, SclshOutput* out) {
+    if (!interp) {
+        return NULL;
+    }
+    SclshOutput* previous = interp->output;
+    sclsh_output_flush(previous);
+    interp->output = out;
+    return previous;
+}
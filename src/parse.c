@@ -5,6 +5,12 @@
 
 #include <sclsh/parse.h>
 #include <ctype.h>
+#include <string.h>
+
+// A backslash right before a newline continues the line
+static int is_line_continuation(SclshStringBuffer* buffer, size_t pos) {
+    return pos + 1 < buffer->length && buffer->string[pos] == '\\' && buffer->string[pos + 1] == '\n';
+}
 
 int skip_comments_and_whitespace(SclshStringBuffer* buffer, size_t* pos) {
     while (*pos < buffer->length) {
@@ -17,6 +23,8 @@ int skip_comments_and_whitespace(SclshStringBuffer* buffer, size_t* pos) {
         } else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
             // Skip whitespace
             (*pos)++;
+        } else if (is_line_continuation(buffer, *pos)) {
+            *pos += 2;
         } else {
             return 0; // Found non-whitespace character
         }
@@ -36,13 +44,8 @@ int skip_comments_and_whitespace_to_eol(SclshStringBuffer* buffer, size_t* pos)
         } else if (ch == ' ' || ch == '\t') {
             // Skip whitespace
             (*pos)++;
-        } else if (ch == '\n' || ch == '\r') {
-            if (*pos > 0 && buffer->string[*pos - 1] == '\\') {
-                // If the newline is escaped, just skip it
-                (*pos)++;
-            } else {
-                return 1;
-            }
+        } else if (is_line_continuation(buffer, *pos)) {
+            *pos += 2; // An escaped newline separates words like a space
         } else {
             return 1;
         }
@@ -56,11 +59,127 @@ int skip_bare_word(SclshStringBuffer* buffer, size_t* pos) {
         if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '#') {
             return 1; // Found whitespace or comment start
         }
+        if (ch == '\\' && *pos + 1 < buffer->length) {
+            if (buffer->string[*pos + 1] == '\n') {
+                return 1; // Line continuation
+            }
+            (*pos)++; // An escaped character belongs to the word
+        }
         (*pos)++;
     }
     return 1; // Reached end of buffer
 }
 
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+// Appends the code point as UTF-8
+static void append_utf8(SclshStringBuilder* sb, unsigned int code_point) {
+    char bytes[3];
+    size_t length;
+    if (code_point < 0x80) {
+        bytes[0] = (char)code_point;
+        length = 1;
+    } else if (code_point < 0x800) {
+        bytes[0] = (char)(0xC0 | (code_point >> 6));
+        bytes[1] = (char)(0x80 | (code_point & 0x3F));
+        length = 2;
+    } else {
+        bytes[0] = (char)(0xE0 | (code_point >> 12));
+        bytes[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (code_point & 0x3F));
+        length = 3;
+    }
+    sclsh_string_builder_append_bytes(sb, bytes, length);
+}
+
+/* Appends the text a backslash sequence stands for and returns the
+ * length of the sequence. Besides the C control character escapes
+ * there are \xHH (one or two hex digits) for a byte and \uXXXX (one to
+ * four) for a character encoded as UTF-8. A backslash-newline and the
+ * blanks after it stand for a single space; any other character stands
+ * for itself, which covers \\, \", \$, \[ and the like.
+ */
+static size_t decode_escape(SclshStringBuilder* sb, const char* string, size_t length) {
+    if (length < 2) {
+        sclsh_string_builder_append_bytes(sb, string, length);
+        return length;
+    }
+    char ch;
+    switch (string[1]) {
+        case 'a': ch = '\a'; break;
+        case 'b': ch = '\b'; break;
+        case 'f': ch = '\f'; break;
+        case 'n': ch = '\n'; break;
+        case 'r': ch = '\r'; break;
+        case 't': ch = '\t'; break;
+        case 'v': ch = '\v'; break;
+        case 'x':
+        case 'u': {
+            size_t max_digits = string[1] == 'x' ? 2 : 4;
+            size_t end = 2;
+            unsigned int code_point = 0;
+            while (end < length && end - 2 < max_digits && hex_value(string[end]) >= 0) {
+                code_point = code_point * 16 + (unsigned int)hex_value(string[end]);
+                end++;
+            }
+            if (end == 2) {
+                ch = string[1]; // No digits, just the letter
+                break;
+            }
+            if (string[1] == 'x') {
+                ch = (char)code_point;
+                sclsh_string_builder_append_bytes(sb, &ch, 1);
+            } else {
+                append_utf8(sb, code_point);
+            }
+            return end;
+        }
+        case '\n': {
+            size_t end = 2;
+            while (end < length && (string[end] == ' ' || string[end] == '\t')) {
+                end++;
+            }
+            sclsh_string_builder_append_bytes(sb, " ", 1);
+            return end;
+        }
+        default: ch = string[1]; break;
+    }
+    sclsh_string_builder_append_bytes(sb, &ch, 1);
+    return 2;
+}
+
+/* The text of a word with its backslash sequences decoded, done once
+ * when the word is parsed. Most words have none: memchr, which libc
+ * implements as a vector scan, finds that out and the text is taken as
+ * it is.
+ */
+static SclshValue* decode_escapes(const char* string, size_t length) {
+    const char* end = string + length;
+    const char* backslash = memchr(string, '\\', length);
+    if (!backslash) {
+        return sclsh_value_new(string, length);
+    }
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    while (backslash) {
+        sclsh_string_builder_append_bytes(sb, string, backslash - string);
+        string = backslash + decode_escape(sb, backslash, end - backslash);
+        backslash = memchr(string, '\\', end - string);
+    }
+    sclsh_string_builder_append_bytes(sb, string, end - string);
+    SclshValue* value = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    return value;
+}
+
 SclshValue* parse_bare_word(SclshStringBuffer* buffer, size_t* pos) {
     size_t start = *pos;
     if (!skip_bare_word(buffer, pos)) {
@@ -70,12 +189,11 @@ SclshValue* parse_bare_word(SclshStringBuffer* buffer, size_t* pos) {
     if (length == 0) {
         return NULL; // No bare word found
     }
-    return sclsh_value_new(buffer->string + start, length);
+    return decode_escapes(buffer->string + start, length);
 }
 
 int skip_braces(SclshStringBuffer* buffer, size_t* pos) { 
     int brace_count = 1;
-    int escape = 0;
     if (*pos >= buffer->length || buffer->string[*pos] != '{') {
         return 0; // Not a brace word
     }
@@ -84,21 +202,11 @@ int skip_braces(SclshStringBuffer* buffer, size_t* pos) {
     while (*pos < buffer->length && brace_count > 0) {
         char ch = buffer->string[*pos];
         if (ch == '{') {
-            if (escape) {
-                escape = 0; // Reset escape state
-            } else {
-                brace_count++;
-            }
+            brace_count++;
         } else if (ch == '}') {
-            if (escape) {
-                escape = 0; // Reset escape state
-            } else if (brace_count > 0) {
-                brace_count--;
-            }
-        } else if (ch == '\\') {
-            escape = 1;
-        } else {
-            escape = 0; // Reset escape state for any other character
+            brace_count--;
+        } else if (ch == '\\' && *pos + 1 < buffer->length) {
+            (*pos)++; // The escaped character does not count
         }
         (*pos)++;
     }
@@ -119,7 +227,6 @@ SclshValue* parse_brace_word(SclshStringBuffer* buffer, size_t* pos) {
 
 int skip_brackets(SclshStringBuffer* buffer, size_t* pos) {
     int bracket_count = 1;
-    int escape = 0;
 
     if (*pos >= buffer->length || buffer->string[*pos] != '[') {
         return 0; // Not a bracket word
@@ -129,21 +236,11 @@ int skip_brackets(SclshStringBuffer* buffer, size_t* pos) {
     while (*pos < buffer->length && bracket_count > 0) {
         char ch = buffer->string[*pos];
         if (ch == '[') {
-            if (escape) {
-                escape = 0; // Reset escape state
-            } else {
-                bracket_count++;
-            }
+            bracket_count++;
         } else if (ch == ']') {
-            if (escape) {
-                escape = 0; // Reset escape state
-            } else if (bracket_count > 0) {
-                bracket_count--;
-            }
-        } else if (ch == '\\') {
-            escape = 1;
-        } else {
-            escape = 0; // Reset escape state for any other character
+            bracket_count--;
+        } else if (ch == '\\' && *pos + 1 < buffer->length) {
+            (*pos)++; // The escaped character does not count
         }
         (*pos)++;
     }
@@ -162,6 +259,42 @@ SclshValue* parse_bracket_word(SclshStringBuffer* buffer, size_t* pos) {
     return sclsh_value_new(buffer->string + start + 1, length - 2); // Exclude brackets
 }
 
+// A quoted word runs to the next double quote that is neither escaped
+// nor inside a bracketed command. An unmatched [ is just text, as it is
+// when the word is interpolated.
+int skip_quotes(SclshStringBuffer* buffer, size_t* pos) {
+    if (*pos >= buffer->length || buffer->string[*pos] != '"') {
+        return 0; // Not a quoted word
+    }
+    (*pos)++; // Skip the opening quote
+
+    while (*pos < buffer->length) {
+        char ch = buffer->string[*pos];
+        if (ch == '"') {
+            (*pos)++;
+            return 1;
+        } else if (ch == '\\') {
+            *pos += *pos + 1 < buffer->length ? 2 : 1;
+        } else if (ch == '[') {
+            size_t start = *pos;
+            if (!skip_brackets(buffer, pos)) {
+                *pos = start + 1;
+            }
+        } else {
+            (*pos)++;
+        }
+    }
+    return 0; // Unmatched quote
+}
+
+SclshValue* parse_quoted_word(SclshStringBuffer* buffer, size_t* pos) {
+    size_t start = *pos;
+    if (!skip_quotes(buffer, pos)) {
+        return NULL; // Error or unmatched quote
+    }
+    return sclsh_value_new(buffer->string + start + 1, *pos - start - 2); // Exclude quotes
+}
+
 SclshValue* parse_variable_word(SclshStringBuffer* buffer, size_t* pos) {
     if (*pos >= buffer->length || buffer->string[*pos] != '$') {
         return NULL; // Not a variable word
@@ -193,12 +326,20 @@ SclshValueList* sclsh_parse_list(SclshStringBuffer buffer) {
         SclshValue* value = NULL;
         if (buffer.string[pos] == '{') {
             value = parse_brace_word(&buffer, &pos);
+        } else if (buffer.string[pos] == '"') {
+            size_t start = pos;
+            if (skip_quotes(&buffer, &pos)) {
+                value = decode_escapes(buffer.string + start + 1, pos - start - 2);
+            }
         } else {
             value = parse_bare_word(&buffer, &pos);
         }
 
         if (value) {
             sclsh_list_builder_append(list, value);
+            sclsh_value_unref(value);
+        } else if (pos < buffer.length) {
+            pos++; // Skip what could not be parsed rather than loop on it
         }
     }
 
@@ -228,12 +369,16 @@ SclshNodeList* sclsh_parse_command_line(SclshStringBuffer buffer) {
         } else if (buffer.string[pos] == '$') {
             value = parse_variable_word(&buffer, &pos);
             type = SCLSH_WORD_VARIABLE;
+        } else if (buffer.string[pos] == '"') {
+            value = parse_quoted_word(&buffer, &pos);
+            type = SCLSH_WORD_QUOTED;
         } else {
             value = parse_bare_word(&buffer, &pos);
         }
 
         if (value) {
             sclsh_node_list_builder_append(builder, value, type);
+            sclsh_value_unref(value);
         }
     }
 
@@ -248,13 +393,23 @@ int skip_command_line(SclshStringBuffer* buffer, size_t* pos) {
         if (!skip_comments_and_whitespace_to_eol(buffer, pos)) {
             return 1; // End of buffer
         }
+        if (*pos >= buffer->length) {
+            break;
+        }
         char ch = buffer->string[*pos];
-        if (ch == '{' || ch == '[' || ch == '$') {
+        if (ch == '\n' || ch == '\r') {
+            return 1; // Unescaped newline ends the command
+        }
+        if (ch == '{' || ch == '[' || ch == '$' || ch == '"') {
             // Skip to the end of the command line
             if (ch == '{') {
                 if (!skip_braces(buffer, pos)) {
                     return 0; // Unmatched braces
                 }
+            } else if (ch == '"') {
+                if (!skip_quotes(buffer, pos)) {
+                    return 0; // Unmatched quote
+                }
             } else if (ch == '[') {
                 if (!skip_brackets(buffer, pos)) {
                     return 0; // Unmatched brackets
@@ -282,6 +437,9 @@ SclshValueList* sclsh_parse_commands(SclshStringBuffer buffer) {
 
     size_t pos = 0;
     while (pos < buffer.length) {
+        if (skip_comments_and_whitespace(&buffer, &pos) < 0) {
+            break; // Nothing but whitespace and comments left
+        }
         size_t start = pos;
         if (!skip_command_line(&buffer, &pos)) {
             break; // Error or end of buffer
@@ -292,6 +450,7 @@ SclshValueList* sclsh_parse_commands(SclshStringBuffer buffer) {
         }
         SclshValue* value = sclsh_value_new(buffer.string + start, length);
         sclsh_list_builder_append(list, value);
+        sclsh_value_unref(value);
     }
 
     res = sclsh_list_builder_value_list(list);
@@ -312,18 +471,64 @@ int sclsh_command_line_complete(SclshStringBuffer buffer) {
     return 1;
 }
 
+// Ends the literal segment collected so far
+static void flush_literal(SclshNodeListBuilder* builder, SclshStringBuilder* literal) {
+    SclshValue* value = sclsh_string_builder_to_value(literal);
+    if (sclsh_value_as_bytes(value).length > 0) {
+        sclsh_node_list_builder_append(builder, value, SCLSH_WORD_BARE);
+    }
+    sclsh_value_unref(value);
+    sclsh_string_builder_free(literal);
+}
+
+/* The contents of a quoted word as a template: literal segments (bare
+ * nodes, backslash sequences already decoded) alternating with variable
+ * and bracket nodes to substitute. A string without substitutions is a
+ * single literal segment, an empty string has no segments.
+ */
 SclshNodeList* sclsh_parse_interpolation(SclshStringBuffer buffer) {
     SclshNodeListBuilder* builder = sclsh_node_list_builder_new();
-    SclshNodeList* node_list = NULL;
+    SclshStringBuilder* literal = sclsh_string_builder_new();
 
-    // TODO
-    sclsh_node_list_builder_append(
-        builder, 
-        sclsh_value_new(buffer.string, buffer.length), 
-        SCLSH_WORD_BARE
-    );
- 
-    node_list = sclsh_node_list_builder_value(builder);
+    size_t pos = 0;
+    while (pos < buffer.length) {
+        // Plain text up to the next special character goes in one piece
+        size_t start = pos;
+        while (pos < buffer.length && buffer.string[pos] != '\\'
+               && buffer.string[pos] != '$' && buffer.string[pos] != '[') {
+            pos++;
+        }
+        sclsh_string_builder_append_bytes(literal, buffer.string + start, pos - start);
+        if (pos == buffer.length) {
+            break;
+        }
+
+        SclshValue* value = NULL;
+        SclshNodeType type = SCLSH_WORD_VARIABLE;
+        start = pos;
+        if (buffer.string[pos] == '\\') {
+            pos += decode_escape(literal, buffer.string + pos, buffer.length - pos);
+            continue;
+        } else if (buffer.string[pos] == '$') {
+            value = parse_variable_word(&buffer, &pos);
+        } else {
+            value = parse_bracket_word(&buffer, &pos);
+            type = SCLSH_WORD_BRACKET;
+        }
+        if (!value) {
+            // A lone $ or an unmatched [ is just text
+            pos = start + 1;
+            sclsh_string_builder_append_bytes(literal, buffer.string + start, 1);
+            continue;
+        }
+        flush_literal(builder, literal);
+        literal = sclsh_string_builder_new();
+        sclsh_node_list_builder_append(builder, value, type);
+        sclsh_value_unref(value);
+    }
+    flush_literal(builder, literal);
+
+    SclshNodeList* node_list = sclsh_node_list_builder_value(builder);
     sclsh_node_list_builder_free(builder);
     return node_list;
-}
\ No newline at end of file
+}
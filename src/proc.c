@@ -0,0 +1,233 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/proc.h>
+#include <sclsh/util.h>
+#include "code.h"
+#include "value.h"
+#include "interp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SclshProc* sclsh_proc_ref(SclshProc* proc) {
+    if (proc) {
+        proc->ref_count++;
+    }
+    return proc;
+}
+
+// Drops what parse_params and compiling the body built
+static void proc_clear(SclshProc* proc) {
+    if (proc->defaults) {
+        for (size_t i = 0; i < proc->param_count; i++) {
+            sclsh_value_unref(proc->defaults[i]);
+        }
+    }
+    for (size_t i = 0; i < proc->local_count; i++) {
+        free(proc->local_names[i]);
+    }
+    free(proc->defaults);
+    free(proc->local_names);
+    sclsh_hash_map_free(proc->slots);
+    sclsh_code_unref(proc->code);
+    free(proc->usage);
+    proc->defaults = NULL;
+    proc->local_names = NULL;
+    proc->slots = NULL;
+    proc->code = NULL;
+    proc->usage = NULL;
+    proc->param_count = 0;
+    proc->required_count = 0;
+    proc->variadic = false;
+    proc->local_count = 0;
+    proc->local_capacity = 0;
+}
+
+void sclsh_proc_unref(SclshProc* proc) {
+    if (!proc || --proc->ref_count > 0) {
+        return;
+    }
+    proc_clear(proc);
+    sclsh_value_unref(proc->params);
+    sclsh_value_unref(proc->body);
+    free(proc->name);
+    free(proc);
+}
+
+// Binds the parameters to the first slots and builds the usage message
+static bool parse_params(SclshProc* proc) {
+    SclshValueList* params = sclsh_value_as_list(proc->params);
+    size_t count = params ? params->count : 0;
+
+    proc->defaults = calloc(count ? count : 1, sizeof(SclshValue*));
+    if (!proc->defaults) {
+        return false;
+    }
+    SclshStringBuilder* usage = sclsh_string_builder_new();
+    sclsh_string_builder_append_str(usage, proc->name);
+
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        SclshValueList* param = sclsh_value_as_list(params->items[i]);
+        if (!param || param->count < 1 || param->count > 2) {
+            fprintf(stderr, "Invalid parameter '%s' of '%s'\n",
+                sclsh_value_as_string(params->items[i]).string, proc->name);
+            ok = false;
+            break;
+        }
+        char* name = sclsh_value_as_string(param->items[0]).string;
+        if (sclsh_proc_slot(proc, name, false) >= 0) {
+            fprintf(stderr, "Duplicate parameter '%s' of '%s'\n", name, proc->name);
+            ok = false;
+            break;
+        }
+        sclsh_proc_slot(proc, name, true);
+        proc->param_count++;
+
+        if (param->count == 2) {
+            proc->defaults[i] = sclsh_value_ref(param->items[1]);
+            sclsh_string_builder_append_str(usage, " ?");
+            sclsh_string_builder_append_str(usage, name);
+            sclsh_string_builder_append_str(usage, "?");
+        } else if (i == count - 1 && strcmp(name, "args") == 0) {
+            proc->variadic = true;
+            sclsh_string_builder_append_str(usage, " ?arg ...?");
+        } else {
+            proc->required_count = i + 1;
+            sclsh_string_builder_append_str(usage, " ");
+            sclsh_string_builder_append_str(usage, name);
+        }
+    }
+
+    proc->usage = sclsh_string_builder_value(usage).string;
+    sclsh_string_builder_free(usage);
+    return ok;
+}
+
+// Parses the parameters and compiles the body
+static bool proc_prepare(SclshProc* proc) {
+    proc->slots = sclsh_hash_map_new();
+    if (!parse_params(proc)) {
+        proc_clear(proc);
+        return false;
+    }
+    proc->code = sclsh_code_compile_proc(proc);
+    if (!proc->code) {
+        fprintf(stderr, "Cannot compile the body of '%s'\n", proc->name);
+        proc_clear(proc);
+        return false;
+    }
+    return true;
+}
+
+static SclshProc* proc_new(const char* name, SclshValue* params, SclshValue* body) {
+    SclshProc* proc = calloc(1, sizeof(SclshProc));
+    if (!proc) {
+        return NULL;
+    }
+    proc->ref_count = 1;
+    proc->name = strdup(name);
+    proc->params = sclsh_value_ref(params);
+    proc->body = sclsh_value_ref(body);
+    return proc;
+}
+
+static SclshValue* cmd_call(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    SclshProc* proc = user_data;
+    if (!proc->code && !proc_prepare(proc)) {
+        return NULL;  // Restored without being compiled, see sclsh_proc_restore
+    }
+    return sclsh_call_proc(ctx, proc, argc, argv);
+}
+
+static void proc_destructor(void* user_data) {
+    sclsh_proc_unref(user_data);  // Calls still running keep their own reference
+}
+
+int sclsh_proc_define(
+    SclshInterpreter* interp,
+    const char* name,
+    SclshValue* params,
+    SclshValue* body
+) {
+    if (!interp || !name || !params || !body) {
+        return 0;
+    }
+    if (sclsh_code_inlines(name)) {
+        fprintf(stderr, "Cannot redefine '%s', it is compiled inline\n", name);
+        return 0;
+    }
+    SclshProc* proc = proc_new(name, params, body);
+    if (!proc) {
+        return 0;
+    }
+    if (!proc_prepare(proc)) {
+        sclsh_proc_unref(proc);
+        return 0;
+    }
+    sclsh_command_new(interp, proc->name, cmd_call, proc, proc_destructor);
+    return 1;
+}
+
+int sclsh_proc_restore(
+    SclshInterpreter* interp,
+    const char* name,
+    SclshValue* params,
+    SclshValue* body
+) {
+    if (!interp || !name || !params || !body || sclsh_code_inlines(name)) {
+        return 0;
+    }
+    SclshProc* proc = proc_new(name, params, body);
+    if (!proc) {
+        return 0;
+    }
+    sclsh_command_new(interp, proc->name, cmd_call, proc, proc_destructor);
+    return 1;
+}
+
+typedef struct ProcIteration_s {
+    SclshProcCallback callback;
+    void* user_data;
+} ProcIteration;
+
+static void visit_command(const char* key, void* value, void* user_data) {
+    (void)key;
+    SclshCommand* command = value;
+    ProcIteration* iteration = user_data;
+    if (command->func == cmd_call) {
+        SclshProc* proc = command->user_data;
+        iteration->callback(proc->name, proc->params, proc->body, iteration->user_data);
+    }
+}
+
+void sclsh_for_each_proc(SclshInterpreter* interp, SclshProcCallback callback, void* user_data) {
+    if (!interp || !callback) {
+        return;
+    }
+    ProcIteration iteration = { .callback = callback, .user_data = user_data };
+    sclsh_hash_map_for_each(interp->commands, visit_command, &iteration);
+}
+
+static SclshValue* cmd_proc(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 3) {
+        fprintf(stderr, "Usage: proc <name> <params> <body>\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    if (!sclsh_proc_define(sclsh_context_interpreter(ctx), name, argv[1], argv[2])) {
+        return NULL;
+    }
+    return sclsh_value_empty();
+}
+
+void sclsh_register_proc_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "proc", cmd_proc, NULL, NULL);
+}
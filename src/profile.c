@@ -0,0 +1,453 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/profile.h>
+#include <sclsh/util.h>
+#include "value.h"
+#include "interp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// An invocation that has not completed yet
+typedef struct Activation_s {
+    SclshProfileEntry* entry;
+    const void* run;  // Run of the invocation, see vm.c
+    size_t level;  // Completes once the run has fewer frames than this
+    uint64_t start;
+    uint64_t child_ns;
+    uint64_t allocations_start;
+    uint64_t child_allocations;
+} Activation;
+
+struct SclshProfile_s {
+    SclshHashMap* entries;  // Command name -> SclshProfileEntry
+    Activation* stack;
+    size_t count;
+    size_t capacity;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void free_entry(const char* key, void* value, void* user_data) {
+    (void)key; (void)user_data; // Suppress unused parameter warnings
+    SclshProfileEntry* entry = value;
+    free((char*)entry->name);
+    free(entry);
+}
+
+void sclsh_profile_free(SclshProfile* profile) {
+    if (!profile) {
+        return;
+    }
+    sclsh_hash_map_for_each(profile->entries, free_entry, NULL);
+    sclsh_hash_map_free(profile->entries);
+    free(profile->stack);
+    free(profile);
+}
+
+void sclsh_profile_enter(SclshProfile* profile, const char* name, const void* run) {
+    SclshProfileEntry* entry = sclsh_hash_map_get(profile->entries, name);
+    if (!entry) {
+        entry = calloc(1, sizeof(SclshProfileEntry));
+        if (!entry) {
+            return;
+        }
+        entry->name = strdup(name);
+        sclsh_hash_map_set(profile->entries, entry->name, entry);
+    }
+    if (profile->count == profile->capacity) {
+        size_t capacity = profile->capacity ? profile->capacity * 2 : 64;
+        Activation* stack = realloc(profile->stack, sizeof(Activation) * capacity);
+        if (!stack) {
+            return;
+        }
+        profile->stack = stack;
+        profile->capacity = capacity;
+    }
+    entry->calls++;
+    Activation* activation = &profile->stack[profile->count++];
+    activation->entry = entry;
+    activation->run = run;
+    activation->level = SIZE_MAX;  // Running in C
+    activation->child_ns = 0;
+    activation->child_allocations = 0;
+    activation->allocations_start = sclsh_value_allocation_count();
+    activation->start = now_ns();
+}
+
+void sclsh_profile_pending(SclshProfile* profile, const void* run, size_t level) {
+    if (profile->count > 0 && profile->stack[profile->count - 1].run == run) {
+        profile->stack[profile->count - 1].level = level;
+    }
+}
+
+// Accounts for the innermost invocation, which completed at now
+static void pop_activation(SclshProfile* profile, uint64_t now, uint64_t allocations) {
+    Activation* activation = &profile->stack[--profile->count];
+    uint64_t inclusive = now - activation->start;
+    uint64_t allocated = allocations - activation->allocations_start;
+    activation->entry->inclusive_ns += inclusive;
+    activation->entry->exclusive_ns += inclusive - activation->child_ns;
+    activation->entry->allocations += allocated - activation->child_allocations;
+    if (profile->count > 0) {
+        profile->stack[profile->count - 1].child_ns += inclusive;
+        profile->stack[profile->count - 1].child_allocations += allocated;
+    }
+}
+
+void sclsh_profile_complete(SclshProfile* profile, const void* run, size_t level) {
+    if (profile->count == 0) {
+        return;
+    }
+    uint64_t now = now_ns();
+    uint64_t allocations = sclsh_value_allocation_count();
+    while (profile->count > 0) {
+        Activation* activation = &profile->stack[profile->count - 1];
+        if (activation->run != run || activation->level <= level) {
+            break;
+        }
+        pop_activation(profile, now, allocations);
+    }
+}
+
+void sclsh_profile_start(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    SclshProfile* profile = interp->profile;
+    if (!profile) {
+        profile = calloc(1, sizeof(SclshProfile));
+        if (!profile) {
+            return;
+        }
+        interp->profile = profile;
+    } else {
+        sclsh_hash_map_for_each(profile->entries, free_entry, NULL);
+        sclsh_hash_map_free(profile->entries);
+    }
+    // The dispatcher may hold on to the profile across this call, so it
+    // is reset rather than replaced
+    profile->entries = sclsh_hash_map_new();
+    profile->count = 0;
+    interp->profiling = profile;
+    interp->instrumented = true;
+}
+
+void sclsh_profile_stop(SclshInterpreter* interp) {
+    if (!interp || !interp->profiling) {
+        return;
+    }
+    // Invocations still running (at least the one stopping the profile)
+    // are counted up to now
+    SclshProfile* profile = interp->profiling;
+    uint64_t now = now_ns();
+    uint64_t allocations = sclsh_value_allocation_count();
+    while (profile->count > 0) {
+        pop_activation(profile, now, allocations);
+    }
+    interp->profiling = NULL;
+    interp->instrumented = interp->sampling != NULL;
+}
+
+int sclsh_profile_running(SclshInterpreter* interp) {
+    return interp && interp->profiling;
+}
+
+typedef struct Collect_s {
+    SclshProfileEntry* entries;
+    size_t count;
+} Collect;
+
+static void collect_entry(const char* key, void* value, void* user_data) {
+    (void)key; // Suppress unused parameter warning
+    Collect* collect = user_data;
+    collect->entries[collect->count++] = *(SclshProfileEntry*)value;
+}
+
+static int compare_exclusive(const void* a, const void* b) {
+    const SclshProfileEntry* x = a;
+    const SclshProfileEntry* y = b;
+    if (x->exclusive_ns != y->exclusive_ns) {
+        return x->exclusive_ns < y->exclusive_ns ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static void count_entry(const char* key, void* value, void* user_data) {
+    (void)key; (void)value; // Suppress unused parameter warnings
+    (*(size_t*)user_data)++;
+}
+
+size_t sclsh_profile_results(SclshInterpreter* interp, SclshProfileEntry** entries) {
+    *entries = NULL;
+    if (!interp || !interp->profile) {
+        return 0;
+    }
+    size_t count = 0;
+    sclsh_hash_map_for_each(interp->profile->entries, count_entry, &count);
+    if (count == 0) {
+        return 0;
+    }
+    Collect collect = { malloc(sizeof(SclshProfileEntry) * count), 0 };
+    if (!collect.entries) {
+        return 0;
+    }
+    sclsh_hash_map_for_each(interp->profile->entries, collect_entry, &collect);
+    qsort(collect.entries, collect.count, sizeof(SclshProfileEntry), compare_exclusive);
+    *entries = collect.entries;
+    return collect.count;
+}
+
+// One line per command, the most expensive first
+static SclshValue* profile_report(SclshInterpreter* interp) {
+    SclshProfileEntry* entries;
+    size_t count = sclsh_profile_results(interp, &entries);
+
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    char line[256];
+    snprintf(line, sizeof(line), "%-24s %10s %12s %12s %10s\n",
+        "command", "calls", "incl ms", "excl ms", "allocs");
+    sclsh_string_builder_append_str(sb, line);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "%-24s %10llu %12.3f %12.3f %10llu\n",
+            entries[i].name,
+            (unsigned long long)entries[i].calls,
+            entries[i].inclusive_ns / 1e6,
+            entries[i].exclusive_ns / 1e6,
+            (unsigned long long)entries[i].allocations);
+        sclsh_string_builder_append_str(sb, line);
+    }
+    free(entries);
+    SclshValue* report = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    return report;
+}
+
+// profile sample start ?rate?|stop|collapsed
+static SclshValue* profile_sample(SclshInterpreter* interp, size_t argc, SclshValue** argv) {
+    char* sub = argc > 0 ? sclsh_value_as_string(argv[0]).string : "";
+    if (strcmp(sub, "start") == 0 && argc <= 2) {
+        unsigned long rate = SCLSH_DEFAULT_SAMPLE_RATE;
+        if (argc == 2) {
+            char* end;
+            rate = strtoul(sclsh_value_as_string(argv[1]).string, &end, 10);
+            if (*end != '\0' || rate == 0 || rate > 100000) {
+                fprintf(stderr, "Invalid sample rate '%s'\n", sclsh_value_as_string(argv[1]).string);
+                return NULL;
+            }
+        }
+        return sclsh_sample_start(interp, (unsigned)rate) ? sclsh_value_empty() : NULL;
+    }
+    if (strcmp(sub, "stop") == 0 && argc == 1) {
+        sclsh_sample_stop(interp);
+        return sclsh_value_empty();
+    }
+    if (strcmp(sub, "collapsed") == 0 && argc == 1) {
+        return sclsh_sample_collapsed(interp);
+    }
+    fprintf(stderr, "Usage: profile sample start ?rate?|stop|collapsed\n");
+    return NULL;
+}
+
+static SclshValue* cmd_profile(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    if (argc >= 1 && strcmp(sclsh_value_as_string(argv[0]).string, "sample") == 0) {
+        return profile_sample(interp, argc - 1, argv + 1);
+    }
+    if (argc != 1) {
+        fprintf(stderr, "Usage: profile start|stop|report|sample ...\n");
+        return NULL;
+    }
+    char* sub = sclsh_value_as_string(argv[0]).string;
+    if (strcmp(sub, "start") == 0) {
+        sclsh_profile_start(interp);
+        return sclsh_value_empty();
+    }
+    if (strcmp(sub, "stop") == 0) {
+        sclsh_profile_stop(interp);
+        return sclsh_value_empty();
+    }
+    if (strcmp(sub, "report") == 0) {
+        return profile_report(interp);
+    }
+    fprintf(stderr, "Unknown profile subcommand '%s'\n", sub);
+    return NULL;
+}
+
+// Evaluates script count times, stopping at the first failure. Apart from
+// what the script allocates this does not touch the heap, so it can sit
+// inside a timed region.
+static bool eval_repeatedly(SclshContext* ctx, SclshValue* script, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        SclshValue* result = sclsh_eval(ctx, script);
+        if (!result) {
+            return false;
+        }
+        sclsh_value_unref(result);
+    }
+    return true;
+}
+
+// Positive integer argument, or 0 after reporting what is wrong with it
+static uint64_t positive_arg(SclshValue* value) {
+    char* string = sclsh_value_as_string(value).string;
+    char* end;
+    long long n = strtoll(string, &end, 10);
+    if (end == string || *end != '\0' || n <= 0) {
+        fprintf(stderr, "Expected positive integer but got '%s'\n", string);
+        return 0;
+    }
+    return (uint64_t)n;
+}
+
+// time <script> ?count?
+static SclshValue* cmd_time(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1 || argc > 2) {
+        fprintf(stderr, "Usage: time <script> ?count?\n");
+        return NULL;
+    }
+    uint64_t count = argc == 2 ? positive_arg(argv[1]) : 1;
+    if (count == 0) {
+        return NULL;
+    }
+    uint64_t start = now_ns();
+    if (!eval_repeatedly(ctx, argv[0], count)) {
+        return NULL;
+    }
+    double per_iteration = (double)(now_ns() - start) / 1e3 / count;
+
+    char result[64];
+    snprintf(result, sizeof(result), "%.3f microseconds per iteration", per_iteration);
+    return sclsh_value_from_cstr(result);
+}
+
+/* bench runs a script in batches and reports the time of one iteration.
+ *
+ * A warmup first runs the script, in doubling batches, for the warmup
+ * time; besides warming caches this estimates the cost of an iteration,
+ * from which the batch size is chosen so that BENCH_SAMPLES batches fill
+ * the measuring time. Every batch yields one sample of the time per
+ * iteration; the result is a list of name value pairs with the
+ * statistics of the samples in nanoseconds and the heap blocks allocated
+ * for values per iteration.
+ */
+#define BENCH_SAMPLES 100
+#define BENCH_DEFAULT_TIME_MS 1000
+#define BENCH_DEFAULT_WARMUP_MS 100
+
+static int compare_samples(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static SclshValue* bench_result(uint64_t batch, double* samples, uint64_t allocations) {
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compare_samples);
+    double sum = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        sum += samples[i];
+    }
+    double mean = sum / BENCH_SAMPLES;
+    double squares = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        squares += (samples[i] - mean) * (samples[i] - mean);
+    }
+    uint64_t iterations = batch * BENCH_SAMPLES;
+
+    const char* names[] = { "iterations", "mean", "median", "p99", "stddev", "allocations" };
+    double values[] = {
+        (double)iterations,
+        mean,
+        samples[BENCH_SAMPLES / 2],
+        samples[(BENCH_SAMPLES * 99 + 99) / 100 - 1],
+        sqrt(squares / BENCH_SAMPLES),
+        (double)allocations / iterations,
+    };
+    SclshValue* items[12];
+    char number[64];
+    for (size_t i = 0; i < 6; i++) {
+        snprintf(number, sizeof(number), i == 0 ? "%.0f" : "%.1f", values[i]);
+        items[i * 2] = sclsh_value_from_cstr(names[i]);
+        items[i * 2 + 1] = sclsh_value_from_cstr(number);
+    }
+    SclshValue* result = sclsh_value_new_from_list(items, 12);
+    for (size_t i = 0; i < 12; i++) {
+        sclsh_value_unref(items[i]);
+    }
+    return result;
+}
+
+// bench <script> ?-time ms? ?-warmup ms?
+static SclshValue* cmd_bench(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc % 2 != 1) {
+        fprintf(stderr, "Usage: bench <script> ?-time ms? ?-warmup ms?\n");
+        return NULL;
+    }
+    uint64_t time_ms = BENCH_DEFAULT_TIME_MS;
+    uint64_t warmup_ms = BENCH_DEFAULT_WARMUP_MS;
+    for (size_t i = 1; i < argc; i += 2) {
+        char* option = sclsh_value_as_string(argv[i]).string;
+        uint64_t* target = strcmp(option, "-time") == 0 ? &time_ms
+                         : strcmp(option, "-warmup") == 0 ? &warmup_ms : NULL;
+        if (!target) {
+            fprintf(stderr, "Unknown bench option '%s'\n", option);
+            return NULL;
+        }
+        if ((*target = positive_arg(argv[i + 1])) == 0) {
+            return NULL;
+        }
+    }
+    SclshValue* script = argv[0];
+
+    // Warmup; the last batch alone took elapsed
+    uint64_t batch = 1;
+    uint64_t elapsed = 0;
+    uint64_t warmup_end = now_ns() + warmup_ms * 1000000u;
+    for (;;) {
+        uint64_t start = now_ns();
+        if (!eval_repeatedly(ctx, script, batch)) {
+            return NULL;
+        }
+        elapsed = now_ns() - start;
+        if (start + elapsed >= warmup_end) {
+            break;
+        }
+        batch *= 2;
+    }
+    double estimate = (double)elapsed / batch;
+    double per_sample = (double)time_ms * 1e6 / BENCH_SAMPLES;
+    batch = estimate > 0 && per_sample > estimate ? (uint64_t)(per_sample / estimate) : 1;
+
+    double samples[BENCH_SAMPLES];
+    uint64_t allocations = sclsh_value_allocation_count();
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = now_ns();
+        if (!eval_repeatedly(ctx, script, batch)) {
+            return NULL;
+        }
+        samples[i] = (double)(now_ns() - start) / batch;
+    }
+    allocations = sclsh_value_allocation_count() - allocations;
+    return bench_result(batch, samples, allocations);
+}
+
+void sclsh_register_profile_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "profile", cmd_profile, NULL, NULL);
+    sclsh_command_new(interp, "time", cmd_time, NULL, NULL);
+    sclsh_command_new(interp, "bench", cmd_bench, NULL, NULL);
+}
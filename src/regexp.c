@@ -0,0 +1,288 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/regexp.h>
+#include <sclsh/value.h>
+#include "value.h"
+#include "stats.h"
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Expressions with up to this many groups, the whole match included,
+// are matched without allocating room for the offsets
+#define STACK_GROUPS 16
+
+struct SclshRegex_s {
+    regex_t compiled;
+    int cflags;  // What it was compiled with
+};
+
+void sclsh_regex_free(SclshRegex* regex) {
+    if (regex) {
+        regfree(&regex->compiled);
+        free(regex);
+    }
+}
+
+// The expression compiled with cflags, cached on the value
+static SclshRegex* value_as_regex(SclshValue* value, int cflags) {
+    if (value->as_regex && value->as_regex->cflags == cflags) {
+        SCLSH_STAT(regex.hits);
+        return value->as_regex;
+    }
+    SCLSH_STAT(regex.conversions);
+    SclshRegex* regex = malloc(sizeof(SclshRegex));
+    if (!regex) {
+        return NULL;
+    }
+    char* pattern = sclsh_value_as_string(value).string;
+    int error = regcomp(&regex->compiled, pattern, cflags);
+    if (error) {
+        char message[256];
+        regerror(error, &regex->compiled, message, sizeof(message));
+        fprintf(stderr, "Bad regular expression '%s': %s\n", pattern, message);
+        free(regex);
+        return NULL;
+    }
+    regex->cflags = cflags;
+    sclsh_regex_free(value->as_regex);
+    value->as_regex = regex;
+    return regex;
+}
+
+typedef struct Options_s {
+    bool nocase;
+    bool all;
+    bool inline_matches;
+} Options;
+
+// Reads the options before the expression and sets *expression to its
+// index. Fails on an unknown option.
+static bool parse_options(size_t argc, SclshValue** argv, bool allow_inline, Options* options, size_t* expression) {
+    memset(options, 0, sizeof(Options));
+    size_t i = 0;
+    for (; i < argc; i++) {
+        char* option = sclsh_value_as_string(argv[i]).string;
+        if (option[0] != '-') {
+            break;
+        }
+        if (strcmp(option, "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(option, "-nocase") == 0) {
+            options->nocase = true;
+        } else if (strcmp(option, "-all") == 0) {
+            options->all = true;
+        } else if (allow_inline && strcmp(option, "-inline") == 0) {
+            options->inline_matches = true;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", option);
+            return false;
+        }
+    }
+    *expression = i;
+    return true;
+}
+
+static int cflags(const Options* options) {
+    return REG_EXTENDED | (options->nocase ? REG_ICASE : 0);
+}
+
+// Matches from start on, with offsets from the beginning of string;
+// REG_STARTEND also spares the null terminator that slices lack
+static bool match_at(SclshRegex* regex, SclshStringBuffer string, size_t start, regmatch_t* groups, size_t count) {
+    groups[0].rm_so = (regoff_t)start;
+    groups[0].rm_eo = (regoff_t)string.length;
+    int eflags = REG_STARTEND | (start > 0 ? REG_NOTBOL : 0);
+    return regexec(&regex->compiled, string.string, count, groups, eflags) == 0;
+}
+
+// Where to look for the next match: after this one, and one byte further
+// after an empty one so that it is not found again
+static size_t next_start(const regmatch_t* match) {
+    return (size_t)match->rm_eo + (match->rm_eo == match->rm_so);
+}
+
+// A group as a slice of the matched string, empty if it did not take part
+static SclshValue* group_value(SclshValue* subject, const regmatch_t* group) {
+    if (group->rm_so < 0) {
+        return sclsh_value_empty();
+    }
+    return sclsh_value_new_slice(subject, (size_t)group->rm_so, (size_t)(group->rm_eo - group->rm_so));
+}
+
+static regmatch_t* groups_for(SclshRegex* regex, regmatch_t* stack, size_t* count) {
+    *count = regex->compiled.re_nsub + 1;
+    return *count <= STACK_GROUPS ? stack : malloc(*count * sizeof(regmatch_t));
+}
+
+static SclshValue* cmd_regexp(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    Options options;
+    size_t i;
+    if (!parse_options(argc, argv, true, &options, &i)) {
+        return NULL;
+    }
+    if (argc - i < 2 || (options.inline_matches && argc - i > 2)) {
+        fprintf(stderr, "Usage: regexp ?-nocase? ?-all? ?-inline? ?--? <exp> <string> ?matchVar? ?subMatchVar ...?\n");
+        return NULL;
+    }
+    SclshRegex* regex = value_as_regex(argv[i], cflags(&options));
+    if (!regex) {
+        return NULL;
+    }
+    SclshValue* subject = argv[i + 1];
+    SclshValue** variables = argv + i + 2;
+    size_t variable_count = argc - i - 2;
+
+    regmatch_t stack[STACK_GROUPS];
+    size_t group_count;
+    regmatch_t* groups = groups_for(regex, stack, &group_count);
+    if (!groups) {
+        return NULL;
+    }
+    SclshListBuilder* list = options.inline_matches ? sclsh_list_builder_new() : NULL;
+    SclshStringBuffer string = sclsh_value_as_bytes(subject);
+    long long matches = 0;
+    size_t start = 0;
+    while (start <= string.length && match_at(regex, string, start, groups, group_count)) {
+        matches++;
+        for (size_t g = 0; list && g < group_count; g++) {
+            SclshValue* value = group_value(subject, &groups[g]);
+            sclsh_list_builder_append(list, value);
+            sclsh_value_unref(value);
+        }
+        // With -all the variables end up holding the last match
+        for (size_t v = 0; v < variable_count; v++) {
+            SclshValue* value = v < group_count ? group_value(subject, &groups[v]) : sclsh_value_empty();
+            sclsh_context_set_variable(ctx, sclsh_value_as_string(variables[v]).string, value);
+            sclsh_value_unref(value);
+        }
+        if (!options.all) {
+            break;
+        }
+        start = next_start(&groups[0]);
+    }
+    if (groups != stack) {
+        free(groups);
+    }
+
+    if (list) {
+        SclshValue* result = sclsh_list_builder_value(list);
+        sclsh_list_builder_free(list);
+        return result;
+    }
+    if (options.all) {
+        return sclsh_value_with_integer(NULL, matches);
+    }
+    return sclsh_value_boolean(matches > 0);
+}
+
+// Appends subSpec with & and \0 standing for the match and \1 to \9 for
+// its groups; \& and \\ are a literal & and backslash
+static void append_substitution(SclshStringBuilder* sb, SclshStringBuffer spec, SclshStringBuffer string,
+                                const regmatch_t* groups, size_t group_count) {
+    size_t run = 0;
+    for (size_t i = 0; i < spec.length; i++) {
+        char ch = spec.string[i];
+        int group = -1;
+        size_t skip = 1;
+        if (ch == '&') {
+            group = 0;
+        } else if (ch == '\\' && i + 1 < spec.length) {
+            char next = spec.string[i + 1];
+            if (next >= '0' && next <= '9') {
+                group = next - '0';
+                skip = 2;
+            } else if (next == '&' || next == '\\') {
+                sclsh_string_builder_append_bytes(sb, spec.string + run, i - run);
+                run = i + 1;  // The escaped character starts the next run
+                i++;
+                continue;
+            }
+        }
+        if (group < 0) {
+            continue;
+        }
+        sclsh_string_builder_append_bytes(sb, spec.string + run, i - run);
+        if ((size_t)group < group_count && groups[group].rm_so >= 0) {
+            sclsh_string_builder_append_bytes(sb, string.string + groups[group].rm_so,
+                                              (size_t)(groups[group].rm_eo - groups[group].rm_so));
+        }
+        i += skip - 1;
+        run = i + 1;
+    }
+    sclsh_string_builder_append_bytes(sb, spec.string + run, spec.length - run);
+}
+
+static SclshValue* cmd_regsub(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    Options options;
+    size_t i;
+    if (!parse_options(argc, argv, false, &options, &i)) {
+        return NULL;
+    }
+    if (argc - i != 3 && argc - i != 4) {
+        fprintf(stderr, "Usage: regsub ?-nocase? ?-all? ?--? <exp> <string> <subSpec> ?varName?\n");
+        return NULL;
+    }
+    SclshRegex* regex = value_as_regex(argv[i], cflags(&options));
+    if (!regex) {
+        return NULL;
+    }
+    SclshValue* subject = argv[i + 1];
+    SclshStringBuffer spec = sclsh_value_as_bytes(argv[i + 2]);
+
+    regmatch_t stack[STACK_GROUPS];
+    size_t group_count;
+    regmatch_t* groups = groups_for(regex, stack, &group_count);
+    if (!groups) {
+        return NULL;
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(subject);
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    long long count = 0;
+    size_t copied = 0;
+    size_t start = 0;
+    while (start <= string.length && match_at(regex, string, start, groups, group_count)) {
+        count++;
+        sclsh_string_builder_append_bytes(sb, string.string + copied, (size_t)groups[0].rm_so - copied);
+        append_substitution(sb, spec, string, groups, group_count);
+        copied = (size_t)groups[0].rm_eo;
+        if (!options.all) {
+            break;
+        }
+        start = next_start(&groups[0]);
+    }
+    if (groups != stack) {
+        free(groups);
+    }
+
+    SclshValue* result;
+    if (count == 0) {
+        result = sclsh_value_ref(subject);
+    } else {
+        sclsh_string_builder_append_bytes(sb, string.string + copied, string.length - copied);
+        result = sclsh_string_builder_to_value(sb);
+    }
+    sclsh_string_builder_free(sb);
+    if (argc - i == 4) {
+        sclsh_context_set_variable(ctx, sclsh_value_as_string(argv[i + 3]).string, result);
+        sclsh_value_unref(result);
+        return sclsh_value_with_integer(NULL, count);
+    }
+    return result;
+}
+
+void sclsh_register_regexp_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "regexp", cmd_regexp, NULL, NULL);
+    sclsh_command_new(interp, "regsub", cmd_regsub, NULL, NULL);
+}
@@ -0,0 +1,361 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/profile.h>
+#include <sclsh/util.h>
+#include "interp.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+/* Sampling profiler.
+ *
+ * The dispatcher keeps a stack of the names of the commands that are
+ * running, in the same way as the per-command profile tracks its
+ * invocations. A CPU-time timer of the sampling thread raises SIGPROF,
+ * whose handler copies that stack into a ring buffer; the ring is drained
+ * into counts per distinct stack outside of the handler. Only one
+ * interpreter per process can sample at a time.
+ */
+
+#define RING_SIZE 65536  // Words, a power of two
+#define MAX_SAMPLE_DEPTH 512  // Deeper stacks lose their innermost frames
+#define TRUNCATED 0  // Name id marking a truncated stack
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid  // Not spelled out by older C libraries
+#endif
+
+struct SclshSampler_s {
+    // Read by the signal handler
+    uint32_t* ids;  // Name of every running command, outermost first
+    volatile size_t depth;
+    uint32_t ring[RING_SIZE];  // Samples: depth followed by that many ids
+    volatile size_t head;  // Written by the handler only
+    volatile size_t tail;  // Written by drain only
+    volatile size_t dropped;
+
+    // Only used outside of the handler
+    const void** runs;  // Run and level of every entry, as in profile.c
+    size_t* levels;
+    size_t capacity;
+    char** names;  // Interned command names, id - 1
+    size_t name_count;
+    size_t name_capacity;
+    SclshHashMap* name_ids;  // Name -> id, for words that are not commands
+    SclshHashMap* stacks;  // Collapsed stack -> uint64_t count
+    timer_t timer;
+    bool timer_armed;
+    struct sigaction previous_action;
+};
+
+static SclshSampler* volatile active_sampler = NULL;
+
+static void on_sigprof(int sig, siginfo_t* info, void* ucontext) {
+    (void)sig; (void)info; (void)ucontext; // Suppress unused parameter warnings
+    SclshSampler* sampler = active_sampler;
+    if (!sampler) {
+        return;
+    }
+    size_t depth = sampler->depth;
+    size_t recorded = depth > MAX_SAMPLE_DEPTH ? MAX_SAMPLE_DEPTH : depth;
+    size_t words = 1 + recorded + (depth > recorded);
+    size_t head = sampler->head;
+    if (RING_SIZE - (head - sampler->tail) < words) {
+        sampler->dropped++;
+        return;
+    }
+    sampler->ring[head++ % RING_SIZE] = (uint32_t)(words - 1);
+    for (size_t i = 0; i < recorded; i++) {
+        sampler->ring[head++ % RING_SIZE] = sampler->ids[i];
+    }
+    if (depth > recorded) {
+        sampler->ring[head++ % RING_SIZE] = TRUNCATED;
+    }
+    __atomic_signal_fence(__ATOMIC_RELEASE);
+    sampler->head = head;
+}
+
+static SclshSampler* sampler_new(void) {
+    SclshSampler* sampler = calloc(1, sizeof(SclshSampler));
+    if (!sampler) {
+        return NULL;
+    }
+    sampler->name_ids = sclsh_hash_map_new();
+    sampler->stacks = sclsh_hash_map_new();
+    return sampler;
+}
+
+static void free_count(const char* key, void* value, void* user_data) {
+    (void)key; (void)user_data; // Suppress unused parameter warnings
+    free(value);
+}
+
+void sclsh_sampler_free(SclshSampler* sampler) {
+    if (!sampler) {
+        return;
+    }
+    if (active_sampler == sampler) {
+        active_sampler = NULL;
+    }
+    if (sampler->timer_armed) {
+        timer_delete(sampler->timer);
+        sigaction(SIGPROF, &sampler->previous_action, NULL);
+    }
+    for (size_t i = 0; i < sampler->name_count; i++) {
+        free(sampler->names[i]);
+    }
+    free(sampler->names);
+    sclsh_hash_map_free(sampler->name_ids);
+    sclsh_hash_map_for_each(sampler->stacks, free_count, NULL);
+    sclsh_hash_map_free(sampler->stacks);
+    free(sampler->ids);
+    free(sampler->runs);
+    free(sampler->levels);
+    free(sampler);
+}
+
+// Semicolons separate frames in the collapsed format
+static uint32_t intern(SclshSampler* sampler, const char* name) {
+    if (sampler->name_count == sampler->name_capacity) {
+        size_t capacity = sampler->name_capacity ? sampler->name_capacity * 2 : 64;
+        char** names = realloc(sampler->names, sizeof(char*) * capacity);
+        if (!names) {
+            return TRUNCATED;
+        }
+        sampler->names = names;
+        sampler->name_capacity = capacity;
+    }
+    char* copy = strdup(name);
+    if (!copy) {
+        return TRUNCATED;
+    }
+    for (char* c = copy; *c; c++) {
+        if (*c == ';' || *c == '\n') {
+            *c = '_';
+        }
+    }
+    sampler->names[sampler->name_count++] = copy;
+    return (uint32_t)sampler->name_count;
+}
+
+// Grows the stacks with SIGPROF blocked, the handler reads ids
+static bool grow(SclshSampler* sampler) {
+    size_t capacity = sampler->capacity ? sampler->capacity * 2 : 64;
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    uint32_t* ids = realloc(sampler->ids, sizeof(uint32_t) * capacity);
+    if (ids) {
+        sampler->ids = ids;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    const void** runs = realloc(sampler->runs, sizeof(void*) * capacity);
+    if (runs) {
+        sampler->runs = runs;
+    }
+    size_t* levels = realloc(sampler->levels, sizeof(size_t) * capacity);
+    if (levels) {
+        sampler->levels = levels;
+    }
+    if (!ids || !runs || !levels) {
+        return false;
+    }
+    sampler->capacity = capacity;
+    return true;
+}
+
+static void drain(SclshSampler* sampler);
+
+void sclsh_sampler_enter(SclshSampler* sampler, SclshCommand* command, const char* name, const void* run) {
+    uint32_t id;
+    if (command) {
+        if (command->sample_id == 0) {
+            command->sample_id = intern(sampler, command->name);
+        }
+        id = command->sample_id;
+    } else {
+        // Programs are run by name, which is rarely worth caching
+        id = (uint32_t)(uintptr_t)sclsh_hash_map_get(sampler->name_ids, name);
+        if (id == 0) {
+            id = intern(sampler, name);
+            sclsh_hash_map_set(sampler->name_ids, name, (void*)(uintptr_t)id);
+        }
+    }
+    if (sampler->depth == sampler->capacity && !grow(sampler)) {
+        return;
+    }
+    size_t depth = sampler->depth;
+    sampler->ids[depth] = id;
+    sampler->runs[depth] = run;
+    sampler->levels[depth] = SIZE_MAX;  // Running in C
+    __atomic_signal_fence(__ATOMIC_RELEASE);
+    sampler->depth = depth + 1;
+
+    if (sampler->head - sampler->tail > RING_SIZE / 2) {
+        drain(sampler);
+    }
+}
+
+void sclsh_sampler_pending(SclshSampler* sampler, const void* run, size_t level) {
+    if (sampler->depth > 0 && sampler->runs[sampler->depth - 1] == run) {
+        sampler->levels[sampler->depth - 1] = level;
+    }
+}
+
+void sclsh_sampler_complete(SclshSampler* sampler, const void* run, size_t level) {
+    size_t depth = sampler->depth;
+    while (depth > 0 && sampler->runs[depth - 1] == run && sampler->levels[depth - 1] > level) {
+        depth--;
+    }
+    sampler->depth = depth;
+}
+
+// Adds the samples in the ring to the counts per stack
+static void drain(SclshSampler* sampler) {
+    size_t head = sampler->head;
+    __atomic_signal_fence(__ATOMIC_ACQUIRE);
+    size_t tail = sampler->tail;
+    while (tail != head) {
+        SclshStringBuilder* sb = sclsh_string_builder_new();
+        size_t count = sampler->ring[tail++ % RING_SIZE];
+        for (size_t i = 0; i < count; i++) {
+            uint32_t id = sampler->ring[tail++ % RING_SIZE];
+            if (i > 0) {
+                sclsh_string_builder_append_str(sb, ";");
+            }
+            sclsh_string_builder_append_str(sb, id == TRUNCATED ? "..." : sampler->names[id - 1]);
+        }
+        if (count == 0) {
+            sclsh_string_builder_append_str(sb, "(top)");  // Between commands
+        }
+        char* key = sclsh_string_builder_value(sb).string;
+        sclsh_string_builder_free(sb);
+        uint64_t* total = sclsh_hash_map_get(sampler->stacks, key);
+        if (!total) {
+            total = calloc(1, sizeof(uint64_t));
+            if (total) {
+                sclsh_hash_map_set(sampler->stacks, key, total);
+            }
+        }
+        if (total) {
+            (*total)++;
+        }
+        free(key);
+    }
+    sampler->tail = tail;
+}
+
+int sclsh_sample_start(SclshInterpreter* interp, unsigned rate_hz) {
+    if (!interp || rate_hz == 0 || rate_hz > 1000000) {
+        return 0;
+    }
+    if (active_sampler) {
+        fprintf(stderr, "Another interpreter is already sampling\n");
+        return 0;
+    }
+    if (!interp->sampler) {
+        interp->sampler = sampler_new();
+        if (!interp->sampler) {
+            return 0;
+        }
+    }
+    SclshSampler* sampler = interp->sampler;
+    sampler->head = sampler->tail = 0;
+    sampler->dropped = 0;
+    sampler->depth = 0;
+    sclsh_hash_map_for_each(sampler->stacks, free_count, NULL);
+    sclsh_hash_map_free(sampler->stacks);
+    sampler->stacks = sclsh_hash_map_new();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &sampler->previous_action) < 0) {
+        fprintf(stderr, "Cannot install the SIGPROF handler: %s\n", strerror(errno));
+        return 0;
+    }
+
+    // CPU time of this thread, delivered to this thread
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &sampler->timer) < 0) {
+        fprintf(stderr, "Cannot create the sampling timer: %s\n", strerror(errno));
+        sigaction(SIGPROF, &sampler->previous_action, NULL);
+        return 0;
+    }
+
+    // At 1 Hz the period is a whole second, which tv_nsec cannot hold
+    long period_ns = 1000000000L / rate_hz;
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = period_ns / 1000000000L;
+    interval.it_interval.tv_nsec = period_ns % 1000000000L;
+    interval.it_value = interval.it_interval;
+    active_sampler = sampler;
+    if (timer_settime(sampler->timer, 0, &interval, NULL) < 0) {
+        fprintf(stderr, "Cannot start the sampling timer: %s\n", strerror(errno));
+        active_sampler = NULL;
+        timer_delete(sampler->timer);
+        sigaction(SIGPROF, &sampler->previous_action, NULL);
+        return 0;
+    }
+    sampler->timer_armed = true;
+    interp->sampling = sampler;
+    interp->instrumented = true;
+    return 1;
+}
+
+void sclsh_sample_stop(SclshInterpreter* interp) {
+    if (!interp || !interp->sampling) {
+        return;
+    }
+    SclshSampler* sampler = interp->sampling;
+    timer_delete(sampler->timer);
+    sampler->timer_armed = false;
+    active_sampler = NULL;
+    sigaction(SIGPROF, &sampler->previous_action, NULL);
+    interp->sampling = NULL;
+    interp->instrumented = interp->profiling != NULL;
+    drain(sampler);
+    sampler->depth = 0;
+}
+
+static void write_stack(const char* key, void* value, void* user_data) {
+    SclshStringBuilder* sb = user_data;
+    char count[32];
+    snprintf(count, sizeof(count), " %llu\n", (unsigned long long)*(uint64_t*)value);
+    sclsh_string_builder_append_str(sb, key);
+    sclsh_string_builder_append_str(sb, count);
+}
+
+SclshValue* sclsh_sample_collapsed(SclshInterpreter* interp) {
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    SclshSampler* sampler = interp ? interp->sampler : NULL;
+    if (sampler) {
+        drain(sampler);
+        sclsh_hash_map_for_each(sampler->stacks, write_stack, sb);
+    }
+    SclshValue* collapsed = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    return collapsed;
+}
+
+size_t sclsh_sample_dropped(SclshInterpreter* interp) {
+    return interp && interp->sampler ? interp->sampler->dropped : 0;
+}
@@ -6,27 +6,35 @@
 #include <sclsh/sclsh.h>
 #include <sclsh/ast.h>
 #include <sclsh/util.h>
+#include <sclsh/cache.h>
+#include <sclsh/exec.h>
+#include <sclsh/vm.h>
+#include "value.h"
+#include "interp.h"
+#include "code.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-struct SclshInterpreter_s {
-    SclshContext* global_context;
-    SclshHashMap* commands;
-};
-
-struct SclshCommand_s {
-    char* name;  // Command name
-    SclshCommandFunc func;  // Function to execute the command
-    void* user_data;  // User data for the command
-    SclshUserDataDestructor* user_data_destructor;  // Destructor for user data
-};
+#include <unistd.h>
 
 SclshInterpreter* sclsh_create_interpreter(void) {
     SclshInterpreter* interp = malloc(sizeof(SclshInterpreter));
     if (!interp) return NULL;
 
     interp->commands = sclsh_hash_map_new();
+    interp->path_cache = NULL;
+    interp->output = sclsh_output_new_fd(STDOUT_FILENO);
+    interp->channels = NULL;
+    interp->events = NULL;
+    interp->execution = NULL;
+    interp->spare_executions = NULL;
+    interp->spare_execution_count = 0;
+    interp->recursion_limit = SCLSH_DEFAULT_RECURSION_LIMIT;
+    interp->profile = NULL;
+    interp->profiling = NULL;
+    interp->sampler = NULL;
+    interp->sampling = NULL;
+    interp->instrumented = false;
     interp->global_context = sclsh_create_context(interp);
     if (!interp->global_context) {
         free(interp);
@@ -47,9 +55,17 @@ void free_command(const char* key, void* value, void* user_data) {
 
 void sclsh_destroy_interpreter(SclshInterpreter* interp) {
     if (interp) {
-        sclsh_destroy_context(interp->global_context);
+        // Commands go first, suspended coroutines may still refer to variables
         sclsh_hash_map_for_each(interp->commands, free_command, NULL);
         sclsh_hash_map_free(interp->commands);
+        sclsh_destroy_context(interp->global_context);
+        sclsh_spare_executions_free(interp);
+        sclsh_path_cache_free(interp->path_cache);
+        sclsh_event_loop_free(interp->events);
+        sclsh_channel_table_free(interp->channels);
+        sclsh_output_free(interp->output);
+        sclsh_profile_free(interp->profile);
+        sclsh_sampler_free(interp->sampler);
         free(interp);
     }
 }
@@ -74,11 +90,28 @@ SclshCommand* sclsh_command_new(
     command->func = func;
     command->user_data = user_data;
     command->user_data_destructor = user_data_destructor;
+    command->sample_id = 0;
 
+    SclshCommand* previous = sclsh_hash_map_get(interp->commands, name);
     sclsh_hash_map_set(interp->commands, command->name, command);
+    if (previous) {
+        free_command(previous->name, previous, NULL);  // Redefinition replaces the command
+    }
     return command;
 }
 
+void sclsh_command_delete(SclshInterpreter* interp, const char* name) {
+    if (!interp || !name) {
+        return;
+    }
+    SclshCommand* command = sclsh_hash_map_get(interp->commands, name);
+    if (!command) {
+        return;
+    }
+    sclsh_hash_map_remove(interp->commands, command->name);
+    free_command(command->name, command, NULL);
+}
+
 SclshCommand* sclsh_get_command(SclshInterpreter* interp, const char* name) {
     if (!interp || !name) {
         return NULL;
@@ -86,6 +119,13 @@ SclshCommand* sclsh_get_command(SclshInterpreter* interp, const char* name) {
     return (SclshCommand*)sclsh_hash_map_get(interp->commands, name);
 }
 
+SclshCommand* sclsh_get_command_buffer(SclshInterpreter* interp, SclshStringBuffer name) {
+    if (!interp) {
+        return NULL;
+    }
+    return (SclshCommand*)sclsh_hash_map_get_buffer(interp->commands, name);
+}
+
 SclshContext* sclsh_global_context(SclshInterpreter* interp) {
     if (interp) {
         return interp->global_context;
@@ -93,11 +133,6 @@ SclshContext* sclsh_global_context(SclshInterpreter* interp) {
     return NULL;
 }
 
-struct SclshContext_s {
-    SclshInterpreter* interp;  // Pointer to the interpreter
-    SclshHashMap* variables;  // Hash map for storing variables
-};
-
 SclshContext* sclsh_create_context(SclshInterpreter* interp) {
     SclshContext* ctx = malloc(sizeof(SclshContext));
     if (!ctx) return NULL;
@@ -109,6 +144,8 @@ SclshContext* sclsh_create_context(SclshInterpreter* interp) {
     }
 
     ctx->interp = interp;
+    ctx->proc = NULL;
+    ctx->locals = NULL;
 
     return ctx;
 }
@@ -120,73 +157,154 @@ void sclsh_destroy_context(SclshContext* ctx) {
     if (!ctx) {
         return;
     }
-    sclsh_hash_map_for_each(ctx->variables, free_variable, NULL);
-    sclsh_hash_map_free(ctx->variables);
+    sclsh_context_clear(ctx);
     free(ctx);
 }
 
+void sclsh_context_clear(SclshContext* ctx) {
+    if (ctx->proc) {
+        for (size_t i = 0; i < ctx->proc->local_count; i++) {
+            sclsh_value_unref(ctx->locals[i]);
+        }
+    }
+    if (ctx->variables) {
+        sclsh_hash_map_for_each(ctx->variables, free_variable, NULL);
+        sclsh_hash_map_free(ctx->variables);
+        ctx->variables = NULL;
+    }
+}
+
 void sclsh_context_set_variable(SclshContext* ctx, const char* name, SclshValue* value) {
     if (!ctx || !name || !value) {
         return;
     }
+    long slot = ctx->proc ? sclsh_proc_slot(ctx->proc, name, false) : -1;
+    if (slot >= 0) {
+        SclshValue* old_value = ctx->locals[slot];
+        ctx->locals[slot] = sclsh_value_ref(value);
+        sclsh_value_unref(old_value);
+        return;  // Procedure locals are never watched by vwait
+    }
+    if (!ctx->variables) {
+        ctx->variables = sclsh_hash_map_new();
+    }
+    SclshValue* old_value = sclsh_hash_map_get(ctx->variables, name);
     sclsh_value_ref(value);  // Increment reference count
     sclsh_hash_map_set(ctx->variables, name, value);
+    sclsh_value_unref(old_value);
+    if (ctx->interp->events && ctx == ctx->interp->global_context) {
+        sclsh_event_note_variable(ctx->interp->events, name);
+    }
 }
 SclshValue* sclsh_context_get_variable(SclshContext* ctx, const char* name) {
     if (!ctx || !name) {
         return NULL;
     }
-    return (SclshValue*)sclsh_hash_map_get(ctx->variables, name);
+    long slot = ctx->proc ? sclsh_proc_slot(ctx->proc, name, false) : -1;
+    if (slot >= 0) {
+        return ctx->locals[slot];
+    }
+    return ctx->variables ? (SclshValue*)sclsh_hash_map_get(ctx->variables, name) : NULL;
+}
+
+SclshInterpreter* sclsh_context_interpreter(SclshContext* ctx) {
+    return ctx ? ctx->interp : NULL;
+}
+
+typedef struct VariableIteration_s {
+    SclshVariableCallback callback;
+    void* user_data;
+} VariableIteration;
+
+static void visit_variable(const char* key, void* value, void* user_data) {
+    VariableIteration* iteration = user_data;
+    iteration->callback(key, (SclshValue*)value, iteration->user_data);
 }
 
-static SclshValue* eval_node(
-    SclshContext* ctx, 
-    SclshNode* node
+void sclsh_context_for_each_variable(
+    SclshContext* ctx,
+    SclshVariableCallback callback,
+    void* user_data
 ) {
-    if (!ctx || !node || !node->value) {
-        return NULL;
+    if (!ctx || !callback) {
+        return;
     }
-    if (node->type == SCLSH_WORD_VARIABLE) {
-        SclshStringBuffer str_buf = sclsh_value_as_string(node->value);
-        return sclsh_context_get_variable(ctx, str_buf.string);
-    } else if (node->type == SCLSH_WORD_BRACE) {
-        return sclsh_eval(ctx, node->value);  // Evaluate brace expressions
-    } else {
-        return node->value;
+    if (ctx->proc) {
+        for (size_t i = 0; i < ctx->proc->local_count; i++) {
+            if (ctx->locals[i]) {
+                callback(ctx->proc->local_names[i], ctx->locals[i], user_data);
+            }
+        }
+    }
+    if (ctx->variables) {
+        VariableIteration iteration = { .callback = callback, .user_data = user_data };
+        sclsh_hash_map_for_each(ctx->variables, visit_variable, &iteration);
     }
 }
 
-SclshValue* sclsh_eval(SclshContext* ctx, SclshValue* ast) {
-    if (!ctx || !ast) {
+// Substitutes into the template of a quoted word, see parse.c
+static SclshValue* eval_interpolation(SclshContext* ctx, SclshValue* word) {
+    SclshNodeList* segments = sclsh_value_as_interpolation(word);
+    if (!segments) {
         return NULL;
     }
-
-    SclshNodeList* node_list = sclsh_value_as_command_line(ast);
-    if (!node_list) {
-        return NULL;  // Failed to parse as command line
+    if (segments->count <= 1) {
+        return segments->count ? sclsh_eval_word(ctx, &segments->nodes[0]) : sclsh_value_empty();
     }
-
-    if (node_list->count == 0) {
-        return sclsh_value_new("", 0);
+    SclshValue** values = malloc(sizeof(SclshValue*) * segments->count);
+    if (!values) {
+        return NULL;
     }
-
-    char* cmd = sclsh_value_as_string(node_list->nodes[0].value).string;
-    SclshCommand* command = sclsh_get_command(ctx->interp, cmd);
-    if (!command) {
-        fprintf(stderr, "Command '%s' not found\n", cmd);
-        return NULL;  // Command not found
+    size_t count = 0;
+    SclshValue* result = NULL;
+    for (; count < segments->count; count++) {
+        values[count] = sclsh_eval_word(ctx, &segments->nodes[count]);
+        if (!values[count]) {
+            goto out;
+        }
+    }
+    result = sclsh_value_concat(values, count);
+out:
+    for (size_t i = 0; i < count; i++) {
+        sclsh_value_unref(values[i]);
     }
+    free(values);
+    return result;
+}
 
-    SclshValue** args = malloc(sizeof(SclshValue*) * (node_list->count - 1));
-    if (!args) {
-        fprintf(stderr, "Memory allocation failed for command arguments\n");
-        return NULL;  // Memory allocation failed
+SclshValue* sclsh_eval_word(SclshContext* ctx, SclshNode* node) {
+    if (!ctx || !node || !node->value) {
+        return NULL;
     }
-    for (size_t i = 1; i < node_list->count; i++) {
-        args[i - 1] = eval_node(ctx, &node_list->nodes[i]);
+    if (node->type == SCLSH_WORD_QUOTED) {
+        return eval_interpolation(ctx, node->value);
+    }
+    if (node->type == SCLSH_WORD_VARIABLE) {
+        SclshStringBuffer str_buf = sclsh_value_as_string(node->value);
+        SclshValue* value = sclsh_context_get_variable(ctx, str_buf.string);
+        if (!value) {
+            fprintf(stderr, "Variable '%s' not found\n", str_buf.string);
+            return NULL;
+        }
+        return sclsh_value_ref(value);
+    } else if (node->type == SCLSH_WORD_BRACKET) {
+        return sclsh_eval_script(ctx, node->value);  // Command substitution
+    } else {
+        return sclsh_value_ref(node->value);  // Braced and bare words are literal
     }
-    SclshValue* result = command->func(ctx, node_list->count - 1, args, command->user_data);
-    free(args);  // Free the arguments array
+}
+
+// sclsh_eval and sclsh_eval_script compile the script and run it, see vm.c
 
+SclshValue* sclsh_eval_file(SclshContext* ctx, const char* path) {
+    if (!ctx || !path) {
+        return NULL;
+    }
+    SclshValue* script = sclsh_cache_load_script(path);
+    if (!script) {
+        return NULL;
+    }
+    SclshValue* result = sclsh_eval_script(ctx, script);
+    sclsh_value_unref(script);
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,217 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "serialize.h"
+#include "value.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VALUE_HAS_COMMAND_LINE 1
+#define VALUE_HAS_SCRIPT 2
+
+// Nesting deeper than this in an image is treated as corruption
+#define MAX_VALUE_DEPTH 256
+
+void sclsh_serialize_u32(SclshStringBuilder* sb, uint32_t value) {
+    sclsh_string_builder_append_bytes(sb, (const char*)&value, sizeof(value));
+}
+
+void sclsh_serialize_u64(SclshStringBuilder* sb, uint64_t value) {
+    sclsh_string_builder_append_bytes(sb, (const char*)&value, sizeof(value));
+}
+
+void sclsh_serialize_bytes(SclshStringBuilder* sb, const char* bytes, size_t length) {
+    sclsh_serialize_u32(sb, (uint32_t)length);
+    sclsh_string_builder_append_bytes(sb, bytes, length);
+}
+
+static void serialize_node_list(SclshStringBuilder* sb, SclshNodeList* node_list) {
+    sclsh_serialize_u32(sb, (uint32_t)node_list->count);
+    for (size_t i = 0; i < node_list->count; i++) {
+        sclsh_serialize_u32(sb, (uint32_t)node_list->nodes[i].type);
+        sclsh_serialize_value(sb, node_list->nodes[i].value);
+    }
+}
+
+void sclsh_serialize_value(SclshStringBuilder* sb, SclshValue* value) {
+    uint32_t flags = 0;
+    if (value->as_command_line) {
+        flags |= VALUE_HAS_COMMAND_LINE;
+    }
+    if (value->as_proc) {
+        flags |= VALUE_HAS_SCRIPT;
+    }
+    sclsh_serialize_u32(sb, flags);
+    sclsh_serialize_bytes(sb, value->string, value->length);
+
+    if (value->as_command_line) {
+        serialize_node_list(sb, value->as_command_line);
+    }
+    if (value->as_proc) {
+        sclsh_serialize_u32(sb, (uint32_t)value->as_proc->count);
+        for (size_t i = 0; i < value->as_proc->count; i++) {
+            sclsh_serialize_value(sb, value->as_proc->items[i]);
+        }
+    }
+}
+
+uint32_t sclsh_reader_u32(SclshReader* reader) {
+    uint32_t value = 0;
+    if (reader->error || reader->end - reader->pos < (ptrdiff_t)sizeof(value)) {
+        reader->error = 1;
+        return 0;
+    }
+    memcpy(&value, reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    return value;
+}
+
+uint64_t sclsh_reader_u64(SclshReader* reader) {
+    uint64_t value = 0;
+    if (reader->error || reader->end - reader->pos < (ptrdiff_t)sizeof(value)) {
+        reader->error = 1;
+        return 0;
+    }
+    memcpy(&value, reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    return value;
+}
+
+SclshStringBuffer sclsh_reader_bytes(SclshReader* reader) {
+    SclshStringBuffer buffer = { .string = NULL, .length = 0 };
+    uint32_t length = sclsh_reader_u32(reader);
+    if (reader->error || (size_t)(reader->end - reader->pos) < length) {
+        reader->error = 1;
+        return buffer;
+    }
+    buffer.string = (char*)reader->pos;
+    buffer.length = length;
+    reader->pos += length;
+    return buffer;
+}
+
+static SclshValue* string_value(SclshReader* reader, SclshStringBuffer string) {
+    if (reader->mapping && string.length >= SCLSH_INLINE_STRING) {
+        size_t offset = (size_t)(string.string - reader->mapping->string);
+        return sclsh_value_new_slice(reader->mapping, offset, string.length);
+    }
+    return sclsh_value_new(string.string, string.length);
+}
+
+SclshValue* sclsh_reader_string(SclshReader* reader) {
+    SclshStringBuffer string = sclsh_reader_bytes(reader);
+    return reader->error ? NULL : string_value(reader, string);
+}
+
+static SclshValue* read_value(SclshReader* reader, int depth);
+
+static SclshNodeList* read_node_list(SclshReader* reader, int depth) {
+    uint32_t count = sclsh_reader_u32(reader);
+    if (reader->error) {
+        return NULL;
+    }
+    SclshNodeListBuilder* builder = sclsh_node_list_builder_new();
+    for (uint32_t i = 0; i < count && !reader->error; i++) {
+        uint32_t type = sclsh_reader_u32(reader);
+        if (type > SCLSH_WORD_VARIABLE) {
+            reader->error = 1;
+            break;
+        }
+        SclshValue* value = read_value(reader, depth + 1);
+        if (value) {
+            sclsh_node_list_builder_append(builder, value, (SclshNodeType)type);
+            sclsh_value_unref(value);
+        }
+    }
+    SclshNodeList* node_list = reader->error ? NULL : sclsh_node_list_builder_value(builder);
+    sclsh_node_list_builder_free(builder);
+    return node_list;
+}
+
+static SclshValueList* read_script(SclshReader* reader, int depth) {
+    uint32_t count = sclsh_reader_u32(reader);
+    if (reader->error) {
+        return NULL;
+    }
+    SclshListBuilder* builder = sclsh_list_builder_new();
+    for (uint32_t i = 0; i < count && !reader->error; i++) {
+        SclshValue* value = read_value(reader, depth + 1);
+        if (value) {
+            sclsh_list_builder_append(builder, value);
+            sclsh_value_unref(value);
+        }
+    }
+    SclshValueList* list = reader->error ? NULL : sclsh_list_builder_value_list(builder);
+    sclsh_list_builder_free(builder);
+    return list;
+}
+
+static SclshValue* read_value(SclshReader* reader, int depth) {
+    if (depth > MAX_VALUE_DEPTH) {
+        reader->error = 1;
+        return NULL;
+    }
+    uint32_t flags = sclsh_reader_u32(reader);
+    SclshStringBuffer string = sclsh_reader_bytes(reader);
+    if (reader->error) {
+        return NULL;
+    }
+
+    SclshValue* value = string_value(reader, string);
+    if (flags & VALUE_HAS_COMMAND_LINE) {
+        value->as_command_line = read_node_list(reader, depth);
+    }
+    if (flags & VALUE_HAS_SCRIPT) {
+        value->as_proc = read_script(reader, depth);
+    }
+    if (reader->error) {
+        sclsh_value_unref(value);
+        return NULL;
+    }
+    return value;
+}
+
+SclshValue* sclsh_reader_value(SclshReader* reader) {
+    return read_value(reader, 0);
+}
+
+int sclsh_write_file_atomic(const char* path, SclshStringBuffer contents) {
+    size_t path_length = strlen(path);
+    char* tmp_path = malloc(path_length + 8);
+    if (!tmp_path) {
+        return 0;
+    }
+    memcpy(tmp_path, path, path_length);
+    memcpy(tmp_path + path_length, ".XXXXXX", 8);
+
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        free(tmp_path);
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < contents.length) {
+        ssize_t res = write(fd, contents.string + written, contents.length - written);
+        if (res <= 0) {
+            break;
+        }
+        written += (size_t)res;
+    }
+    int ok = close(fd) == 0 && written == contents.length;
+
+    // Readers either see the old file or the complete new one
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
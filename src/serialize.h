@@ -0,0 +1,44 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__INTERNAL_SERIALIZE
+#define H__SCLSH__INTERNAL_SERIALIZE
+
+#include <sclsh/value.h>
+#include <sclsh/ast.h>
+#include <sclsh/util.h>
+
+#include <stdint.h>
+
+/* Binary encoding shared by the script cache and interpreter images.
+ * Integers are stored in host byte order; files carry a magic number
+ * that doubles as a byte order check.
+ */
+
+void sclsh_serialize_u32(SclshStringBuilder* sb, uint32_t value);
+void sclsh_serialize_u64(SclshStringBuilder* sb, uint64_t value);
+void sclsh_serialize_bytes(SclshStringBuilder* sb, const char* bytes, size_t length);
+// Writes the string together with any parsed command line or script reps
+void sclsh_serialize_value(SclshStringBuilder* sb, SclshValue* value);
+
+typedef struct SclshReader_s {
+    const char* pos;
+    const char* end;
+    int error;  // Set once a read runs past the end or finds bad data
+    // The mapped value pos points into, if any. Strings read from it that
+    // are too long to keep inside a value are slices of it, not copies.
+    SclshValue* mapping;
+} SclshReader;
+
+uint32_t sclsh_reader_u32(SclshReader* reader);
+uint64_t sclsh_reader_u64(SclshReader* reader);
+SclshStringBuffer sclsh_reader_bytes(SclshReader* reader);
+// A value holding the next bytes, without reps
+SclshValue* sclsh_reader_string(SclshReader* reader);
+SclshValue* sclsh_reader_value(SclshReader* reader);
+
+int sclsh_write_file_atomic(const char* path, SclshStringBuffer contents);
+
+#endif
@@ -0,0 +1,78 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/stats.h>
+#include <sclsh/util.h>
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+#if SCLSH_STATS
+_Thread_local SclshStats sclsh_thread_stats SCLSH_TLS_MODEL;
+#endif
+
+void sclsh_stats_snapshot(SclshStats* stats) {
+#if SCLSH_STATS
+    *stats = sclsh_thread_stats;
+#else
+    memset(stats, 0, sizeof(SclshStats));
+#endif
+}
+
+void sclsh_stats_reset(void) {
+#if SCLSH_STATS
+    memset(&sclsh_thread_stats, 0, sizeof(SclshStats));
+#endif
+}
+
+uint64_t sclsh_stats_value_allocations(const SclshStats* stats) {
+    uint64_t created = stats->values_copied + stats->values_sliced + stats->values_mapped;
+    return created - stats->values_recycled + stats->values_copied - stats->strings_inline + stats->strings_grown;
+}
+
+static void append_counter(SclshStringBuilder* sb, const char* name, uint64_t count) {
+    char line[96];
+    snprintf(line, sizeof(line), "%s %llu\n", name, (unsigned long long)count);
+    sclsh_string_builder_append_str(sb, line);
+}
+
+static void append_rep(SclshStringBuilder* sb, const char* name, SclshRepStats rep) {
+    char field[64];
+    snprintf(field, sizeof(field), "%s_hits", name);
+    append_counter(sb, field, rep.hits);
+    snprintf(field, sizeof(field), "%s_conversions", name);
+    append_counter(sb, field, rep.conversions);
+}
+
+SclshValue* sclsh_stats_to_value(const SclshStats* stats) {
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    append_counter(sb, "values_copied", stats->values_copied);
+    append_counter(sb, "values_sliced", stats->values_sliced);
+    append_counter(sb, "values_mapped", stats->values_mapped);
+    append_counter(sb, "values_recycled", stats->values_recycled);
+    append_counter(sb, "strings_inline", stats->strings_inline);
+    append_counter(sb, "values_updated", stats->values_updated);
+    append_counter(sb, "strings_grown", stats->strings_grown);
+    append_counter(sb, "values_freed", stats->values_freed);
+    append_counter(sb, "slices_freed", stats->slices_freed);
+    append_counter(sb, "mappings_freed", stats->mappings_freed);
+    append_counter(sb, "slices_materialized", stats->slices_materialized);
+    append_counter(sb, "reps_dropped", stats->reps_dropped);
+    append_rep(sb, "list", stats->list);
+    append_rep(sb, "script", stats->script);
+    append_rep(sb, "command_line", stats->command_line);
+    append_rep(sb, "interpolation", stats->interpolation);
+    append_rep(sb, "code", stats->code);
+    append_rep(sb, "glob", stats->glob);
+    append_rep(sb, "regex", stats->regex);
+    append_rep(sb, "chars", stats->chars);
+    append_counter(sb, "hash_lookups", stats->hash_lookups);
+    append_counter(sb, "hash_probes", stats->hash_probes);
+    append_counter(sb, "hash_resizes", stats->hash_resizes);
+    append_counter(sb, "parsed_bytes", stats->parsed_bytes);
+    SclshValue* value = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    return value;
+}
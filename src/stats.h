@@ -0,0 +1,32 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef H__SCLSH__INTERNAL_STATS
+#define H__SCLSH__INTERNAL_STATS
+
+#include <sclsh/stats.h>
+
+#ifndef SCLSH_STATS
+#define SCLSH_STATS 1
+#endif
+
+// Initial-exec keeps an access to a thread-local a single instruction in
+// the shared library
+#if defined(__GNUC__)
+#define SCLSH_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+#define SCLSH_TLS_MODEL
+#endif
+
+#if SCLSH_STATS
+extern _Thread_local SclshStats sclsh_thread_stats SCLSH_TLS_MODEL;
+#define SCLSH_STAT(field) (sclsh_thread_stats.field++)
+#define SCLSH_STAT_ADD(field, n) (sclsh_thread_stats.field += (n))
+#else
+#define SCLSH_STAT(field) ((void)0)
+#define SCLSH_STAT_ADD(field, n) ((void)0)
+#endif
+
+#endif
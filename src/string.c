@@ -0,0 +1,681 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/string.h>
+#include <sclsh/glob.h>
+#include <sclsh/value.h>
+#include "value.h"
+#include "stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Every byte but a UTF-8 continuation byte starts a character
+static bool starts_char(char ch) {
+    return ((unsigned char)ch & 0xC0) != 0x80;
+}
+
+static bool is_ascii(const char* bytes, size_t length) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 64 <= length; i += 64) {
+        __m128i any = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i*)(bytes + i)), _mm_loadu_si128((const __m128i*)(bytes + i + 16))),
+            _mm_or_si128(_mm_loadu_si128((const __m128i*)(bytes + i + 32)), _mm_loadu_si128((const __m128i*)(bytes + i + 48))));
+        if (_mm_movemask_epi8(any)) {
+            return false;
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if ((unsigned char)bytes[i] & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t char_count(const char* bytes, size_t length) {
+    size_t count = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Continuation bytes are the signed chars from -128 to -65
+    const __m128i continuation = _mm_set1_epi8(-65);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes + i));
+        count += (size_t)__builtin_popcount((unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, continuation)));
+    }
+#endif
+    for (; i < length; i++) {
+        count += starts_char(bytes[i]);
+    }
+    return count;
+}
+
+// Byte offset of the character at index, the length if there is none
+static size_t char_offset(SclshStringBuffer string, size_t index) {
+    size_t i = 0;
+    for (; i < string.length; i++) {
+        if (starts_char(string.string[i])) {
+            if (index == 0) {
+                return i;
+            }
+            index--;
+        }
+    }
+    return i;
+}
+
+/* Characters of a string, cached on its value so that indexing does not
+ * scan it from the start every time. An ASCII string, whose characters
+ * are its bytes, shares ascii_chars and allocates nothing. Any other
+ * string gets the byte offset of every CHAR_STRIDEth character, which
+ * leaves fewer than CHAR_STRIDE characters to step over to any index.
+ */
+#define CHAR_STRIDE 64
+
+struct SclshChars_s {
+    size_t count;
+    size_t offsets[];  // Of characters 0, CHAR_STRIDE, 2 * CHAR_STRIDE...
+};
+
+static SclshChars ascii_chars;
+
+void sclsh_chars_free(SclshChars* chars) {
+    if (chars != &ascii_chars) {
+        free(chars);
+    }
+}
+
+// NULL only if the offsets could not be allocated
+static SclshChars* value_as_chars(SclshValue* value) {
+    if (value->as_chars) {
+        SCLSH_STAT(chars.hits);
+        return value->as_chars;
+    }
+    SCLSH_STAT(chars.conversions);
+    SclshStringBuffer string = sclsh_value_as_bytes(value);
+    if (is_ascii(string.string, string.length)) {
+        value->as_chars = &ascii_chars;
+        return value->as_chars;
+    }
+    size_t count = char_count(string.string, string.length);
+    SclshChars* chars = malloc(sizeof(SclshChars) + (count / CHAR_STRIDE + 1) * sizeof(size_t));
+    if (!chars) {
+        return NULL;
+    }
+    chars->count = count;
+    size_t index = 0;
+    for (size_t i = 0; i < string.length; i++) {
+        if (starts_char(string.string[i])) {
+            if (index % CHAR_STRIDE == 0) {
+                chars->offsets[index / CHAR_STRIDE] = i;
+            }
+            index++;
+        }
+    }
+    value->as_chars = chars;
+    return chars;
+}
+
+static size_t value_char_count(SclshValue* value) {
+    SclshStringBuffer string = sclsh_value_as_bytes(value);
+    SclshChars* chars = value_as_chars(value);
+    if (chars == &ascii_chars) {
+        return string.length;
+    }
+    return chars ? chars->count : char_count(string.string, string.length);
+}
+
+// Byte offset of the character at index in value, the length if there
+// is none
+static size_t value_char_offset(SclshValue* value, size_t index) {
+    SclshStringBuffer string = sclsh_value_as_bytes(value);
+    SclshChars* chars = value_as_chars(value);
+    if (chars == &ascii_chars) {
+        return index < string.length ? index : string.length;
+    }
+    if (!chars) {
+        return char_offset(string, index);
+    }
+    if (index >= chars->count) {
+        return string.length;
+    }
+    size_t start = chars->offsets[index / CHAR_STRIDE];
+    SclshStringBuffer rest = { string.string + start, string.length - start };
+    return start + char_offset(rest, index % CHAR_STRIDE);
+}
+
+// Index of the character starting at a byte offset in value
+static size_t value_char_index(SclshValue* value, size_t offset) {
+    SclshStringBuffer string = sclsh_value_as_bytes(value);
+    SclshChars* chars = value_as_chars(value);
+    if (chars == &ascii_chars) {
+        return offset;
+    }
+    if (!chars) {
+        return char_count(string.string, offset);
+    }
+    // The last offset recorded at or before this one
+    size_t low = 0;
+    size_t high = chars->count / CHAR_STRIDE + 1;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (middle * CHAR_STRIDE < chars->count && chars->offsets[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    size_t start = chars->offsets[low];
+    return low * CHAR_STRIDE + char_count(string.string + start, offset - start);
+}
+
+// Index of a character in a string of count characters: an integer, end
+// or end-N. It may well fall outside the string.
+static bool parse_index(SclshValue* value, size_t count, long long* index) {
+    char* string = sclsh_value_as_string(value).string;
+    char* digits = string;
+    long long base = 0;
+    if (strncmp(string, "end", 3) == 0) {
+        base = (long long)count - 1;
+        digits = string + 3;
+        if (*digits == '\0') {
+            *index = base;
+            return true;
+        }
+    }
+    char* end;
+    long long n = strtoll(digits, &end, 10);
+    if (end == digits || *end != '\0' || (digits != string && *digits != '-' && *digits != '+')) {
+        fprintf(stderr, "Bad index '%s': must be integer, end or end-N\n", string);
+        return false;
+    }
+    *index = base + n;
+    return true;
+}
+
+static SclshValue* integer_value(long long n) {
+    return sclsh_value_with_integer(NULL, n);
+}
+
+static int ascii_lower(char ch) {
+    return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : (unsigned char)ch;
+}
+
+// Copies length bytes, switching the case of the ASCII letters from
+// first to first + 25 and leaving every other byte alone
+static void switch_case(char* out, const char* in, size_t length, char first) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Bytes past ASCII are negative as signed chars and never in range
+    const __m128i below = _mm_set1_epi8((char)(first - 1));
+    const __m128i above = _mm_set1_epi8((char)(first + 26));
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(chunk, below), _mm_cmplt_epi8(chunk, above));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(chunk, _mm_and_si128(letters, case_bit)));
+    }
+#endif
+    for (; i < length; i++) {
+        char ch = in[i];
+        out[i] = ch >= first && ch <= first + 25 ? (char)(ch ^ 0x20) : ch;
+    }
+}
+
+// -1, 0 or 1 as a sorts before, with or after b
+static int compare_bytes(SclshStringBuffer a, SclshStringBuffer b, bool nocase) {
+    size_t common = a.length < b.length ? a.length : b.length;
+    int order = 0;
+    if (!nocase) {
+        order = memcmp(a.string, b.string, common);
+    } else {
+        for (size_t i = 0; i < common && order == 0; i++) {
+            order = ascii_lower(a.string[i]) - ascii_lower(b.string[i]);
+        }
+    }
+    if (order == 0) {
+        order = (a.length > b.length) - (a.length < b.length);
+    }
+    return (order > 0) - (order < 0);
+}
+
+static SclshValue* string_length(size_t argc, SclshValue** argv) {
+    (void)argc;
+    return integer_value((long long)value_char_count(argv[0]));
+}
+
+static SclshValue* string_index(size_t argc, SclshValue** argv) {
+    (void)argc;
+    size_t count = value_char_count(argv[0]);
+    long long index;
+    if (!parse_index(argv[1], count, &index)) {
+        return NULL;
+    }
+    if (index < 0 || index >= (long long)count) {
+        return sclsh_value_empty();
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[0]);
+    size_t start = value_char_offset(argv[0], (size_t)index);
+    size_t end = start + 1;
+    while (end < string.length && !starts_char(string.string[end])) {
+        end++;
+    }
+    return sclsh_value_new(string.string + start, end - start);
+}
+
+static SclshValue* string_range(size_t argc, SclshValue** argv) {
+    (void)argc;
+    size_t count = value_char_count(argv[0]);
+    long long first, last;
+    if (!parse_index(argv[1], count, &first) || !parse_index(argv[2], count, &last)) {
+        return NULL;
+    }
+    if (first < 0) {
+        first = 0;
+    }
+    if (last >= (long long)count) {
+        last = (long long)count - 1;
+    }
+    if (first > last) {
+        return sclsh_value_empty();
+    }
+    if (first == 0 && last == (long long)count - 1) {
+        return sclsh_value_ref(argv[0]);
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[0]);
+    size_t start = value_char_offset(argv[0], (size_t)first);
+    size_t end = value_char_offset(argv[0], (size_t)last + 1);
+    return sclsh_value_new(string.string + start, end - start);
+}
+
+// string first <needle> <haystack> ?start?
+static SclshValue* string_first(size_t argc, SclshValue** argv) {
+    SclshStringBuffer needle = sclsh_value_as_bytes(argv[0]);
+    SclshStringBuffer haystack = sclsh_value_as_bytes(argv[1]);
+    size_t from = 0;
+    if (argc == 3) {
+        long long start;
+        if (!parse_index(argv[2], value_char_count(argv[1]), &start)) {
+            return NULL;
+        }
+        from = start > 0 ? value_char_offset(argv[1], (size_t)start) : 0;
+    }
+    if (needle.length == 0 || from >= haystack.length) {
+        return integer_value(-1);
+    }
+    const char* found = memmem(haystack.string + from, haystack.length - from, needle.string, needle.length);
+    if (!found) {
+        return integer_value(-1);
+    }
+    return integer_value((long long)value_char_index(argv[1], (size_t)(found - haystack.string)));
+}
+
+// string last <needle> <haystack> ?last?
+static SclshValue* string_last(size_t argc, SclshValue** argv) {
+    SclshStringBuffer needle = sclsh_value_as_bytes(argv[0]);
+    SclshStringBuffer haystack = sclsh_value_as_bytes(argv[1]);
+    if (needle.length == 0 || needle.length > haystack.length) {
+        return integer_value(-1);
+    }
+    size_t limit = haystack.length - needle.length;  // Last byte a match may start at
+    if (argc == 3) {
+        long long last;
+        if (!parse_index(argv[2], value_char_count(argv[1]), &last)) {
+            return NULL;
+        }
+        if (last < 0) {
+            return integer_value(-1);
+        }
+        size_t offset = value_char_offset(argv[1], (size_t)last);
+        if (offset < limit) {
+            limit = offset;
+        }
+    }
+    // Candidates are found from the back by their first byte
+    size_t end = limit + 1;
+    while (end > 0) {
+        const char* candidate = memrchr(haystack.string, needle.string[0], end);
+        if (!candidate) {
+            break;
+        }
+        if (memcmp(candidate, needle.string, needle.length) == 0) {
+            return integer_value((long long)value_char_index(argv[1], (size_t)(candidate - haystack.string)));
+        }
+        end = (size_t)(candidate - haystack.string);
+    }
+    return integer_value(-1);
+}
+
+/* Replaces the keys of mapping, a list of key value pairs, in string by
+ * their values, trying the keys in order at each position. Bytes no key
+ * starts with, as told by starts, are taken in runs. Returns the length
+ * of the result and writes it to out unless that is NULL, which lets the
+ * caller size the result first.
+ */
+static size_t map_bytes(SclshValueList* mapping, const bool* starts, SclshStringBuffer string, char* out) {
+    size_t length = 0;
+    size_t i = 0;
+    while (i < string.length) {
+        size_t run = i;
+        while (run < string.length && !starts[(unsigned char)string.string[run]]) {
+            run++;
+        }
+        if (out) {
+            memcpy(out + length, string.string + i, run - i);
+        }
+        length += run - i;
+        i = run;
+        if (i == string.length) {
+            break;
+        }
+
+        SclshStringBuffer key = { NULL, 0 };
+        size_t k;
+        for (k = 0; k < mapping->count; k += 2) {
+            key = sclsh_value_as_bytes(mapping->items[k]);
+            if (key.length > 0 && key.length <= string.length - i
+                && memcmp(string.string + i, key.string, key.length) == 0) {
+                break;
+            }
+        }
+        if (k < mapping->count) {
+            SclshStringBuffer replacement = sclsh_value_as_bytes(mapping->items[k + 1]);
+            if (out) {
+                memcpy(out + length, replacement.string, replacement.length);
+            }
+            length += replacement.length;
+            i += key.length;
+        } else {
+            if (out) {
+                out[length] = string.string[i];
+            }
+            length++;
+            i++;
+        }
+    }
+    return length;
+}
+
+static SclshValue* string_map(size_t argc, SclshValue** argv) {
+    (void)argc;
+    SclshValueList* mapping = sclsh_value_as_list(argv[0]);
+    if (!mapping || mapping->count % 2 != 0) {
+        fprintf(stderr, "string map: mapping must be a list of key value pairs\n");
+        return NULL;
+    }
+    bool starts[256] = { false };
+    bool any = false;
+    for (size_t k = 0; k < mapping->count; k += 2) {
+        SclshStringBuffer key = sclsh_value_as_bytes(mapping->items[k]);
+        if (key.length > 0) {
+            starts[(unsigned char)key.string[0]] = true;
+            any = true;
+        }
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[1]);
+    if (!any) {
+        return sclsh_value_ref(argv[1]);
+    }
+
+    char* out;
+    SclshValue* result = sclsh_value_new_sized(map_bytes(mapping, starts, string, NULL), &out);
+    if (result) {
+        map_bytes(mapping, starts, string, out);
+    }
+    return result;
+}
+
+static SclshValue* string_repeat(size_t argc, SclshValue** argv) {
+    (void)argc;
+    char* count_string = sclsh_value_as_string(argv[1]).string;
+    char* end;
+    long long count = strtoll(count_string, &end, 10);
+    if (end == count_string || *end != '\0' || count < 0) {
+        fprintf(stderr, "Expected non-negative integer but got '%s'\n", count_string);
+        return NULL;
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[0]);
+    if (count == 0 || string.length == 0) {
+        return sclsh_value_empty();
+    }
+    if (count == 1) {
+        return sclsh_value_ref(argv[0]);
+    }
+    if ((unsigned long long)count > SIZE_MAX / 2 / string.length) {
+        fprintf(stderr, "string repeat: result too large\n");
+        return NULL;
+    }
+
+    size_t length = string.length * (size_t)count;
+    char* out;
+    SclshValue* result = sclsh_value_new_sized(length, &out);
+    if (!result) {
+        return NULL;
+    }
+    // Copying what is done so far doubles it each time
+    memcpy(out, string.string, string.length);
+    for (size_t done = string.length; done < length;) {
+        size_t chunk = done < length - done ? done : length - done;
+        memcpy(out + done, out, chunk);
+        done += chunk;
+    }
+    return result;
+}
+
+static SclshValue* trim(size_t argc, SclshValue** argv, bool left, bool right) {
+    SclshStringBuffer chars = argc == 2 ? sclsh_value_as_bytes(argv[1]) : SCLSH_STRING_BUFFER(" \t\n\r");
+    bool trimmed[256] = { false };
+    for (size_t i = 0; i < chars.length; i++) {
+        trimmed[(unsigned char)chars.string[i]] = true;
+    }
+    SclshStringBuffer string = sclsh_value_as_bytes(argv[0]);
+    size_t start = 0;
+    size_t end = string.length;
+    while (left && start < end && trimmed[(unsigned char)string.string[start]]) {
+        start++;
+    }
+    while (right && end > start && trimmed[(unsigned char)string.string[end - 1]]) {
+        end--;
+    }
+    if (start == 0 && end == string.length) {
+        return sclsh_value_ref(argv[0]);
+    }
+    return sclsh_value_new(string.string + start, end - start);
+}
+
+static SclshValue* string_trim(size_t argc, SclshValue** argv) {
+    return trim(argc, argv, true, true);
+}
+
+static SclshValue* string_trimleft(size_t argc, SclshValue** argv) {
+    return trim(argc, argv, true, false);
+}
+
+static SclshValue* string_trimright(size_t argc, SclshValue** argv) {
+    return trim(argc, argv, false, true);
+}
+
+static SclshValue* switched_case(SclshValue* value, char first) {
+    SclshStringBuffer string = sclsh_value_as_bytes(value);
+    char* out;
+    SclshValue* result = sclsh_value_new_sized(string.length, &out);
+    if (result) {
+        switch_case(out, string.string, string.length, first);
+    }
+    return result;
+}
+
+static SclshValue* string_toupper(size_t argc, SclshValue** argv) {
+    (void)argc;
+    return switched_case(argv[0], 'a');
+}
+
+static SclshValue* string_tolower(size_t argc, SclshValue** argv) {
+    (void)argc;
+    return switched_case(argv[0], 'A');
+}
+
+// Takes an optional -nocase before the two strings to compare
+static bool nocase_option(size_t argc, SclshValue** argv, bool* nocase) {
+    *nocase = argc == 3;
+    if (*nocase && strcmp(sclsh_value_as_string(argv[0]).string, "-nocase") != 0) {
+        fprintf(stderr, "Unknown option '%s'\n", sclsh_value_as_string(argv[0]).string);
+        return false;
+    }
+    return true;
+}
+
+static SclshValue* string_equal(size_t argc, SclshValue** argv) {
+    bool nocase;
+    if (!nocase_option(argc, argv, &nocase)) {
+        return NULL;
+    }
+    SclshStringBuffer a = sclsh_value_as_bytes(argv[argc - 2]);
+    SclshStringBuffer b = sclsh_value_as_bytes(argv[argc - 1]);
+    return sclsh_value_boolean(a.length == b.length && compare_bytes(a, b, nocase) == 0);
+}
+
+static SclshValue* string_compare(size_t argc, SclshValue** argv) {
+    bool nocase;
+    if (!nocase_option(argc, argv, &nocase)) {
+        return NULL;
+    }
+    int order = compare_bytes(sclsh_value_as_bytes(argv[argc - 2]), sclsh_value_as_bytes(argv[argc - 1]), nocase);
+    return order < 0 ? integer_value(-1) : sclsh_value_boolean(order > 0);
+}
+
+static SclshValue* string_match(size_t argc, SclshValue** argv) {
+    (void)argc;
+    return sclsh_value_boolean(sclsh_glob_match(argv[0], sclsh_value_as_bytes(argv[1])));
+}
+
+typedef struct StringCommand_s {
+    const char* name;
+    size_t min_args;
+    size_t max_args;
+    const char* usage;
+    SclshValue* (*run)(size_t argc, SclshValue** argv);
+} StringCommand;
+
+static const StringCommand string_commands[] = {
+    { "length", 1, 1, "<string>", string_length },
+    { "index", 2, 2, "<string> <index>", string_index },
+    { "range", 3, 3, "<string> <first> <last>", string_range },
+    { "first", 2, 3, "<needle> <haystack> ?start?", string_first },
+    { "last", 2, 3, "<needle> <haystack> ?last?", string_last },
+    { "map", 2, 2, "<mapping> <string>", string_map },
+    { "repeat", 2, 2, "<string> <count>", string_repeat },
+    { "trim", 1, 2, "<string> ?chars?", string_trim },
+    { "trimleft", 1, 2, "<string> ?chars?", string_trimleft },
+    { "trimright", 1, 2, "<string> ?chars?", string_trimright },
+    { "toupper", 1, 1, "<string>", string_toupper },
+    { "tolower", 1, 1, "<string>", string_tolower },
+    { "equal", 2, 3, "?-nocase? <string1> <string2>", string_equal },
+    { "compare", 2, 3, "?-nocase? <string1> <string2>", string_compare },
+    { "match", 2, 2, "<pattern> <string>", string_match },
+};
+
+#define STRING_COMMAND_COUNT (sizeof(string_commands) / sizeof(string_commands[0]))
+
+static SclshValue* cmd_string(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx;
+    (void)user_data; // Suppress unused parameter warning
+    const char* name = argc > 0 ? sclsh_value_as_string(argv[0]).string : "";
+    for (size_t i = 0; i < STRING_COMMAND_COUNT; i++) {
+        const StringCommand* command = &string_commands[i];
+        if (strcmp(name, command->name) != 0) {
+            continue;
+        }
+        if (argc - 1 < command->min_args || argc - 1 > command->max_args) {
+            fprintf(stderr, "Usage: string %s %s\n", command->name, command->usage);
+            return NULL;
+        }
+        return command->run(argc - 1, argv + 1);
+    }
+    fprintf(stderr, "Usage: string length|index|range|first|last|map|repeat|trim|trimleft|trimright|toupper|tolower|equal|compare|match ...\n");
+    return NULL;
+}
+
+// append <variable> ?value ...?
+static SclshValue* cmd_append(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1) {
+        fprintf(stderr, "Usage: append <variable> ?value ...?\n");
+        return NULL;
+    }
+    char* name = sclsh_value_as_string(argv[0]).string;
+    SclshValue* value = sclsh_context_get_variable(ctx, name);
+    if (!value) {
+        value = sclsh_value_empty();
+    }
+
+    // Only the variable may hold a reference for the value to grow in place
+    SclshValue* result;
+    if (argc == 1) {
+        result = sclsh_value_ref(value);
+    } else if (argc == 2) {
+        SclshStringBuffer bytes = sclsh_value_as_bytes(argv[1]);
+        result = sclsh_value_append(value, bytes.string, bytes.length);
+    } else {
+        SclshValue* tail = sclsh_value_concat(argv + 1, argc - 1);
+        if (!tail) {
+            return NULL;
+        }
+        SclshStringBuffer bytes = sclsh_value_as_bytes(tail);
+        result = sclsh_value_append(value, bytes.string, bytes.length);
+        sclsh_value_unref(tail);
+    }
+    if (result) {
+        sclsh_context_set_variable(ctx, name, result);
+    }
+    return result;
+}
+
+// lsearch ?-exact|-glob? <list> <pattern>
+static SclshValue* cmd_lsearch(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)ctx;
+    (void)user_data; // Suppress unused parameter warning
+    bool glob = true;
+    if (argc == 3) {
+        char* option = sclsh_value_as_string(argv[0]).string;
+        if (strcmp(option, "-exact") == 0) {
+            glob = false;
+        } else if (strcmp(option, "-glob") != 0) {
+            fprintf(stderr, "Unknown option '%s'\n", option);
+            return NULL;
+        }
+    } else if (argc != 2) {
+        fprintf(stderr, "Usage: lsearch ?-exact|-glob? <list> <pattern>\n");
+        return NULL;
+    }
+    SclshValueList* list = sclsh_value_as_list(argv[argc - 2]);
+    SclshValue* pattern = argv[argc - 1];
+    SclshStringBuffer exact = sclsh_value_as_bytes(pattern);
+    for (size_t i = 0; list && i < list->count; i++) {
+        SclshStringBuffer item = sclsh_value_as_bytes(list->items[i]);
+        bool found = glob ? sclsh_glob_match(pattern, item)
+            : item.length == exact.length && memcmp(item.string, exact.string, exact.length) == 0;
+        if (found) {
+            return integer_value((long long)i);
+        }
+    }
+    return integer_value(-1);
+}
+
+void sclsh_register_string_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "string", cmd_string, NULL, NULL);
+    sclsh_command_new(interp, "append", cmd_append, NULL, NULL);
+    sclsh_command_new(interp, "lsearch", cmd_lsearch, NULL, NULL);
+}
@@ -0,0 +1,526 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/thread_channel.h>
+#include <sclsh/util.h>
+#include "value.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define CACHE_LINE 64
+#define MAX_CAPACITY ((size_t)1 << 30)
+
+/* Bounded MPMC queue after Dmitry Vyukov: every cell carries a sequence
+ * number telling producers and consumers whose turn it is, so the only
+ * contended operation is a CAS on the head or tail position. In SPSC mode
+ * the positions have a single owner and the CAS is skipped.
+ */
+typedef struct ChannelCell_s {
+    atomic_size_t sequence;
+    SclshValue* value;
+} ChannelCell;
+
+struct SclshThreadChannel_s {
+    atomic_long ref_count;
+    SclshThreadChannelMode mode;
+    size_t mask;
+    ChannelCell* cells;
+    char name[32];
+
+    alignas(CACHE_LINE) atomic_size_t enqueue_pos;
+    alignas(CACHE_LINE) atomic_size_t dequeue_pos;
+
+    // Futex words, bumped after every send (receivers wait on it) and
+    // every receive (blocked senders wait on it)
+    alignas(CACHE_LINE) atomic_uint sent;
+    atomic_uint received;
+    atomic_uint waiting_receivers;
+    atomic_uint waiting_senders;
+    atomic_int closed;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static SclshHashMap* registry = NULL;
+static atomic_ulong next_channel_id = 0;
+
+static long futex_wait(atomic_uint* word, unsigned int expected, const struct timespec* timeout) {
+    return syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* word, int count) {
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// Capacities above MAX_CAPACITY are not rounded, the caller rejects them
+static size_t round_up_pow2(size_t n) {
+    size_t res = 2;
+    while (res < n && res < MAX_CAPACITY) {
+        res <<= 1;
+    }
+    return res;
+}
+
+SclshThreadChannel* sclsh_thread_channel_new(size_t capacity, SclshThreadChannelMode mode) {
+    if (capacity > MAX_CAPACITY) {
+        return NULL;
+    }
+    SclshThreadChannel* chan = aligned_alloc(CACHE_LINE, sizeof(SclshThreadChannel));
+    if (!chan) return NULL;
+
+    capacity = round_up_pow2(capacity);
+    chan->cells = malloc(sizeof(ChannelCell) * capacity);
+    if (!chan->cells) {
+        free(chan);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&chan->cells[i].sequence, i);
+        chan->cells[i].value = NULL;
+    }
+
+    atomic_init(&chan->ref_count, 1);
+    chan->mode = mode;
+    chan->mask = capacity - 1;
+    atomic_init(&chan->enqueue_pos, 0);
+    atomic_init(&chan->dequeue_pos, 0);
+    atomic_init(&chan->sent, 0);
+    atomic_init(&chan->received, 0);
+    atomic_init(&chan->waiting_receivers, 0);
+    atomic_init(&chan->waiting_senders, 0);
+    atomic_init(&chan->closed, 0);
+    snprintf(chan->name, sizeof(chan->name), "tchan%lu",
+             atomic_fetch_add(&next_channel_id, 1));
+
+    pthread_mutex_lock(&registry_lock);
+    if (!registry) {
+        registry = sclsh_hash_map_new();
+    }
+    sclsh_hash_map_set(registry, chan->name, chan);
+    pthread_mutex_unlock(&registry_lock);
+
+    return chan;
+}
+
+SclshThreadChannel* sclsh_thread_channel_ref(SclshThreadChannel* chan) {
+    if (chan) {
+        atomic_fetch_add_explicit(&chan->ref_count, 1, memory_order_relaxed);
+    }
+    return chan;
+}
+
+static void channel_free(SclshThreadChannel* chan) {
+    pthread_mutex_lock(&registry_lock);
+    sclsh_hash_map_remove(registry, chan->name);
+    pthread_mutex_unlock(&registry_lock);
+
+    // Values still queued were already handed off, so release them here
+    SclshValue* value;
+    while (sclsh_thread_channel_try_recv(chan, &value) == SCLSH_THREAD_CHANNEL_OK) {
+        sclsh_value_unref(value);
+    }
+    free(chan->cells);
+    free(chan);
+}
+
+void sclsh_thread_channel_unref(SclshThreadChannel* chan) {
+    if (chan && atomic_fetch_sub_explicit(&chan->ref_count, 1, memory_order_acq_rel) == 1) {
+        channel_free(chan);
+    }
+}
+
+SclshThreadChannel* sclsh_thread_channel_lookup(const char* name) {
+    if (!name) {
+        return NULL;
+    }
+    pthread_mutex_lock(&registry_lock);
+    SclshThreadChannel* chan = registry ? sclsh_hash_map_get(registry, name) : NULL;
+    if (chan) {
+        // A channel whose count already dropped to zero is being freed
+        long count = atomic_load(&chan->ref_count);
+        while (count > 0 && !atomic_compare_exchange_weak(&chan->ref_count, &count, count + 1)) {
+        }
+        if (count == 0) {
+            chan = NULL;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return chan;
+}
+
+const char* sclsh_thread_channel_name(SclshThreadChannel* chan) {
+    return chan ? chan->name : NULL;
+}
+
+static int try_enqueue(SclshThreadChannel* chan, SclshValue* value) {
+    size_t pos = atomic_load_explicit(&chan->enqueue_pos, memory_order_relaxed);
+    ChannelCell* cell;
+    for (;;) {
+        cell = &chan->cells[pos & chan->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (chan->mode == SCLSH_THREAD_CHANNEL_SPSC) {
+                atomic_store_explicit(&chan->enqueue_pos, pos + 1, memory_order_relaxed);
+                break;
+            }
+            if (atomic_compare_exchange_weak_explicit(
+                    &chan->enqueue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;  // Full
+        } else {
+            pos = atomic_load_explicit(&chan->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return 1;
+}
+
+static SclshValue* try_dequeue(SclshThreadChannel* chan) {
+    size_t pos = atomic_load_explicit(&chan->dequeue_pos, memory_order_relaxed);
+    ChannelCell* cell;
+    for (;;) {
+        cell = &chan->cells[pos & chan->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (chan->mode == SCLSH_THREAD_CHANNEL_SPSC) {
+                atomic_store_explicit(&chan->dequeue_pos, pos + 1, memory_order_relaxed);
+                break;
+            }
+            if (atomic_compare_exchange_weak_explicit(
+                    &chan->dequeue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL;  // Empty
+        } else {
+            pos = atomic_load_explicit(&chan->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    SclshValue* value = cell->value;
+    cell->value = NULL;
+    atomic_store_explicit(&cell->sequence, pos + chan->mask + 1, memory_order_release);
+    return value;
+}
+
+static void signal_word(atomic_uint* word, atomic_uint* waiters, int count) {
+    atomic_fetch_add(word, 1);
+    if (atomic_load(waiters)) {
+        futex_wake(word, count);
+    }
+}
+
+static void deadline_from_timeout(struct timespec* deadline, long timeout_ms) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+// Sleeps until word changes from expected or the deadline passes.
+// Returns 0 on timeout.
+static int wait_word(
+    atomic_uint* word,
+    atomic_uint* waiters,
+    unsigned int expected,
+    long timeout_ms,
+    const struct timespec* deadline
+) {
+    struct timespec remaining;
+    struct timespec* timeout = NULL;
+    if (timeout_ms >= 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining.tv_sec = deadline->tv_sec - now.tv_sec;
+        remaining.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+        if (remaining.tv_nsec < 0) {
+            remaining.tv_sec--;
+            remaining.tv_nsec += 1000000000L;
+        }
+        if (remaining.tv_sec < 0) {
+            return 0;
+        }
+        timeout = &remaining;
+    }
+    atomic_fetch_add(waiters, 1);
+    long res = futex_wait(word, expected, timeout);
+    atomic_fetch_sub(waiters, 1);
+    return !(res < 0 && errno == ETIMEDOUT);
+}
+
+SclshThreadChannelStatus sclsh_thread_channel_send(
+    SclshThreadChannel* chan,
+    SclshValue* value,
+    long timeout_ms
+) {
+    if (!chan || !value) {
+        return SCLSH_THREAD_CHANNEL_CLOSED;
+    }
+
+    // Only an unshared value can change threads; cached reps may hold
+    // references to values that stay behind, so those are dropped too
+    if (value->ref_count > 1) {
+        SclshValue* copy = sclsh_value_new(value->string, value->length);
+        sclsh_value_unref(value);
+        value = copy;
+    } else {
+        sclsh_value_drop_reps(value);
+    }
+
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        deadline_from_timeout(&deadline, timeout_ms);
+    }
+    for (;;) {
+        if (atomic_load(&chan->closed)) {
+            sclsh_value_unref(value);
+            return SCLSH_THREAD_CHANNEL_CLOSED;
+        }
+        unsigned int seen = atomic_load(&chan->received);
+        if (try_enqueue(chan, value)) {
+            signal_word(&chan->sent, &chan->waiting_receivers, 1);
+            return SCLSH_THREAD_CHANNEL_OK;
+        }
+        if (timeout_ms == 0
+            || !wait_word(&chan->received, &chan->waiting_senders, seen, timeout_ms, &deadline)) {
+            sclsh_value_unref(value);
+            return timeout_ms == 0 ? SCLSH_THREAD_CHANNEL_FULL : SCLSH_THREAD_CHANNEL_TIMEOUT;
+        }
+    }
+}
+
+SclshThreadChannelStatus sclsh_thread_channel_try_recv(
+    SclshThreadChannel* chan,
+    SclshValue** value
+) {
+    if (!chan || !value) {
+        return SCLSH_THREAD_CHANNEL_CLOSED;
+    }
+    *value = try_dequeue(chan);
+    if (*value) {
+        signal_word(&chan->received, &chan->waiting_senders, 1);
+        return SCLSH_THREAD_CHANNEL_OK;
+    }
+    return atomic_load(&chan->closed) ? SCLSH_THREAD_CHANNEL_CLOSED : SCLSH_THREAD_CHANNEL_EMPTY;
+}
+
+SclshThreadChannelStatus sclsh_thread_channel_recv(
+    SclshThreadChannel* chan,
+    SclshValue** value,
+    long timeout_ms
+) {
+    if (!chan || !value) {
+        return SCLSH_THREAD_CHANNEL_CLOSED;
+    }
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        deadline_from_timeout(&deadline, timeout_ms);
+    }
+    for (;;) {
+        unsigned int seen = atomic_load(&chan->sent);
+        SclshThreadChannelStatus status = sclsh_thread_channel_try_recv(chan, value);
+        if (status != SCLSH_THREAD_CHANNEL_EMPTY || timeout_ms == 0) {
+            return status;
+        }
+        if (!wait_word(&chan->sent, &chan->waiting_receivers, seen, timeout_ms, &deadline)) {
+            return SCLSH_THREAD_CHANNEL_TIMEOUT;
+        }
+    }
+}
+
+void sclsh_thread_channel_close(SclshThreadChannel* chan) {
+    if (!chan) {
+        return;
+    }
+    atomic_store(&chan->closed, 1);
+    signal_word(&chan->sent, &chan->waiting_receivers, INT_MAX);
+    signal_word(&chan->received, &chan->waiting_senders, INT_MAX);
+}
+
+// Channels resolved by an interpreter are cached in the chan command's
+// user data, so the registry lock is only taken on the first use
+static SclshThreadChannel* resolve_channel(SclshHashMap* cache, SclshValue* name_value) {
+    char* name = sclsh_value_as_string(name_value).string;
+    if (!name) {
+        return NULL;
+    }
+    SclshThreadChannel* chan = sclsh_hash_map_get(cache, name);
+    if (!chan) {
+        chan = sclsh_thread_channel_lookup(name);
+        if (!chan) {
+            fprintf(stderr, "Unknown thread channel '%s'\n", name);
+            return NULL;
+        }
+        sclsh_hash_map_set(cache, name, chan);
+    }
+    return chan;
+}
+
+static const char* status_message(SclshThreadChannelStatus status) {
+    switch (status) {
+        case SCLSH_THREAD_CHANNEL_CLOSED: return "channel closed";
+        case SCLSH_THREAD_CHANNEL_FULL: return "channel full";
+        case SCLSH_THREAD_CHANNEL_EMPTY: return "channel empty";
+        default: return "timed out";
+    }
+}
+
+// A timeout in milliseconds, negative to wait forever, which it is
+// without one
+static bool timeout_arg(size_t argc, SclshValue** argv, size_t index, long* timeout_ms) {
+    if (index >= argc) {
+        *timeout_ms = -1;
+        return true;
+    }
+    char* text = sclsh_value_as_string(argv[index]).string;
+    char* end;
+    errno = 0;
+    *timeout_ms = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || errno == ERANGE) {
+        fprintf(stderr, "Invalid timeout '%s'\n", text);
+        return false;
+    }
+    return true;
+}
+
+// A capacity from 1 to MAX_CAPACITY, 64 without one
+static bool capacity_arg(size_t argc, SclshValue** argv, size_t index, size_t* capacity) {
+    if (index >= argc) {
+        *capacity = 64;
+        return true;
+    }
+    char* text = sclsh_value_as_string(argv[index]).string;
+    char* end;
+    errno = 0;
+    unsigned long n = strtoul(text, &end, 10);
+    if (!isdigit((unsigned char)*text) || *end != '\0' || errno == ERANGE
+        || n == 0 || n > MAX_CAPACITY) {
+        fprintf(stderr, "Invalid channel capacity '%s'\n", text);
+        return false;
+    }
+    *capacity = n;
+    return true;
+}
+
+static SclshValue* cmd_chan(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    SclshHashMap* cache = user_data;
+    if (argc < 1) {
+        fprintf(stderr, "Usage: chan new|send|recv|try_recv|close ...\n");
+        return NULL;
+    }
+    char* sub = sclsh_value_as_string(argv[0]).string;
+
+    if (strcmp(sub, "new") == 0) {
+        size_t capacity;
+        if (!capacity_arg(argc, argv, 1, &capacity)) {
+            return NULL;
+        }
+        SclshThreadChannel* chan = sclsh_thread_channel_new(capacity, SCLSH_THREAD_CHANNEL_MPMC);
+        if (!chan) {
+            fprintf(stderr, "Failed to create thread channel\n");
+            return NULL;
+        }
+        sclsh_hash_map_set(cache, chan->name, chan);
+        return sclsh_value_from_cstr(chan->name);
+    }
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: chan %s <channel> ...\n", sub);
+        return NULL;
+    }
+    SclshThreadChannel* chan = resolve_channel(cache, argv[1]);
+    if (!chan) {
+        return NULL;
+    }
+
+    if (strcmp(sub, "send") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: chan send <channel> <value> ?timeout?\n");
+            return NULL;
+        }
+        long timeout_ms;
+        if (!timeout_arg(argc, argv, 3, &timeout_ms)) {
+            return NULL;
+        }
+        SclshThreadChannelStatus status = sclsh_thread_channel_send(
+            chan, sclsh_value_ref(argv[2]), timeout_ms
+        );
+        if (status != SCLSH_THREAD_CHANNEL_OK) {
+            fprintf(stderr, "chan send: %s\n", status_message(status));
+            return NULL;
+        }
+        return sclsh_value_empty();
+    } else if (strcmp(sub, "recv") == 0) {
+        long timeout_ms;
+        if (!timeout_arg(argc, argv, 2, &timeout_ms)) {
+            return NULL;
+        }
+        SclshValue* value = NULL;
+        SclshThreadChannelStatus status = sclsh_thread_channel_recv(
+            chan, &value, timeout_ms
+        );
+        if (status != SCLSH_THREAD_CHANNEL_OK) {
+            fprintf(stderr, "chan recv: %s\n", status_message(status));
+            return NULL;
+        }
+        return value;
+    } else if (strcmp(sub, "try_recv") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: chan try_recv <channel> <variable>\n");
+            return NULL;
+        }
+        SclshValue* value = NULL;
+        if (sclsh_thread_channel_try_recv(chan, &value) != SCLSH_THREAD_CHANNEL_OK) {
+            return sclsh_value_zero();
+        }
+        sclsh_context_set_variable(ctx, sclsh_value_as_string(argv[2]).string, value);
+        sclsh_value_unref(value);  // The variable holds the reference now
+        return sclsh_value_one();
+    } else if (strcmp(sub, "close") == 0) {
+        sclsh_thread_channel_close(chan);
+        return sclsh_value_empty();
+    }
+
+    fprintf(stderr, "Unknown chan subcommand '%s'\n", sub);
+    return NULL;
+}
+
+static void release_cached_channel(const char* key, void* value, void* user_data) {
+    (void)key; (void)user_data;
+    sclsh_thread_channel_unref(value);
+}
+
+static void free_channel_cache(void* user_data) {
+    SclshHashMap* cache = user_data;
+    sclsh_hash_map_for_each(cache, release_cached_channel, NULL);
+    sclsh_hash_map_free(cache);
+}
+
+void sclsh_register_thread_channel_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "chan", cmd_chan, sclsh_hash_map_new(), free_channel_cache);
+}
@@ -1,8 +1,9 @@
 #include <sclsh/unwind.h>
 
-SclshUnwindKind current_unwind = SCLSH_UNWIND_NONE;
-SclshValue* unwind_value = NULL;
-SclshListBuilder* traceback = NULL;
+// Unwind state is per thread so interpreters may run on different threads
+static _Thread_local SclshUnwindKind current_unwind = SCLSH_UNWIND_NONE;
+static _Thread_local SclshValue* unwind_value = NULL;
+static _Thread_local SclshListBuilder* traceback = NULL;
 
 SclshUnwindKind sclsh_get_unwind(void) {
     return current_unwind;
@@ -1,5 +1,6 @@
 #include <sclsh/util.h>
 #include <sclsh/value.h>
+#include "stats.h"
 #include <string.h>
 
 uint32_t sclsh_fnv_hash(char* string) {
@@ -12,6 +13,34 @@ uint32_t sclsh_fnv_hash(char* string) {
     return res;
 }
 
+uint32_t sclsh_fnv_hash_bytes(const char* bytes, size_t length) {
+    uint32_t res = 0x811c9dc5;
+    for (size_t i = 0; i < length; i++) {
+        res += (unsigned char)bytes[i];
+        res *= 0x01000193;
+    }
+    return res;
+}
+
+// FNV-1a over 64-bit words, folding the high half into the low one
+// after each, then over the bytes left over
+uint64_t sclsh_fnv_hash64(const char* bytes, size_t length) {
+    uint64_t res = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        res ^= word;
+        res *= 0x100000001b3ULL;
+        res ^= res >> 32;
+    }
+    for (; i < length; i++) {
+        res ^= (unsigned char)bytes[i];
+        res *= 0x100000001b3ULL;
+    }
+    return res;
+}
+
 uint32_t sclsh_pointer_hash(void* pointer) {
     uint32_t res = 0x811c9dc5;
     size_t buf = (size_t)pointer;
@@ -83,14 +112,16 @@ SclshStringBuffer sclsh_string_builder_value(SclshStringBuilder* sb) {
 }
 SclshValue* sclsh_string_builder_to_value(SclshStringBuilder* sb) {
     if (!sb || sb->length == 0) {
-        return sclsh_value_new("", 0);
+        return sclsh_value_empty();
     }
     SclshValue* value = sclsh_value_new(sb->string, sb->length);
     return value;
 }
 
 typedef struct SclshHashMapEntry_s {
-    char* key;
+    char* key;  // Null-terminated for the iteration callback
+    size_t length;
+    uint32_t hash;
     void* value;
     struct SclshHashMapEntry_s* next;
 } SclshHashMapEntry;
@@ -129,6 +160,7 @@ void sclsh_hash_map_free(SclshHashMap* map) {
     free(map);
 }
 static void grow_hash_map(SclshHashMap* map) {
+    SCLSH_STAT(hash_resizes);
     size_t new_capacity = map->capacity * 2;
     SclshHashMapEntry** new_entries = calloc(new_capacity, sizeof(SclshHashMapEntry*));
     if (!new_entries) return; // Handle memory allocation failure
@@ -137,8 +169,7 @@ static void grow_hash_map(SclshHashMap* map) {
         SclshHashMapEntry* entry = map->entries[i];
         while (entry) {
             SclshHashMapEntry* next = entry->next;
-            uint32_t hash = sclsh_fnv_hash(entry->key);
-            size_t index = hash % new_capacity;
+            size_t index = entry->hash % new_capacity;
 
             entry->next = new_entries[index];
             new_entries[index] = entry;
@@ -151,59 +182,67 @@ static void grow_hash_map(SclshHashMap* map) {
     map->entries = new_entries;
     map->capacity = new_capacity;
 }
-void sclsh_hash_map_set(SclshHashMap* map, const char* key, void* value) {
-    if (!map || !key) return;
-
-    if (map->count >= map->capacity) {
-        grow_hash_map(map);
-    }
-
-    uint32_t hash = sclsh_fnv_hash((char*)key);
-    size_t index = hash % map->capacity;
-
-    SclshHashMapEntry* entry = map->entries[index];
+// The entry for a key, comparing the stored hash and length before any
+// bytes
+static SclshHashMapEntry* find_entry(SclshHashMap* map, SclshStringBuffer key, uint32_t hash) {
+    SCLSH_STAT(hash_lookups);
+    SclshHashMapEntry* entry = map->entries[hash % map->capacity];
     while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            entry->value = value; // Update existing value
-            return;
+        SCLSH_STAT(hash_probes);
+        if (entry->hash == hash && entry->length == key.length
+            && memcmp(entry->key, key.string, key.length) == 0) {
+            return entry;
         }
         entry = entry->next;
     }
+    return NULL;
+}
+void sclsh_hash_map_set_buffer(SclshHashMap* map, SclshStringBuffer key, void* value) {
+    if (!map || !key.string) return;
+
+    uint32_t hash = sclsh_fnv_hash_bytes(key.string, key.length);
+    SclshHashMapEntry* entry = find_entry(map, key, hash);
+    if (entry) {
+        entry->value = value; // Update existing value
+        return;
+    }
+
+    if (map->count >= map->capacity) {
+        grow_hash_map(map);
+    }
 
     // Create a new entry
     entry = malloc(sizeof(SclshHashMapEntry));
     if (!entry) return;
-
-    entry->key = strdup(key);
+    entry->key = malloc(key.length + 1);
+    if (!entry->key) {
+        free(entry);
+        return;
+    }
+    memcpy(entry->key, key.string, key.length);
+    entry->key[key.length] = '\0';
+    entry->length = key.length;
+    entry->hash = hash;
     entry->value = value;
+    size_t index = hash % map->capacity;
     entry->next = map->entries[index];
     map->entries[index] = entry;
     map->count++;
 }
-void* sclsh_hash_map_get(SclshHashMap* map, const char* key) {
-    if (!map || !key) return NULL;
-
-    uint32_t hash = sclsh_fnv_hash((char*)key);
-    size_t index = hash % map->capacity;
-
-    SclshHashMapEntry* entry = map->entries[index];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            return entry->value; // Found the value
-        }
-        entry = entry->next;
-    }
-
-    return NULL; // Key not found
+void* sclsh_hash_map_get_buffer(SclshHashMap* map, SclshStringBuffer key) {
+    if (!map || !key.string) return NULL;
+    SclshHashMapEntry* entry = find_entry(map, key, sclsh_fnv_hash_bytes(key.string, key.length));
+    return entry ? entry->value : NULL;
 }
-void sclsh_hash_map_remove(SclshHashMap* map, const char* key) {
-    if (!map || !key) return;
-    uint32_t hash = sclsh_fnv_hash((char*)key);
+void sclsh_hash_map_remove_buffer(SclshHashMap* map, SclshStringBuffer key) {
+    if (!map || !key.string) return;
+    uint32_t hash = sclsh_fnv_hash_bytes(key.string, key.length);
     size_t index = hash % map->capacity;
     SclshHashMapEntry* entry = map->entries[index];
     SclshHashMapEntry* prev = NULL; 
     while (entry) {
-        if (strcmp(entry->key, key) == 0) {
+        if (entry->hash == hash && entry->length == key.length
+            && memcmp(entry->key, key.string, key.length) == 0) {
             if (prev) {
                 prev->next = entry->next;
             } else {
@@ -218,6 +257,18 @@ void sclsh_hash_map_remove(SclshHashMap* map, const char* key) {
         entry = entry->next;
     }
 }
+void sclsh_hash_map_set(SclshHashMap* map, const char* key, void* value) {
+    if (!key) return;
+    sclsh_hash_map_set_buffer(map, SCLSH_STRING_BUFFER((char*)key), value);
+}
+void* sclsh_hash_map_get(SclshHashMap* map, const char* key) {
+    if (!key) return NULL;
+    return sclsh_hash_map_get_buffer(map, SCLSH_STRING_BUFFER((char*)key));
+}
+void sclsh_hash_map_remove(SclshHashMap* map, const char* key) {
+    if (!key) return;
+    sclsh_hash_map_remove_buffer(map, SCLSH_STRING_BUFFER((char*)key));
+}
 void sclsh_hash_map_for_each(
     SclshHashMap* map, 
     SclshHashMapIteratorCallback callback, 
@@ -8,29 +8,295 @@
 #include <sclsh/util.h>
 #include <sclsh/parse.h>
 #include "value.h"
+#include "code.h"
+#include "stats.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+uint64_t sclsh_value_allocation_count(void) {
+#if SCLSH_STATS
+    return sclsh_stats_value_allocations(&sclsh_thread_stats);
+#else
+    return 0;
+#endif
+}
 
+// Freed values are kept for reuse, chained through base, so values that
+// come and go at a steady rate stop costing calls of malloc. Under
+// AddressSanitizer every value is really freed to keep use after free
+// visible.
+#if defined(__SANITIZE_ADDRESS__)
+#define VALUE_POOL_LIMIT 0
+#else
+#define VALUE_POOL_LIMIT 1024
+#endif
+
+static _Thread_local SclshValue* value_pool SCLSH_TLS_MODEL;
+static _Thread_local size_t value_pool_count SCLSH_TLS_MODEL;
+static _Thread_local bool value_pool_registered SCLSH_TLS_MODEL;
+
+// Empties the pool of a thread that exits
+static pthread_key_t value_pool_key;
+static pthread_once_t value_pool_key_once = PTHREAD_ONCE_INIT;
+
+static void free_value_pool(void* unused) {
+    (void)unused; // Suppress unused parameter warning
+    while (value_pool) {
+        SclshValue* next = value_pool->base;
+        free(value_pool);
+        value_pool = next;
+    }
+    value_pool_count = 0;
+}
+
+static void create_value_pool_key(void) {
+    pthread_key_create(&value_pool_key, free_value_pool);
+}
+
+static void pool_value(SclshValue* value) {
+    if (!value_pool_registered) {
+        pthread_once(&value_pool_key_once, create_value_pool_key);
+        pthread_setspecific(value_pool_key, &value_pool);  // Any non-NULL pointer will do
+        value_pool_registered = true;
+    }
+    value->base = value_pool;
+    value_pool = value;
+    value_pool_count++;
+}
+
+// A value without bytes yet
+static SclshValue* value_alloc(void) {
+    SclshValue* value = value_pool;
+    if (value) {
+        SCLSH_STAT(values_recycled);
+        value_pool = value->base;
+        value_pool_count--;
+    } else {
+        value = malloc(sizeof(SclshValue));
+        if (!value) return NULL;
+    }
+
+    value->ref_count = 1;
+    value->string = NULL;
+    value->length = 0;
+    value->as_list = NULL;
+    value->as_proc = NULL;
+    value->as_command_line = NULL;
+    value->as_interpolation = NULL;
+    value->as_code = NULL;
+    value->as_glob = NULL;
+    value->as_regex = NULL;
+    value->as_chars = NULL;
+    value->base = NULL;
+    value->mapped = false;
+    value->capacity = 0;
+    return value;
+}
+
+// Room for length bytes and a null terminator, inside the value if it fits
+static char* value_storage(SclshValue* value, size_t length) {
+    if (length < SCLSH_INLINE_STRING) {
+        return value->inline_string;
+    }
+    char* string = malloc(length + 1);
+    assert(string);
+    return string;
+}
 
 SclshValue* sclsh_value_new(const char* string, 
                             size_t length) {
-    SclshValue* value = malloc(sizeof(SclshValue));
+    SclshValue* value = value_alloc();
     if (!value) return NULL;
+    SCLSH_STAT(values_copied);
+    if (length < SCLSH_INLINE_STRING) {
+        SCLSH_STAT(strings_inline);
+    }
 
-    value->ref_count = 1;
-    assert(value->string = malloc(length + 1));
-    strncpy(value->string, string, length);
+    value->string = value_storage(value, length);
+    memcpy(value->string, string, length);
     value->string[length] = '\0';
     value->length = length;
 
     return value;
 }
 
+// Never drops to zero, so the value is never freed and never counts as
+// unshared
+#define IMMORTAL_REF_COUNT (LONG_MAX / 2)
+
+#define IMMORTAL_VALUE(bytes) { \
+    .ref_count = IMMORTAL_REF_COUNT, \
+    .string = bytes, \
+    .length = sizeof(bytes) - 1, \
+}
+
+// Per thread, as their cached representations are built on first use
+static _Thread_local SclshValue empty_value = IMMORTAL_VALUE("");
+static _Thread_local SclshValue zero_value = IMMORTAL_VALUE("0");
+static _Thread_local SclshValue one_value = IMMORTAL_VALUE("1");
+
+SclshValue* sclsh_value_empty(void) {
+    return &empty_value;
+}
+
+SclshValue* sclsh_value_zero(void) {
+    return &zero_value;
+}
+
+SclshValue* sclsh_value_one(void) {
+    return &one_value;
+}
+
+SclshValue* sclsh_value_boolean(bool b) {
+    return b ? &one_value : &zero_value;
+}
+
 SclshValue* sclsh_value_from_cstr(const char* str) {
     return sclsh_value_new(str, strlen(str));
 }
 
+SclshValue* sclsh_value_new_mapped(char* bytes, size_t length) {
+    SclshValue* value = value_alloc();
+    if (!value) return NULL;
+    SCLSH_STAT(values_mapped);
+
+    value->string = bytes;
+    value->length = length;
+    value->mapped = true;
+    return value;
+}
+
+SclshValue* sclsh_value_new_slice(SclshValue* base, size_t offset, size_t length) {
+    if (!base || offset + length > base->length) {
+        return NULL;
+    }
+    if (base->base) {
+        offset += base->string - base->base->string;
+        base = base->base;  // Never chain slices
+    }
+
+    SclshValue* value = value_alloc();
+    if (!value) return NULL;
+    SCLSH_STAT(values_sliced);
+
+    value->string = base->string + offset;
+    value->length = length;
+    value->base = sclsh_value_ref(base);
+    return value;
+}
+
+// Gives a slice its own null-terminated copy of the bytes
+static void materialize(SclshValue* value) {
+    SCLSH_STAT(slices_materialized);
+    char* string = value_storage(value, value->length);
+    memcpy(string, value->string, value->length);
+    string[value->length] = '\0';
+    sclsh_value_unref(value->base);
+    value->base = NULL;
+    value->string = string;
+}
+
+// Bytes available at an owned string, null terminator included
+static size_t string_capacity(SclshValue* value) {
+    if (value->string == value->inline_string) {
+        return SCLSH_INLINE_STRING;
+    }
+    return value->capacity > value->length ? value->capacity : value->length + 1;
+}
+
+SclshValue* sclsh_value_with_integer(SclshValue* value, long long n) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", n);
+    if (!value || value->ref_count != 1 || value->base || value->mapped) {
+        return sclsh_value_new(buffer, (size_t)length);
+    }
+    if (value->string == value->inline_string) {
+        if ((size_t)length >= SCLSH_INLINE_STRING) {
+            return sclsh_value_new(buffer, (size_t)length);
+        }
+    } else if ((size_t)length + 1 > string_capacity(value)) {
+        char* string = realloc(value->string, (size_t)length + 1);
+        if (!string) {
+            return sclsh_value_new(buffer, (size_t)length);
+        }
+        SCLSH_STAT(strings_grown);
+        value->string = string;
+        value->capacity = 0;
+    }
+    sclsh_value_drop_reps(value);
+    SCLSH_STAT(values_updated);
+    memcpy(value->string, buffer, (size_t)length + 1);
+    value->length = (size_t)length;
+    return sclsh_value_ref(value);
+}
+
+SclshValue* sclsh_value_new_sized(size_t length, char** bytes) {
+    SclshValue* value = value_alloc();
+    if (!value) return NULL;
+    SCLSH_STAT(values_copied);
+    if (length < SCLSH_INLINE_STRING) {
+        SCLSH_STAT(strings_inline);
+    }
+    value->string = value_storage(value, length);
+    value->string[length] = '\0';
+    value->length = length;
+    *bytes = value->string;
+    return value;
+}
+
+SclshValue* sclsh_value_append(SclshValue* value, const char* bytes, size_t length) {
+    size_t old_length = value->length;
+    size_t new_length = old_length + length;
+    size_t capacity = 2 * (new_length + 1);
+    if (value->ref_count != 1 || value->base || value->mapped) {
+        SclshValue* result = value_alloc();
+        if (!result) return NULL;
+        SCLSH_STAT(values_copied);
+        if (new_length < SCLSH_INLINE_STRING) {
+            SCLSH_STAT(strings_inline);
+            result->string = result->inline_string;
+        } else {
+            result->string = malloc(capacity);
+            assert(result->string);
+            result->capacity = capacity;
+        }
+        memcpy(result->string, value->string, old_length);
+        memcpy(result->string + old_length, bytes, length);
+        result->string[new_length] = '\0';
+        result->length = new_length;
+        return result;
+    }
+
+    if (new_length + 1 > string_capacity(value)) {
+        char* string;
+        if (value->string == value->inline_string) {
+            string = malloc(capacity);
+            if (string) {
+                memcpy(string, value->string, old_length);
+            }
+        } else {
+            string = realloc(value->string, capacity);
+        }
+        if (!string) {
+            return NULL;
+        }
+        SCLSH_STAT(strings_grown);
+        value->string = string;
+        value->capacity = capacity;
+    }
+    sclsh_value_drop_reps(value);
+    SCLSH_STAT(values_updated);
+    memcpy(value->string + old_length, bytes, length);
+    value->string[new_length] = '\0';
+    value->length = new_length;
+    return sclsh_value_ref(value);
+}
+
 SclshValue* sclsh_value_ref(SclshValue* value) {
     if (value) {
         value->ref_count++;
@@ -38,26 +304,75 @@ SclshValue* sclsh_value_ref(SclshValue* value) {
     return value;
 }
 
-static void value_free(SclshValue* value) {
+void sclsh_value_drop_reps(SclshValue* value) {
     if (!value) {
         return;
     }
-    if (value->string) {
-        free(value->string);
+    if (value->base) {
+        materialize(value);  // The base may be shared with other values
     }
+#if SCLSH_STATS
+    if (value->ref_count > 0) {  // Not on the way to being freed
+        SCLSH_STAT_ADD(reps_dropped, (value->as_list != NULL) + (value->as_proc != NULL)
+            + (value->as_command_line != NULL) + (value->as_interpolation != NULL) + (value->as_code != NULL)
+            + (value->as_glob != NULL) + (value->as_regex != NULL) + (value->as_chars != NULL));
+    }
+#endif
     if (value->as_list) {
         sclsh_value_list_free(value->as_list);
+        value->as_list = NULL;
     }
     if (value->as_proc) {
         sclsh_value_list_free(value->as_proc);
+        value->as_proc = NULL;
     }
     if (value->as_command_line) {
         sclsh_node_list_free(value->as_command_line);
+        value->as_command_line = NULL;
     }
     if (value->as_interpolation) {
         sclsh_node_list_free(value->as_interpolation);
+        value->as_interpolation = NULL;
+    }
+    if (value->as_code) {
+        sclsh_code_unref(value->as_code);
+        value->as_code = NULL;
+    }
+    if (value->as_glob) {
+        sclsh_glob_free(value->as_glob);
+        value->as_glob = NULL;
+    }
+    if (value->as_regex) {
+        sclsh_regex_free(value->as_regex);
+        value->as_regex = NULL;
+    }
+    if (value->as_chars) {
+        sclsh_chars_free(value->as_chars);
+        value->as_chars = NULL;
+    }
+}
+
+static void value_free(SclshValue* value) {
+    if (!value) {
+        return;
+    }
+    SCLSH_STAT(values_freed);
+    if (value->mapped) {
+        SCLSH_STAT(mappings_freed);
+        munmap(value->string, value->length);
+    } else if (value->base) {
+        SCLSH_STAT(slices_freed);
+        sclsh_value_unref(value->base);
+    } else if (value->string != value->inline_string) {
+        free(value->string);
+    }
+    value->base = NULL;
+    sclsh_value_drop_reps(value);
+    if (value_pool_count < VALUE_POOL_LIMIT) {
+        pool_value(value);
+    } else {
+        free(value);
     }
-    free(value);
 }
 
 void sclsh_value_unref(SclshValue* value) {
@@ -70,7 +385,11 @@ SclshValueList* sclsh_value_as_list(SclshValue* value) {
     if (!value) {
         return NULL;
     }
-    if (!value->as_list) {
+    if (value->as_list) {
+        SCLSH_STAT(list.hits);
+    } else {
+        SCLSH_STAT(list.conversions);
+        SCLSH_STAT_ADD(parsed_bytes, value->length);
         value->as_list = sclsh_parse_list(sclsh_value_as_string(value));
         if (!value->as_list) {
             return NULL;  // Failed to parse as list
@@ -84,7 +403,11 @@ SclshValueList* sclsh_value_as_proc(SclshValue* value) {
     if (!value) {
         return NULL;
     }
-    if (!value->as_proc) {
+    if (value->as_proc) {
+        SCLSH_STAT(script.hits);
+    } else {
+        SCLSH_STAT(script.conversions);
+        SCLSH_STAT_ADD(parsed_bytes, value->length);
         value->as_proc = sclsh_parse_commands(sclsh_value_as_string(value));
         if (!value->as_proc) {
             return NULL;  // Failed to parse as procedure
@@ -98,17 +421,27 @@ SclshStringBuffer sclsh_value_as_string(SclshValue* value) {
         return buffer;  // Empty value
     }
 
-    buffer.string = malloc(value->length + 1);
-    if (!buffer.string) {
-        return buffer;  // Memory allocation failed
+    if (value->base) {
+        materialize(value);
     }
-    memcpy(buffer.string, value->string, value->length);
-    buffer.string[value->length] = '\0';  // Null-terminate
+
+    // Borrowed from the value, which keeps it null-terminated
+    buffer.string = value->string;
     buffer.length = value->length;
 
     return buffer;
 }
 
+SclshStringBuffer sclsh_value_as_bytes(SclshValue* value) {
+    SclshStringBuffer buffer = { .string = NULL, .length = 0 };
+    if (!value) {
+        return buffer;
+    }
+    buffer.string = value->string;
+    buffer.length = value->length;
+    return buffer;
+}
+
 void sclsh_value_list_free(SclshValueList* list) {
     if (!list) {
         return;
@@ -182,7 +515,7 @@ SclshValueList* sclsh_list_builder_value_list(SclshListBuilder* builder) {
         return empty_list;
     }
 
-    SclshValueList* list = malloc(sizeof(SclshValueList) + sizeof(SclshValue*) * (builder->count - 1));
+    SclshValueList* list = malloc(sizeof(SclshValueList) + sizeof(SclshValue*) * builder->count);
     if (!list) return NULL;
 
     list->count = builder->count;
@@ -226,21 +559,17 @@ SclshValue* sclsh_list_builder_value(SclshListBuilder* builder) {
     SclshValueList* list = sclsh_list_builder_value_list(builder);
     if (!list) return NULL;
 
-    SclshValue* value = malloc(sizeof(SclshValue));
+    SclshValue* value = value_alloc();
     if (!value) {
         sclsh_value_list_free(list);
         return NULL;
     }
+    SCLSH_STAT(values_copied);
 
     SclshStringBuffer buffer = value_list_to_string(list);
-
-    value->ref_count = 1;
     value->string = buffer.string;
     value->length = buffer.length;
     value->as_list = list;
-    value->as_proc = NULL;
-    value->as_command_line = NULL;
-    value->as_interpolation = NULL;
 
     return value;
 }
@@ -250,13 +579,13 @@ SclshValue* sclsh_value_new_from_list(SclshValue** items, size_t count) {
         return NULL;  // Invalid input
     }
 
-    SclshValue* value = malloc(sizeof(SclshValue));
+    SclshValue* value = value_alloc();
     if (!value) return NULL;
+    SCLSH_STAT(values_copied);
 
-    value->ref_count = 1;
     value->as_list = malloc(sizeof(SclshValueList) + sizeof(SclshValue*) * count);
     if (!value->as_list) {
-        free(value);
+        sclsh_value_unref(value);
         return NULL;
     }
 
@@ -268,9 +597,28 @@ SclshValue* sclsh_value_new_from_list(SclshValue** items, size_t count) {
     SclshStringBuffer buffer = value_list_to_string(value->as_list);
     value->string = buffer.string;
     value->length = buffer.length;
-    value->as_proc = NULL;
-    value->as_command_line = NULL;
-    value->as_interpolation = NULL;
 
     return value;
-}
\ No newline at end of file
+}
+SclshValue* sclsh_value_concat(SclshValue** parts, size_t count) {
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        length += parts[i]->length;
+    }
+    SclshValue* value = value_alloc();
+    if (!value) return NULL;
+    SCLSH_STAT(values_copied);
+    if (length < SCLSH_INLINE_STRING) {
+        SCLSH_STAT(strings_inline);
+    }
+
+    char* string = value_storage(value, length);
+    value->string = string;
+    value->length = length;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(string, parts[i]->string, parts[i]->length);
+        string += parts[i]->length;
+    }
+    *string = '\0';
+    return value;
+}
@@ -9,16 +9,29 @@
 #include <sclsh/value.h>
 #include <sclsh/ast.h>
 
+// Strings shorter than this are kept inside the value
+#define SCLSH_INLINE_STRING 16
+
 struct s_SclshValue {
     long ref_count;  // Reference count for memory management
     
     char* string;  // Pointer to the string data
     size_t length;  // Length of the string
+    SclshValue* base;  // Slices borrow their bytes from base and are not null-terminated
+    bool mapped;  // The bytes are a read-only file mapping
+    size_t capacity;  // Heap bytes at string when more than length + 1 were allocated, else 0
+
 
     SclshValueList* as_list;
     SclshValueList* as_proc;
     SclshNodeList* as_command_line;
     SclshNodeList* as_interpolation;
+    struct SclshCode_s* as_code;  // See code.h
+    struct SclshGlob_s* as_glob;  // See glob.c
+    struct SclshRegex_s* as_regex;  // See regexp.c
+    struct SclshChars_s* as_chars;  // See string.c
+
+    char inline_string[SCLSH_INLINE_STRING];  // Holds string if it is short enough
 };
 
 struct s_SclshValueList {
@@ -26,4 +39,39 @@ struct s_SclshValueList {
     SclshValue* items[];  // Array of pointers to SclshValue
 };
 
+typedef struct SclshGlob_s SclshGlob;
+void sclsh_glob_free(SclshGlob* glob);
+typedef struct SclshRegex_s SclshRegex;
+void sclsh_regex_free(SclshRegex* regex);
+typedef struct SclshChars_s SclshChars;
+void sclsh_chars_free(SclshChars* chars);
+
+// Releases cached internal representations, leaving only a private string
+void sclsh_value_drop_reps(SclshValue* value);
+
+// Wraps a read-only mapping of length bytes, which is unmapped when the
+// value is freed. Only ever used as the base of slices.
+SclshValue* sclsh_value_new_mapped(char* bytes, size_t length);
+// Refers to length bytes of base starting at offset without copying them
+SclshValue* sclsh_value_new_slice(SclshValue* base, size_t offset, size_t length);
+
+// Heap blocks allocated for values by this thread so far
+uint64_t sclsh_value_allocation_count(void);
+
+// New reference to a value holding n: value itself, rewritten in place,
+// if the caller's reference is its only one, otherwise a new value. Lets
+// incr count without allocating.
+SclshValue* sclsh_value_with_integer(SclshValue* value, long long n);
+
+// New value of length bytes that the caller fills in at *bytes; the
+// null terminator is already in place. With the size known up front the
+// bytes come in a single allocation, or none for short strings.
+SclshValue* sclsh_value_new_sized(size_t length, char** bytes);
+
+// New reference to value with length bytes appended: value itself,
+// grown in place, if the caller's reference is its only one, otherwise
+// a new value. Either way the string gets room to spare, so appending
+// in a loop copies each byte a constant number of times on average.
+SclshValue* sclsh_value_append(SclshValue* value, const char* bytes, size_t length);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1021 @@
+/* Copyright © 2025 Ales Hakl
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sclsh/vm.h>
+#include <sclsh/ast.h>
+#include <sclsh/exec.h>
+#include <sclsh/expr.h>
+#include <sclsh/unwind.h>
+#include <sclsh/util.h>
+#include "code.h"
+#include "value.h"
+#include "interp.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Results that tell the run loop something other than "here is a value"
+static SclshValue pending_marker;  // The command pushed a frame, see sclsh_eval_then
+static SclshValue yield_marker;  // The running coroutine yielded
+#define PENDING (&pending_marker)
+#define YIELDED (&yield_marker)
+
+// Contexts of procedure calls and their slots are carved out of chunks
+// owned by the run and released in LIFO order as frames finish
+#define ARENA_CHUNK_SIZE 65536
+
+typedef struct ArenaChunk_s {
+    struct ArenaChunk_s* next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaChunk;
+
+typedef struct ArenaMark_s {
+    ArenaChunk* chunk;
+    size_t used;
+} ArenaMark;
+
+typedef struct Frame_s {
+    SclshCode* code;
+    size_t pc;
+    size_t base;  // Stack height when the frame was entered
+    size_t return_sp;  // Stack height to go back to once the invocation that pushed the frame completes
+    size_t counter_base;  // foreach counters when the frame was entered
+    SclshContext* ctx;
+    SclshContinuation then;
+    SclshContext* then_ctx;  // Context the continuation runs in
+    void* data;
+    bool owns_ctx;  // ctx is a procedure call context allocated at mark
+    ArenaMark mark;
+} Frame;
+
+typedef struct Coroutine_s Coroutine;
+
+struct SclshExecution_s {
+    SclshInterpreter* interp;
+    SclshValue** stack;
+    size_t sp;
+    size_t stack_capacity;
+    Frame* frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    size_t* counters;  // Positions of the running compiled foreach loops
+    size_t counter_count;
+    size_t counter_capacity;
+    SclshExecution* outer;  // Run that was active when this one was entered
+    size_t depth_base;  // Frames of the outer runs
+    bool accepting;  // A command or continuation of this run may push a frame
+    size_t invoke_sp;  // Where the words of the running invocation start
+    Coroutine* coroutine;  // NULL for ordinary runs
+    ArenaChunk* arena;
+    ArenaChunk* arena_current;  // NULL while nothing is allocated
+    SclshExecution* next_spare;
+};
+
+// Released runs keep their stacks for the next one, so evaluating a
+// script from C does not allocate once the pool is warm
+#define MAX_SPARE_EXECUTIONS 16
+
+struct Coroutine_s {
+    char* name;
+    SclshExecution* exec;
+    bool started;
+    bool running;
+    SclshValue* yielded;
+    size_t resume_sp;  // Stack height below the words of the pending yield
+};
+
+static SclshExecution* execution_acquire(SclshInterpreter* interp) {
+    SclshExecution* exec = interp->spare_executions;
+    if (exec) {
+        interp->spare_executions = exec->next_spare;
+        interp->spare_execution_count--;
+    } else {
+        exec = calloc(1, sizeof(SclshExecution));
+        if (!exec) return NULL;
+    }
+
+    exec->interp = interp;
+    exec->outer = NULL;
+    exec->depth_base = 0;
+    exec->accepting = false;
+    exec->coroutine = NULL;
+    exec->arena_current = NULL;
+    exec->next_spare = NULL;
+    sclsh_clear_unwind();  // Left over from a run that was abandoned
+    return exec;
+}
+
+static void arena_free_chunks(ArenaChunk* chunk) {
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+static void execution_destroy(SclshExecution* exec) {
+    arena_free_chunks(exec->arena);
+    free(exec->stack);
+    free(exec->frames);
+    free(exec->counters);
+    free(exec);
+}
+
+void sclsh_spare_executions_free(SclshInterpreter* interp) {
+    while (interp->spare_executions) {
+        SclshExecution* exec = interp->spare_executions;
+        interp->spare_executions = exec->next_spare;
+        execution_destroy(exec);
+    }
+    interp->spare_execution_count = 0;
+}
+
+static void* arena_alloc(SclshExecution* exec, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    ArenaChunk* chunk = exec->arena_current;
+    if (!chunk || chunk->size - chunk->used < size) {
+        // Chunks past the current one are unused and kept for reuse
+        ArenaChunk** link = chunk ? &chunk->next : &exec->arena;
+        if (*link && (*link)->size < size) {
+            arena_free_chunks(*link);
+            *link = NULL;
+        }
+        if (!*link) {
+            size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+            *link = malloc(sizeof(ArenaChunk) + chunk_size);
+            if (!*link) {
+                return NULL;
+            }
+            (*link)->next = NULL;
+            (*link)->size = chunk_size;
+        }
+        chunk = *link;
+        chunk->used = 0;
+        exec->arena_current = chunk;
+    }
+    void* memory = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+static ArenaMark arena_mark(SclshExecution* exec) {
+    ArenaMark mark = { exec->arena_current, exec->arena_current ? exec->arena_current->used : 0 };
+    return mark;
+}
+
+static void arena_reset(SclshExecution* exec, ArenaMark mark) {
+    exec->arena_current = mark.chunk;
+    if (mark.chunk) {
+        mark.chunk->used = mark.used;
+    }
+}
+
+static void release_context(SclshExecution* exec, Frame* frame) {
+    SclshProc* proc = frame->ctx->proc;
+    sclsh_context_clear(frame->ctx);
+    sclsh_proc_unref(proc);
+    arena_reset(exec, frame->mark);
+    frame->owns_ctx = false;
+}
+
+static size_t depth(SclshExecution* exec) {
+    return exec ? exec->depth_base + exec->frame_count : 0;
+}
+
+static bool check_depth(SclshInterpreter* interp, size_t frames) {
+    if (frames > interp->recursion_limit) {
+        fprintf(stderr, "Too many nested evaluations (recursion limit is %zu)\n", interp->recursion_limit);
+        return false;
+    }
+    return true;
+}
+
+static bool push_value(SclshExecution* exec, SclshValue* value) {
+    if (exec->sp == exec->stack_capacity) {
+        size_t capacity = exec->stack_capacity ? exec->stack_capacity * 2 : 64;
+        SclshValue** stack = realloc(exec->stack, sizeof(SclshValue*) * capacity);
+        if (!stack) {
+            fprintf(stderr, "Out of memory for the value stack\n");
+            sclsh_value_unref(value);
+            return false;
+        }
+        exec->stack = stack;
+        exec->stack_capacity = capacity;
+    }
+    exec->stack[exec->sp++] = value;
+    return true;
+}
+
+static void truncate_stack(SclshExecution* exec, size_t height) {
+    while (exec->sp > height) {
+        sclsh_value_unref(exec->stack[--exec->sp]);
+    }
+}
+
+static bool push_counter(SclshExecution* exec) {
+    if (exec->counter_count == exec->counter_capacity) {
+        size_t capacity = exec->counter_capacity ? exec->counter_capacity * 2 : 8;
+        size_t* counters = realloc(exec->counters, sizeof(size_t) * capacity);
+        if (!counters) {
+            fprintf(stderr, "Out of memory for loop counters\n");
+            return false;
+        }
+        exec->counters = counters;
+        exec->counter_capacity = capacity;
+    }
+    exec->counters[exec->counter_count++] = 0;
+    return true;
+}
+
+static bool push_frame(
+    SclshExecution* exec,
+    SclshCode* code,
+    SclshContext* ctx,
+    SclshContinuation then,
+    void* data,
+    size_t return_sp
+) {
+    if (exec->frame_count == exec->frame_capacity) {
+        size_t capacity = exec->frame_capacity ? exec->frame_capacity * 2 : 16;
+        Frame* frames = realloc(exec->frames, sizeof(Frame) * capacity);
+        if (!frames) {
+            fprintf(stderr, "Out of memory for the frame stack\n");
+            return false;
+        }
+        exec->frames = frames;
+        exec->frame_capacity = capacity;
+    }
+    Frame* frame = &exec->frames[exec->frame_count++];
+    frame->code = sclsh_code_ref(code);
+    frame->pc = 0;
+    frame->base = exec->sp;
+    frame->return_sp = return_sp;
+    frame->counter_base = exec->counter_count;
+    frame->ctx = ctx;
+    frame->then = then;
+    frame->then_ctx = ctx;
+    frame->data = data;
+    frame->owns_ctx = false;
+    return true;
+}
+
+// Drops every frame of a run that will not continue, giving pending
+// continuations the chance to release their data
+static void execution_release(SclshExecution* exec) {
+    if (!exec) {
+        return;
+    }
+    SclshExecution* running = exec->interp->execution;
+    exec->interp->execution = NULL;  // Continuations must not push anything here
+    if (exec->frame_count > 0) {
+        sclsh_clear_unwind();  // Nothing of an abandoned run is propagated
+    }
+    while (exec->frame_count > 0) {
+        Frame frame = exec->frames[--exec->frame_count];
+        truncate_stack(exec, frame.base);
+        sclsh_code_unref(frame.code);
+        if (frame.owns_ctx) {
+            release_context(exec, &frame);
+        }
+        if (frame.then) {
+            sclsh_value_unref(frame.then(frame.then_ctx, NULL, frame.data));
+        }
+    }
+    exec->interp->execution = running;
+    truncate_stack(exec, 0);
+    exec->counter_count = 0;
+
+    SclshInterpreter* interp = exec->interp;
+    if (interp->spare_execution_count < MAX_SPARE_EXECUTIONS) {
+        exec->next_spare = interp->spare_executions;
+        interp->spare_executions = exec;
+        interp->spare_execution_count++;
+        return;
+    }
+    execution_destroy(exec);
+}
+
+static const SclshLoopRange* find_range(SclshCode* code, size_t pc) {
+    for (size_t i = 0; i < code->range_count; i++) {
+        if (pc >= code->ranges[i].start && pc < code->ranges[i].end) {
+            return &code->ranges[i];
+        }
+    }
+    return NULL;
+}
+
+// Called when an invocation made by the top frame failed. break and
+// continue are caught by the innermost compiled loop around the
+// invocation, which goes on at its target, and return by a procedure
+// body, whose result is left in *value. Returns true if the top frame
+// runs on.
+static bool catch_unwind(SclshExecution* exec, SclshValue** value) {
+    SclshUnwindKind kind = sclsh_get_unwind();
+    if (kind == SCLSH_UNWIND_NONE || kind == SCLSH_UNWIND_ERROR) {
+        return false;
+    }
+    Frame* frame = &exec->frames[exec->frame_count - 1];
+    if (kind == SCLSH_UNWIND_RETURN) {
+        if (frame->owns_ctx) {
+            SclshValue* returned = sclsh_get_unwind_value();
+            *value = returned ? sclsh_value_ref(returned) : sclsh_value_empty();
+            sclsh_clear_unwind();
+        }
+        return false;
+    }
+
+    const SclshLoopRange* range = find_range(frame->code, frame->pc - 1);
+    if (!range) {
+        if (frame->owns_ctx) {
+            // Loops of the caller are out of reach
+            fprintf(stderr, "%s used outside of a loop\n", kind == SCLSH_UNWIND_BREAK ? "break" : "continue");
+            sclsh_clear_unwind();
+        }
+        return false;
+    }
+    truncate_stack(exec, frame->base + range->depth);
+    exec->counter_count = frame->counter_base + range->counter_depth;
+    frame->pc = kind == SCLSH_UNWIND_BREAK ? range->break_target : range->continue_target;
+    sclsh_clear_unwind();
+    return true;
+}
+
+// Completes the invocations of run waiting for more than level frames in
+// whichever profilers are running
+static void complete_instrumented(SclshInterpreter* interp, SclshExecution* exec, size_t level) {
+    if (interp->profiling) {
+        sclsh_profile_complete(interp->profiling, exec, level);
+    }
+    if (interp->sampling) {
+        sclsh_sampler_complete(interp->sampling, exec, level);
+    }
+}
+
+// Hands the result of the top frame (NULL if it failed) to the invocation
+// that pushed it. Returns false once the run is over, with its result
+// (NULL if it failed) in *result.
+static bool finish_frame(SclshExecution* exec, SclshValue* value, SclshValue** result) {
+    for (;;) {
+        Frame frame = exec->frames[--exec->frame_count];
+        truncate_stack(exec, frame.base);
+        exec->counter_count = frame.counter_base;
+        sclsh_code_unref(frame.code);
+        if (frame.owns_ctx) {
+            release_context(exec, &frame);
+        }
+        if (frame.then) {
+            exec->invoke_sp = frame.return_sp;
+            exec->accepting = true;
+            value = frame.then(frame.then_ctx, value, frame.data);
+            exec->accepting = false;
+            if (value == PENDING) {
+                return true;  // The continuation went on with another frame
+            }
+        }
+        if (exec->interp->instrumented) {
+            complete_instrumented(exec->interp, exec, exec->frame_count);
+        }
+        if (exec->frame_count == 0) {
+            *result = value;
+            return false;
+        }
+        if (value) {
+            truncate_stack(exec, frame.return_sp);
+            return push_value(exec, value) || finish_frame(exec, NULL, result);
+        }
+        // The invocation failed, and so does the frame it was made from
+        // unless it catches the exception
+        if (catch_unwind(exec, &value)) {
+            return true;
+        }
+    }
+}
+
+// An exception that leaves the outermost run (or a coroutine) ends there:
+// return gives the run its result, break and continue are errors
+static SclshValue* end_unwind(SclshExecution* exec, SclshValue* result) {
+    if (result || (exec->outer && !exec->coroutine)) {
+        return result;
+    }
+    SclshUnwindKind kind = sclsh_get_unwind();
+    if (kind == SCLSH_UNWIND_RETURN) {
+        SclshValue* returned = sclsh_get_unwind_value();
+        result = returned ? sclsh_value_ref(returned) : sclsh_value_empty();
+    } else if (kind == SCLSH_UNWIND_BREAK || kind == SCLSH_UNWIND_CONTINUE) {
+        fprintf(stderr, "%s used outside of a loop\n", kind == SCLSH_UNWIND_BREAK ? "break" : "continue");
+    }
+    sclsh_clear_unwind();
+    return result;
+}
+
+// invoke with the hooks of the profilers around the command
+static SclshValue* invoke_instrumented(SclshExecution* exec, SclshContext* ctx, size_t argc,
+                                       SclshCommand* command) {
+    SclshValue** words = &exec->stack[exec->sp - argc];
+    SclshProfile* profile = exec->interp->profiling;
+    SclshSampler* sampler = exec->interp->sampling;
+    if (profile) {
+        sclsh_profile_enter(profile, sclsh_value_as_string(words[0]).string, exec);
+    }
+    if (sampler) {
+        sclsh_sampler_enter(sampler, command, sclsh_value_as_string(words[0]).string, exec);
+    }
+    exec->invoke_sp = exec->sp - argc;
+    exec->accepting = true;
+    SclshValue* value = command
+        ? command->func(ctx, argc - 1, words + 1, command->user_data)
+        : sclsh_exec_words(ctx, argc, words);
+    exec->accepting = false;
+    if (profile) {
+        // A command that pushed a frame completes with it
+        if (value == PENDING) {
+            sclsh_profile_pending(profile, exec, exec->frame_count);
+        } else {
+            sclsh_profile_complete(profile, exec, exec->frame_count);
+        }
+    }
+    if (sampler) {
+        if (value == PENDING) {
+            sclsh_sampler_pending(sampler, exec, exec->frame_count);
+        } else {
+            sclsh_sampler_complete(sampler, exec, exec->frame_count);
+        }
+    }
+    return value;
+}
+
+static SclshValue* invoke(SclshExecution* exec, SclshContext* ctx, size_t argc) {
+    SclshValue** words = &exec->stack[exec->sp - argc];
+    SclshCommand* command = sclsh_get_command_buffer(exec->interp, sclsh_value_as_bytes(words[0]));
+    if (exec->interp->instrumented) {
+        return invoke_instrumented(exec, ctx, argc, command);
+    }
+    exec->invoke_sp = exec->sp - argc;
+    exec->accepting = true;
+    SclshValue* value = command
+        ? command->func(ctx, argc - 1, words + 1, command->user_data)
+        : sclsh_exec_words(ctx, argc, words);  // Anything else runs as a program
+    exec->accepting = false;
+    return value;
+}
+
+typedef enum {
+    RUN_FINISHED,
+    RUN_YIELDED,
+} RunStatus;
+
+static RunStatus run(SclshExecution* exec, SclshValue** result) {
+    SclshInterpreter* interp = exec->interp;
+    exec->outer = interp->execution;
+    exec->depth_base = depth(exec->outer);
+    interp->execution = exec;
+    RunStatus status = RUN_FINISHED;
+
+    for (;;) {
+        Frame* frame = &exec->frames[exec->frame_count - 1];
+        if (frame->pc == frame->code->count) {
+            SclshValue* value = exec->stack[--exec->sp];  // Scripts leave exactly one value
+            if (!finish_frame(exec, value, result)) {
+                break;
+            }
+            continue;
+        }
+
+        SclshInstruction instruction = frame->code->instructions[frame->pc++];
+        SclshValue* value = NULL;
+        switch (instruction.op) {
+            case SCLSH_OP_PUSH:
+                value = sclsh_value_ref(frame->code->constants[instruction.arg]);
+                break;
+            case SCLSH_OP_LOAD: {
+                char* name = sclsh_value_as_string(frame->code->constants[instruction.arg]).string;
+                value = sclsh_value_ref(sclsh_context_get_variable(frame->ctx, name));
+                if (!value) {
+                    fprintf(stderr, "Variable '%s' not found\n", name);
+                }
+                break;
+            }
+            case SCLSH_OP_LOAD_LOCAL:
+                value = sclsh_value_ref(frame->ctx->locals[instruction.arg]);
+                if (!value) {
+                    fprintf(stderr, "Variable '%s' not found\n", frame->ctx->proc->local_names[instruction.arg]);
+                }
+                break;
+            case SCLSH_OP_STORE: {
+                char* name = sclsh_value_as_string(frame->code->constants[instruction.arg]).string;
+                sclsh_context_set_variable(frame->ctx, name, exec->stack[exec->sp - 1]);
+                continue;
+            }
+            case SCLSH_OP_STORE_LOCAL: {
+                SclshValue** slot = &frame->ctx->locals[instruction.arg];
+                SclshValue* previous = *slot;
+                *slot = sclsh_value_ref(exec->stack[exec->sp - 1]);
+                sclsh_value_unref(previous);
+                continue;
+            }
+            case SCLSH_OP_POP:
+                sclsh_value_unref(exec->stack[--exec->sp]);
+                continue;
+            case SCLSH_OP_JUMP:
+                frame->pc = instruction.arg;
+                continue;
+            case SCLSH_OP_BRANCH_FALSE: {
+                SclshValue* condition = exec->stack[--exec->sp];
+                if (!sclsh_expr_eval_bool(frame->ctx, condition)) {
+                    frame->pc = instruction.arg;
+                }
+                sclsh_value_unref(condition);
+                continue;
+            }
+            case SCLSH_OP_RETURN:
+                value = exec->stack[--exec->sp];
+                if (!finish_frame(exec, value, result)) {
+                    goto out;
+                }
+                continue;
+            case SCLSH_OP_INCR: {
+                char* name = sclsh_value_as_string(frame->code->constants[instruction.arg]).string;
+                value = sclsh_incr_value(sclsh_context_get_variable(frame->ctx, name), exec->stack[exec->sp - 1]);
+                if (value) {
+                    sclsh_context_set_variable(frame->ctx, name, value);  // Also when updated in place, for vwait
+                }
+                sclsh_value_unref(exec->stack[--exec->sp]);
+                break;
+            }
+            case SCLSH_OP_INCR_LOCAL: {
+                SclshValue** slot = &frame->ctx->locals[instruction.arg];
+                value = sclsh_incr_value(*slot, exec->stack[exec->sp - 1]);
+                if (value && value != *slot) {
+                    sclsh_value_unref(*slot);
+                    *slot = sclsh_value_ref(value);
+                }
+                sclsh_value_unref(exec->stack[--exec->sp]);
+                break;
+            }
+            case SCLSH_OP_FOREACH_START:
+                if (!push_counter(exec)) {
+                    break;  // Fails the frame
+                }
+                continue;
+            case SCLSH_OP_FOREACH_TEST: {
+                SclshValueList* items = sclsh_value_as_list(exec->stack[exec->sp - 1]);
+                if (!items || exec->counters[exec->counter_count - 1] >= items->count) {
+                    frame->pc = instruction.arg;
+                }
+                continue;
+            }
+            case SCLSH_OP_FOREACH_ITEM: {
+                SclshValueList* items = sclsh_value_as_list(exec->stack[exec->sp - 1]);
+                size_t* counter = &exec->counters[exec->counter_count - 1];
+                value = sclsh_value_ref(items && *counter < items->count
+                    ? items->items[(*counter)++]
+                    : frame->code->constants[instruction.arg]);
+                break;
+            }
+            case SCLSH_OP_FOREACH_END:
+                exec->counter_count--;
+                sclsh_value_unref(exec->stack[--exec->sp]);
+                continue;
+            case SCLSH_OP_CONCAT:
+                value = sclsh_value_concat(exec->stack + exec->sp - instruction.arg, instruction.arg);
+                truncate_stack(exec, exec->sp - instruction.arg);
+                break;
+            case SCLSH_OP_EXEC: {
+                SclshValue* command = frame->code->constants[instruction.arg];
+                value = sclsh_exec_command_line(frame->ctx, sclsh_value_as_command_line(command));
+                break;
+            }
+            case SCLSH_OP_INVOKE:
+                value = invoke(exec, frame->ctx, instruction.arg);
+                if (value == PENDING) {
+                    continue;
+                }
+                if (value == YIELDED) {
+                    exec->coroutine->resume_sp = exec->sp - instruction.arg;
+                    status = RUN_YIELDED;
+                    goto out;
+                }
+                if (value) {
+                    truncate_stack(exec, exec->sp - instruction.arg);
+                }
+                break;
+        }
+
+        if (!value) {
+            if (catch_unwind(exec, &value)) {
+                continue;
+            }
+            if (!finish_frame(exec, value, result)) {
+                break;
+            }
+            continue;
+        }
+        if (!push_value(exec, value) && !finish_frame(exec, NULL, result)) {
+            break;
+        }
+    }
+    *result = end_unwind(exec, *result);
+
+out:
+    if (interp->instrumented) {
+        complete_instrumented(interp, exec, 0);  // A coroutine is not timed while suspended
+    }
+    interp->execution = exec->outer;
+    return status;
+}
+
+// Runs a script to completion on a run of its own
+static SclshValue* run_detached(
+    SclshContext* ctx,
+    SclshCode* code,
+    SclshContinuation then,
+    void* data
+) {
+    if (!check_depth(ctx->interp, depth(ctx->interp->execution) + 1)) {
+        return then ? then(ctx, NULL, data) : NULL;
+    }
+    SclshExecution* exec = execution_acquire(ctx->interp);
+    if (!exec || !push_frame(exec, code, ctx, then, data, 0)) {
+        execution_release(exec);
+        return then ? then(ctx, NULL, data) : NULL;
+    }
+    SclshValue* result = NULL;
+    run(exec, &result);
+    execution_release(exec);
+    return result;
+}
+
+SclshValue* sclsh_eval_then(
+    SclshContext* ctx,
+    SclshValue* script,
+    SclshContinuation then,
+    void* data
+) {
+    if (!ctx || !script) {
+        return then ? then(ctx, NULL, data) : NULL;
+    }
+    SclshCode* code = sclsh_value_as_code(script);
+    if (!code) {
+        fprintf(stderr, "Cannot compile script\n");
+        return then ? then(ctx, NULL, data) : NULL;
+    }
+
+    SclshExecution* exec = ctx->interp->execution;
+    if (exec && exec->accepting) {
+        exec->accepting = false;  // One frame per invocation
+
+        // In tail position nothing is left to do in the frame that made
+        // the invocation, so the script takes that frame over
+        Frame* top = &exec->frames[exec->frame_count - 1];
+        if (!then && top->pc == top->code->count) {
+            SclshCode* previous = top->code;
+            top->code = sclsh_code_ref(code);
+            sclsh_code_unref(previous);
+            if (top->owns_ctx && top->ctx != ctx) {
+                release_context(exec, top);  // Nothing runs in the caller's context any more
+            }
+            top->pc = 0;
+            top->ctx = ctx;
+            truncate_stack(exec, top->base);
+            exec->counter_count = top->counter_base;
+            return PENDING;
+        }
+
+        if (!check_depth(ctx->interp, depth(exec) + 1)
+            || !push_frame(exec, code, ctx, then, data, exec->invoke_sp)) {
+            return then ? then(ctx, NULL, data) : NULL;
+        }
+        return PENDING;
+    }
+    // Not called by a running command, e.g. straight from C
+    return run_detached(ctx, code, then, data);
+}
+
+SclshValue* sclsh_eval_script(SclshContext* ctx, SclshValue* script) {
+    if (!ctx || !script) {
+        return NULL;
+    }
+    SclshCode* code = sclsh_value_as_code(script);
+    if (!code) {
+        fprintf(stderr, "Cannot compile script\n");
+        return NULL;
+    }
+    return run_detached(ctx, code, NULL, NULL);
+}
+
+SclshValue* sclsh_eval(SclshContext* ctx, SclshValue* ast) {
+    return sclsh_eval_script(ctx, ast);  // A single command is a script too
+}
+
+SclshValue* sclsh_command_invoke(
+    SclshContext* ctx,
+    SclshCommand* command,
+    size_t argc,
+    SclshValue** argv
+) {
+    if (!ctx || !command) {
+        return NULL;
+    }
+    // The command is not running on behalf of an instruction, so it must
+    // not push frames into whatever run is active
+    SclshExecution* exec = ctx->interp->execution;
+    bool accepting = exec && exec->accepting;
+    if (exec) {
+        exec->accepting = false;
+    }
+    SclshValue* value = command->func(ctx, argc, argv, command->user_data);
+    if (exec) {
+        exec->accepting = accepting;
+    }
+    return value;
+}
+
+// Context of a procedure call with the arguments bound to the parameter
+// slots, or NULL if they do not match
+static SclshContext* proc_context_new(
+    SclshExecution* exec,
+    SclshProc* proc,
+    size_t argc,
+    SclshValue** argv
+) {
+    if (argc < proc->required_count || (!proc->variadic && argc > proc->param_count)) {
+        fprintf(stderr, "Usage: %s\n", proc->usage);
+        return NULL;
+    }
+    SclshContext* ctx = arena_alloc(exec, sizeof(SclshContext) + sizeof(SclshValue*) * proc->local_count);
+    if (!ctx) {
+        fprintf(stderr, "Out of memory for procedure locals\n");
+        return NULL;
+    }
+    ctx->interp = exec->interp;
+    ctx->variables = NULL;
+    ctx->proc = sclsh_proc_ref(proc);
+    ctx->locals = (SclshValue**)(ctx + 1);
+
+    size_t fixed = proc->variadic ? proc->param_count - 1 : proc->param_count;
+    for (size_t i = 0; i < fixed; i++) {
+        ctx->locals[i] = sclsh_value_ref(i < argc ? argv[i] : proc->defaults[i]);
+    }
+    if (proc->variadic) {
+        ctx->locals[fixed] = argc > fixed
+            ? sclsh_value_new_from_list(argv + fixed, argc - fixed)
+            : sclsh_value_empty();
+    }
+    for (size_t i = proc->param_count; i < proc->local_count; i++) {
+        ctx->locals[i] = NULL;
+    }
+    return ctx;
+}
+
+// Pushes the body of proc as a frame that owns the context of the call
+static bool push_call(
+    SclshExecution* exec,
+    SclshProc* proc,
+    size_t argc,
+    SclshValue** argv,
+    size_t return_sp
+) {
+    ArenaMark mark = arena_mark(exec);
+    SclshContext* callee = proc_context_new(exec, proc, argc, argv);
+    if (!callee) {
+        return false;
+    }
+    if (!push_frame(exec, proc->code, callee, NULL, NULL, return_sp)) {
+        Frame frame = { .ctx = callee, .mark = mark };
+        release_context(exec, &frame);
+        return false;
+    }
+    Frame* frame = &exec->frames[exec->frame_count - 1];
+    frame->owns_ctx = true;
+    frame->mark = mark;
+    return true;
+}
+
+SclshValue* sclsh_call_proc(SclshContext* ctx, SclshProc* proc, size_t argc, SclshValue** argv) {
+    SclshInterpreter* interp = ctx->interp;
+    SclshExecution* exec = interp->execution;
+    if (exec && exec->accepting) {
+        exec->accepting = false;  // One frame per invocation
+
+        // A call in tail position takes over the frame of its caller, and
+        // its context the place of the caller's in the arena. The
+        // arguments stay alive on the value stack until they are bound.
+        Frame* top = &exec->frames[exec->frame_count - 1];
+        if (top->pc == top->code->count) {
+            if (top->owns_ctx) {
+                release_context(exec, top);
+            }
+            ArenaMark mark = arena_mark(exec);
+            SclshContext* callee = proc_context_new(exec, proc, argc, argv);
+            if (!callee) {
+                return NULL;
+            }
+            SclshCode* previous = top->code;
+            top->code = sclsh_code_ref(proc->code);
+            sclsh_code_unref(previous);
+            top->pc = 0;
+            top->ctx = callee;
+            top->owns_ctx = true;
+            top->mark = mark;
+            truncate_stack(exec, top->base);
+            exec->counter_count = top->counter_base;
+            return PENDING;
+        }
+
+        if (!check_depth(interp, depth(exec) + 1) || !push_call(exec, proc, argc, argv, exec->invoke_sp)) {
+            return NULL;
+        }
+        return PENDING;
+    }
+
+    // Called from C: the call gets a run of its own
+    if (!check_depth(interp, depth(exec) + 1)) {
+        return NULL;
+    }
+    SclshExecution* call = execution_acquire(interp);
+    if (!call) {
+        return NULL;
+    }
+    SclshValue* result = NULL;
+    if (push_call(call, proc, argc, argv, 0)) {
+        run(call, &result);
+    }
+    execution_release(call);
+    return result;
+}
+
+size_t sclsh_recursion_limit(SclshInterpreter* interp) {
+    return interp ? interp->recursion_limit : 0;
+}
+
+void sclsh_set_recursion_limit(SclshInterpreter* interp, size_t limit) {
+    if (interp && limit > 0) {
+        interp->recursion_limit = limit;
+    }
+}
+
+// Coroutines
+
+const char* sclsh_current_coroutine(SclshInterpreter* interp) {
+    for (SclshExecution* exec = interp ? interp->execution : NULL; exec; exec = exec->outer) {
+        if (exec->coroutine) {
+            return exec->coroutine->name;
+        }
+    }
+    return NULL;
+}
+
+static void coroutine_free(void* user_data) {
+    Coroutine* coro = user_data;
+    execution_release(coro->exec);
+    sclsh_value_unref(coro->yielded);
+    free(coro->name);
+    free(coro);
+}
+
+static SclshValue* resume(SclshInterpreter* interp, Coroutine* coro, SclshValue* value) {
+    if (coro->running) {
+        fprintf(stderr, "Coroutine '%s' is already running\n", coro->name);
+        return NULL;
+    }
+    SclshExecution* exec = coro->exec;
+    if (coro->started) {
+        // The value becomes the result of the yield the coroutine stopped at
+        truncate_stack(exec, coro->resume_sp);
+        if (!push_value(exec, sclsh_value_ref(value))) {
+            return NULL;
+        }
+    }
+    coro->started = true;
+
+    coro->running = true;
+    SclshValue* result = NULL;
+    RunStatus status = run(exec, &result);
+    coro->running = false;
+
+    if (status == RUN_YIELDED) {
+        result = coro->yielded;
+        coro->yielded = NULL;
+        return result;
+    }
+    // Finished or failed; either way the coroutine is gone
+    sclsh_command_delete(interp, coro->name);
+    return result;
+}
+
+static SclshValue* cmd_resume(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s ?value?\n", ((Coroutine*)user_data)->name);
+        return NULL;
+    }
+    SclshValue* value = argc == 1 ? sclsh_value_ref(argv[0]) : sclsh_value_empty();
+    SclshValue* result = resume(sclsh_context_interpreter(ctx), user_data, value);
+    sclsh_value_unref(value);
+    return result;
+}
+
+// coroutine gen eval { ... yield $x ... } creates the command gen, runs
+// the body until its first yield and returns the yielded value. Every
+// call of gen resumes the body, with its argument as the result of yield.
+static SclshValue* cmd_coroutine(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 2) {
+        fprintf(stderr, "Usage: coroutine <name> <command> ?arg ...?\n");
+        return NULL;
+    }
+    SclshInterpreter* interp = sclsh_context_interpreter(ctx);
+    char* name = sclsh_value_as_string(argv[0]).string;
+    if (sclsh_get_command(interp, name)) {
+        fprintf(stderr, "Command '%s' already exists\n", name);
+        return NULL;
+    }
+
+    Coroutine* coro = calloc(1, sizeof(Coroutine));
+    if (!coro) {
+        return NULL;
+    }
+    coro->name = strdup(name);
+    coro->exec = execution_acquire(interp);
+    SclshCode* code = sclsh_code_new_invocation(argc - 1, argv + 1);
+    if (!coro->exec || !code
+        || !push_frame(coro->exec, code, sclsh_global_context(interp), NULL, NULL, 0)) {
+        sclsh_code_unref(code);
+        coroutine_free(coro);
+        return NULL;
+    }
+    sclsh_code_unref(code);
+    coro->exec->coroutine = coro;
+
+    sclsh_command_new(interp, coro->name, cmd_resume, coro, coroutine_free);
+    return resume(interp, coro, NULL);
+}
+
+static SclshValue* cmd_yield(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc > 1) {
+        fprintf(stderr, "Usage: yield ?value?\n");
+        return NULL;
+    }
+    SclshExecution* exec = sclsh_context_interpreter(ctx)->execution;
+    if (!exec || !exec->coroutine || !exec->accepting) {
+        // Only the run of the coroutine itself can be suspended
+        if (sclsh_current_coroutine(sclsh_context_interpreter(ctx))) {
+            fprintf(stderr, "Cannot yield across a command that evaluates scripts from C\n");
+        } else {
+            fprintf(stderr, "yield called outside of a coroutine\n");
+        }
+        return NULL;
+    }
+    exec->coroutine->yielded = argc == 1 ? sclsh_value_ref(argv[0]) : sclsh_value_empty();
+    return YIELDED;
+}
+
+static SclshValue* cmd_eval(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc < 1) {
+        fprintf(stderr, "Usage: eval <script> ?script ...?\n");
+        return NULL;
+    }
+    if (argc == 1) {
+        return sclsh_eval_then(ctx, argv[0], NULL, NULL);
+    }
+
+    // Several arguments are joined with spaces into one script
+    SclshStringBuilder* sb = sclsh_string_builder_new();
+    for (size_t i = 0; i < argc; i++) {
+        if (i > 0) {
+            sclsh_string_builder_append_str(sb, " ");
+        }
+        sclsh_string_builder_append_buffer(sb, sclsh_value_as_bytes(argv[i]));
+    }
+    SclshValue* script = sclsh_string_builder_to_value(sb);
+    sclsh_string_builder_free(sb);
+    SclshValue* result = sclsh_eval_then(ctx, script, NULL, NULL);
+    sclsh_value_unref(script);  // A pushed frame holds on to the compiled code
+    return result;
+}
+
+static SclshValue* cmd_info(SclshContext* ctx, size_t argc, SclshValue** argv, void* user_data) {
+    (void)user_data; // Suppress unused parameter warning
+    if (argc != 1 || strcmp(sclsh_value_as_string(argv[0]).string, "coroutine") != 0) {
+        fprintf(stderr, "Usage: info coroutine\n");
+        return NULL;
+    }
+    const char* name = sclsh_current_coroutine(sclsh_context_interpreter(ctx));
+    return sclsh_value_from_cstr(name ? name : "");
+}
+
+void sclsh_register_vm_commands(SclshInterpreter* interp) {
+    if (!interp) {
+        return;
+    }
+    sclsh_command_new(interp, "eval", cmd_eval, NULL, NULL);
+    sclsh_command_new(interp, "coroutine", cmd_coroutine, NULL, NULL);
+    sclsh_command_new(interp, "yield", cmd_yield, NULL, NULL);
+    sclsh_command_new(interp, "info", cmd_info, NULL, NULL);
+}